@@ -0,0 +1,112 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_HASHED_NODE_ID_H_
+#define MAIDSAFE_RUDP_HASHED_NODE_ID_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "maidsafe/common/node_id.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// A NodeId paired with its hash, computed once on construction, for use as the key of hashed
+// containers.  Node ids are themselves hashes, so their leading bytes serve as the hash directly.
+// Keys held in containers own their NodeId, but a key for looking one up can instead refer to an
+// existing NodeId, so that a lookup neither copies the id nor allocates.
+class HashedNodeId {
+ public:
+  enum ReferenceTag { kReference };
+
+  explicit HashedNodeId(NodeId node_id)
+      : owned_node_id_(std::move(node_id)),
+        node_id_(&owned_node_id_),
+        hash_(Hash(owned_node_id_)) {}
+  // Refers to node_id rather than copying it, so must not outlive it.  Meant for lookups, e.g.
+  // connections.find(HashedNodeId(peer_id, HashedNodeId::kReference)).
+  HashedNodeId(const NodeId& node_id, ReferenceTag) : node_id_(&node_id), hash_(Hash(node_id)) {}
+  // Copies always own their NodeId, even when copied from a referring key.
+  HashedNodeId(const HashedNodeId& other)
+      : owned_node_id_(*other.node_id_), node_id_(&owned_node_id_), hash_(other.hash_) {}
+  HashedNodeId(HashedNodeId&& other) : node_id_(&owned_node_id_), hash_(other.hash_) {
+    if (other.Owns())
+      new (&owned_node_id_) NodeId(std::move(other.owned_node_id_));
+    else
+      new (&owned_node_id_) NodeId(*other.node_id_);
+  }
+  HashedNodeId& operator=(const HashedNodeId& other) {
+    if (this == &other)
+      return *this;
+    if (Owns())
+      owned_node_id_ = *other.node_id_;
+    else
+      new (&owned_node_id_) NodeId(*other.node_id_);
+    node_id_ = &owned_node_id_;
+    hash_ = other.hash_;
+    return *this;
+  }
+  ~HashedNodeId() {
+    if (Owns())
+      owned_node_id_.~NodeId();
+  }
+
+  const NodeId& node_id() const { return *node_id_; }
+  size_t hash() const { return hash_; }
+
+  bool operator==(const HashedNodeId& other) const {
+    return hash_ == other.hash_ && *node_id_ == *other.node_id_;
+  }
+  bool operator!=(const HashedNodeId& other) const { return !(*this == other); }
+
+  struct Hasher {
+    size_t operator()(const HashedNodeId& hashed_node_id) const { return hashed_node_id.hash(); }
+  };
+
+ private:
+  static size_t Hash(const NodeId& node_id) {
+    const auto& raw(node_id.string());
+    size_t hash(0);
+    std::memcpy(&hash, raw.data(), std::min(sizeof(hash), raw.size()));
+    return hash;
+  }
+
+  bool Owns() const { return node_id_ == &owned_node_id_; }
+
+  // Only constructed if the key owns its NodeId, so that a referring key never creates one.
+  union {
+    NodeId owned_node_id_;
+  };
+  const NodeId* node_id_;
+  size_t hash_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_HASHED_NODE_ID_H_
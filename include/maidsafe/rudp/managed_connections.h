@@ -21,11 +21,11 @@
 
 #include <atomic>
 #include <functional>
-#include <map>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -40,7 +40,9 @@
 #include "maidsafe/common/rsa.h"
 #include "maidsafe/common/utils.h"
 
+#include "maidsafe/rudp/hashed_node_id.h"
 #include "maidsafe/rudp/nat_type.h"
+#include "maidsafe/rudp/parameters.h"
 #include "maidsafe/rudp/return_codes.h"
 
 namespace maidsafe {
@@ -48,6 +50,7 @@ namespace maidsafe {
 namespace rudp {
 
 namespace detail {
+class HandlerAllocator;
 class Transport;
 }
 
@@ -55,6 +58,13 @@ typedef std::function<void(const std::string& /*message*/)> MessageReceivedFunct
 typedef std::function<void(const NodeId& /*peer_id*/)> ConnectionLostFunctor;
 typedef std::function<void(const NodeId& /*peer_id*/)> ConnectionAddedFunctor;
 typedef std::function<void(int /*result*/)> MessageSentFunctor;
+// Supplies the next chunk of a stream being sent.  Returns true if more data follows, or false if
+// chunk holds the last of the stream's data.
+typedef std::function<bool(std::string& /*chunk*/)> StreamSourceFunctor;
+// Receives the next chunk of an incoming stream.  stream_id distinguishes streams being received at
+// the same time, and last is true for the stream's final chunk.
+typedef std::function<void(uint64_t /*stream_id*/, const std::string& /*chunk*/, bool /*last*/)>
+    StreamChunkReceivedFunctor;
 
 struct EndpointPair {
   using Endpoint = boost::asio::ip::udp::endpoint;
@@ -126,8 +136,12 @@ class ManagedConnections {
 
   // Makes a new connection and sends the validation data (which cannot be empty) to the peer which
   // runs its message_received_functor_ with the data.  All messages sent via this connection are
-  // encrypted for the peer.
+  // encrypted for the peer.  algorithm selects the congestion control for this node's sends on
+  // the connection, e.g. kRateBased or kCubic for a long fat link; if not given,
+  // Parameters::congestion_control_algorithm is used.  The peer chooses its own for its sends.
   int Add(NodeId peer_id, EndpointPair peer_endpoint_pair, std::string validation_data);
+  int Add(NodeId peer_id, EndpointPair peer_endpoint_pair, std::string validation_data,
+          Parameters::CongestionControlAlgorithm algorithm);
 
   // Marks the connection to peer_endpoint as valid.  If it exists and is already permanent, or
   // is successfully upgraded to permanent, then the function is successful.  If the peer is direct-
@@ -141,8 +155,24 @@ class ManagedConnections {
 
   // Sends the message to the peer.  If the message is sent successfully, the message_sent_functor
   // is executed with input of kSuccess.  If there is no existing connection to peer_id,
-  // kInvalidConnection is used.
+  // kInvalidConnection is used.  Messages are sent with kNormalPriority unless a priority is given;
+  // each priority is delivered in order, but higher priorities are not held up behind large
+  // messages of lower priority.  Unless in_order is given, Parameters::in_order_delivery decides
+  // whether the message is delivered in order; if false, the peer hands it up as soon as all of its
+  // own packets have arrived, so it isn't held up by a packet lost from an earlier message.
   void Send(NodeId peer_id, std::string message, MessageSentFunctor message_sent_functor);
+  void Send(NodeId peer_id, std::string message, Parameters::MessagePriority priority,
+            MessageSentFunctor message_sent_functor);
+  void Send(NodeId peer_id, std::string message, Parameters::MessagePriority priority,
+            bool in_order, MessageSentFunctor message_sent_functor);
+
+  // Sends a stream of data to the peer, which is not limited by kMaxMessageSize and need never be
+  // held in memory all at once.  source is called for each chunk in turn, once the previous chunk
+  // has been taken into the connection's send window, so a sender can't run ahead of the network.
+  // It must not block.  The peer receives the chunks in order via its StreamChunkReceivedFunctor.
+  // message_sent_functor is executed once the whole stream has been acknowledged, as for Send.
+  void SendStream(NodeId peer_id, StreamSourceFunctor source,
+                  Parameters::MessagePriority priority, MessageSentFunctor message_sent_functor);
 
   // Try to ping remote_endpoint.  If this node is already connected, ping_functor is invoked with
   // kWontPingAlreadyConnected.  Otherwise, kPingFailed or kSuccess is passed to ping_functor.
@@ -151,9 +181,19 @@ class ManagedConnections {
 
   void SetConnectionAddedFunctor(const ConnectionAddedFunctor&);
 
+  // Sets the functor which receives the chunks of incoming streams.  It is called from the
+  // connections' threads, and may run concurrently for different streams, but each stream's next
+  // chunk is only passed once it has returned from the previous one.  Other messages and streams
+  // from the same peer carry on being delivered meanwhile, but once about 1 MiB of a connection's
+  // stream data is waiting for the functor, no more of the connection's data is read, so a
+  // consistently slow receiver holds back the sender.  It should return promptly, handing any
+  // lengthy processing off to another thread.
+  void SetStreamChunkReceivedFunctor(const StreamChunkReceivedFunctor&);
+
  private:
   typedef std::shared_ptr<detail::Transport> TransportPtr;
-  typedef std::map<NodeId, TransportPtr> ConnectionMap;
+  typedef std::unordered_map<detail::HashedNodeId, TransportPtr, detail::HashedNodeId::Hasher>
+      ConnectionMap;
   struct PendingConnection {
     PendingConnection(NodeId node_id_in, TransportPtr transport,
                       boost::asio::io_service& io_service);
@@ -197,6 +237,7 @@ class ManagedConnections {
       const NodeId& peer_id);
 
   void OnMessageSlot(const std::string& message);
+  void OnStreamChunkSlot(uint64_t stream_id, const std::string& chunk, bool last);
   void OnConnectionAddedSlot(const NodeId& peer_id, TransportPtr transport,
                              bool temporary_connection,
                              std::atomic<bool> & is_duplicate_normal_connection);
@@ -211,19 +252,27 @@ class ManagedConnections {
                                    uint16_t& another_external_port);
 
   void UpdateIdleTransports(const TransportPtr&);
+  // Republishes connections_ for Send.  Must be called with mutex_ locked after every change to it.
+  void PublishConnections();
 
  private:
   std::string DebugString() const;
 
+  // Recycles the memory of the handlers posted to deliver received messages.  Declared ahead of
+  // asio_service_ so that it outlives any still queued when the service is destroyed.
+  std::unique_ptr<detail::HandlerAllocator> message_allocator_;
   BoostAsioService asio_service_;
   std::mutex callback_mutex_;
   MessageReceivedFunctor message_received_functor_;
   ConnectionLostFunctor connection_lost_functor_;
   ConnectionAddedFunctor connection_added_functor_;
+  StreamChunkReceivedFunctor stream_chunk_received_functor_;
   NodeId this_node_id_, chosen_bootstrap_node_id_;
   std::shared_ptr<asymm::PrivateKey> private_key_;
   std::shared_ptr<asymm::PublicKey> public_key_;
   ConnectionMap connections_;
+  // A copy of connections_ which Send reads without locking mutex_.
+  std::shared_ptr<const ConnectionMap> published_connections_;
   std::vector<std::unique_ptr<PendingConnection>> pendings_;
   std::set<TransportPtr> idle_transports_;
   mutable std::mutex mutex_;
@@ -34,6 +34,11 @@ struct Parameters {
   // Thread count for use of asio::io_service.
   static uint32_t thread_count;
 
+  // Number of SO_REUSEPORT sockets, each with its own dispatcher and strand, which a transport
+  // opens on its endpoint and spreads its connections across.  The asio::io_service runs at least
+  // this many threads.  Only takes effect where SO_REUSEPORT is supported.
+  static uint32_t shard_count;
+
   // Maximum number of Transports per ManagedConnections object
   static int max_transports;
 
@@ -47,6 +52,12 @@ struct Parameters {
   // The default number of packets to write at a time
   static uint32_t default_burst_send_size;
 
+  // The maximum number of packets pulled from the UDP socket by a single receive call.
+  static uint32_t receive_batch_size;
+
+  // The maximum number of packets handed to the UDP socket by a single send call.
+  static uint32_t send_batch_size;
+
 
   // Packet size permitted in RUDP.  Shall not exceed the UDP payload, which is 65507.
   static uint32_t default_size;
@@ -59,6 +70,15 @@ struct Parameters {
   static uint32_t max_data_size;
   static uint32_t default_data_size;
 
+  // Received packets are held in two process-wide packet buffer pools, one of default_size buffers
+  // and one of max_size buffers.  Each pool may hold up to packet_buffer_count buffers, plus
+  // maximum_window_size for every connection's receive window.  Buffers are allocated in slabs as
+  // they are first needed.  Payloads received while the pools are exhausted are stored on the heap.
+  static uint32_t packet_buffer_count;
+
+  // Whether the slabs of the packet buffer pools are backed by huge pages where available.
+  static bool packet_buffer_huge_pages;
+
   // Timeout defined for a packet to be resent.
   static Timeout default_send_timeout;
 
@@ -122,6 +142,39 @@ struct Parameters {
   };
   static ConnectionType connection_type;
 
+  // Congestion control algorithms which size a connection's send window and pace its sends.
+  enum CongestionControlAlgorithm {
+    // Window grows or shrinks with the receiver's available buffer; sends at a fixed rate.
+    kBufferBased,
+    // BBR-style, driven by the estimated bottleneck bandwidth and minimum round trip time.
+    kRateBased,
+    // CUBIC-style, driven by loss.
+    kCubic
+  };
+  // The algorithm used by connections for which ManagedConnections::Add isn't given one, including
+  // bootstrap connections.  It stays kBufferBased, the behaviour existing deployments were tuned
+  // for, so the rate and loss based algorithms are opted into per connection where they help.
+  static CongestionControlAlgorithm congestion_control_algorithm;
+
+  // Whether messages are delivered in the order they were sent, unless ManagedConnections::Send is
+  // told otherwise for a message.  If false, each message is handed up as soon as all of its own
+  // packets have arrived, so a lost packet only delays its message.
+  static bool in_order_delivery;
+
+  // Priorities with which messages may be sent.  Each priority has its own stream within a
+  // connection, whose messages arrive in the order sent.  The sender interleaves the streams packet
+  // by packet in proportion to their weights, so a small message is not held up for the whole of
+  // a large transfer on a lower priority stream.
+  enum MessagePriority {
+    kHighPriority,
+    kNormalPriority,
+    kLowPriority,
+    kMessagePriorityCount
+  };
+  // The number of packets each stream may add to the send window in its turn.  Zero is treated as
+  // one.
+  static uint32_t stream_weights[kMessagePriorityCount];
+
  private:
   // Disallow copying and assignment.
   Parameters(const Parameters&);
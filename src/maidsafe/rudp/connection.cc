@@ -22,8 +22,9 @@
 
 #include <array>
 #include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <functional>
-#include <queue>
 #include <thread>
 
 #include "boost/asio/read.hpp"
@@ -58,13 +59,30 @@ std::ostream& operator<<(std::ostream& ostream, const Multiplexer& multiplexer)
 
 namespace {
 typedef std::function<void(int /*result*/)> PingFunctor;
+
+// Ids for incoming streams, unique across all connections.
+std::atomic<uint64_t> next_stream_id(0);
+
+// The most incoming stream data held for slow consumers before the connection stops reading, which
+// in turn holds back the sender.
+const size_t kMaxQueuedStreamBytes(1024 * 1024);
 }  // unnamed namespace
 
 Connection::Connection(const std::shared_ptr<Transport>& transport,
                        const boost::asio::io_service::strand& strand,
-                       std::shared_ptr<Multiplexer> multiplexer)
+                       std::shared_ptr<Multiplexer> multiplexer, bool own_strand)
     : transport_(transport),
-      strand_(strand),
+      send_queue_(),
+      send_queue_drain_pending_(false),
+      read_allocator_(),
+      write_allocator_(),
+      tick_allocator_(),
+      probe_allocator_(),
+      handoff_allocator_(),
+      send_queue_allocator_(),
+      own_strand_(own_strand),
+      strand_(own_strand ? boost::asio::io_service::strand(transport->asio_service_.service())
+                         : strand),
       multiplexer_(std::move(multiplexer)),
       socket_(*multiplexer_, transport->nat_type_),
       cookie_syn_(0),
@@ -73,17 +91,17 @@ Connection::Connection(const std::shared_ptr<Transport>& transport,
       lifespan_timer_(strand_.get_io_service()),
       peer_node_id_(),
       peer_endpoint_(),
-      send_buffer_(),
-      receive_buffer_(),
-      data_size_(0),
-      data_received_(0),
+      receive_message_(),
+      receive_piece_(),
+      incoming_streams_(),
+      pending_stream_chunks_(),
+      queued_stream_bytes_(0),
+      read_paused_(false),
       failed_probe_count_(0),
       state_(State::kPending),
       state_mutex_(),
       timeout_state_(TimeoutState::kConnecting),
-      sending_(false),
       failure_functor_(),
-      send_queue_(),
       handle_tick_lock_() {
   static_assert((sizeof(DataSize)) == 4, "DataSize must be 4 bytes.");
   timer_.expires_from_now(bptime::pos_infin);
@@ -112,8 +130,6 @@ void Connection::DoClose(const Error& error) {
     transport->RemoveConnection(shared_from_this(), error == boost::asio::error::timed_out);
     FireOnConnectFunctor(error);
     transport_.reset();
-    sending_ = false;
-    std::queue<SendRequest>().swap(send_queue_);
     timer_.expires_from_now(Parameters::disconnection_timeout);
     timeout_state_ = TimeoutState::kClosing;
   } else {
@@ -141,6 +157,11 @@ void Connection::Ping(const NodeId& peer_node_id, const ip::udp::endpoint& peer_
                              ping_functor, OnConnect(), std::function<void()>()));
 }
 
+void Connection::SetCongestionControlAlgorithm(Parameters::CongestionControlAlgorithm algorithm) {
+  auto self = shared_from_this();
+  strand_.dispatch([self, algorithm]() { self->socket_.SetCongestionControlAlgorithm(algorithm); });
+}
+
 void Connection::DoStartConnecting(const NodeId& peer_node_id,
                                    const ip::udp::endpoint& peer_endpoint,
                                    const std::string& validation_data,
@@ -152,14 +173,34 @@ void Connection::DoStartConnecting(const NodeId& peer_node_id,
   peer_node_id_    = peer_node_id;
   peer_endpoint_   = peer_endpoint;
   on_connect_      = on_connect;
-  failure_functor_ = failure_functor;
+  {
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    failure_functor_ = failure_functor;
+  }
 
+  socket_.SetOwner(shared_from_this());
+  if (own_strand_)
+    StartHandingOffPackets();
   StartTick();
   StartConnect(validation_data, connect_attempt_timeout, lifespan, ping_functor);
   bs::error_code ignored_ec;
   CheckTimeout(ignored_ec);
 }
 
+void Connection::StartHandingOffPackets() {
+  std::weak_ptr<Connection> weak_self(shared_from_this());
+  // Only one drain of the socket's hand-off ring is posted at a time, so a single handler
+  // allocation is recycled however many packets arrive.
+  socket_.SetReceiveHandoff([weak_self]() {
+    auto self = weak_self.lock();
+    if (!self)
+      return;
+    self->strand_.post(MakeAllocHandler(self->handoff_allocator_, [self]() {
+      self->socket_.HandleHandedOffPackets();
+    }));
+  });
+}
+
 Connection::State Connection::state() const {
   std::lock_guard<std::mutex> lock(state_mutex_);
   return state_;
@@ -187,74 +228,126 @@ void Connection::MarkAsDuplicateAndClose() {
 }
 
 std::function<void()> Connection::GetAndClearFailureFunctor() {
-  if (std::shared_ptr<Transport> transport = transport_.lock()) {
-    std::function<void()> failure_functor;
-    failure_functor.swap(failure_functor_);
-    return failure_functor;
-  } else {
-    return std::function<void()>();
-  }
+  // Called on the transport's strand, which isn't strand_, so transport_ mustn't be read here.
+  std::function<void()> failure_functor;
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  failure_functor.swap(failure_functor_);
+  return failure_functor;
 }
 
 ip::udp::endpoint Connection::RemoteNatDetectionEndpoint() const {
   return socket_.RemoteNatDetectionEndpoint();
 }
 
-void Connection::StartSending(const std::string& data,
-                              const MessageSentFunctor& message_sent_functor) {
+void Connection::StartSending(const SharedBuffer& data, Parameters::MessagePriority priority,
+                              bool in_order, const MessageSentFunctor& message_sent_functor) {
   if (data.size() > static_cast<size_t>(ManagedConnections::kMaxMessageSize())) {
     LOG(kError) << "Data size " << data.size() << " bytes (exceeds limit of "
                 << ManagedConnections::kMaxMessageSize() << ")";
-    InvokeSentFunctor(message_sent_functor, kMessageTooLarge);
+    return InvokeSentFunctor(message_sent_functor, kMessageTooLarge);
   }
   try {
-    // 2014-8-26 ned: TODO FIXME: This code is encrypting the message into
-    // a string which enters a queue. Encode() later on COPIES that string
-    // into send_buffer_ plus 3 bytes which it then hands off to be sent.
-    // This needs to go away and save another memory copy.
-    strand_.post(
-        std::bind(&Connection::DoQueueSendRequest, shared_from_this(),
-                  SendRequest(data, message_sent_functor)));
+    send_queue_.Push(SendRequest(data, priority, in_order, message_sent_functor));
+    if (!send_queue_drain_pending_.exchange(true))
+      strand_.post(MakeAllocHandler(send_queue_allocator_,
+                                    std::bind(&Connection::DrainSendQueue, shared_from_this())));
   }
   catch (const std::exception& e) {
-    LOG(kError) << "Failed to encrypt message: " << e.what();
-    return InvokeSentFunctor(message_sent_functor, kFailedToEncryptMessage);
+    LOG(kError) << "Failed to queue message: " << e.what();
+    return InvokeSentFunctor(message_sent_functor, kSendFailure);
   }
 }
 
-void Connection::DoQueueSendRequest(SendRequest request) {
-  if (sending_) {
-    send_queue_.push(std::move(request));
-  } else {
-    DoStartSending(std::move(request));
-  }
-}
-
-void Connection::FinishSendAndQueueNext() {
-  if (send_queue_.empty()) {
-    sending_ = false;
-  } else {
-    strand_.post(std::bind(&Connection::DoStartSending, shared_from_this(), send_queue_.front()));
-    send_queue_.pop();
+void Connection::DrainSendQueue() {
+  SendRequest request;
+  for (;;) {
+    while (send_queue_.Pop(request))
+      DoStartSending(std::move(request));
+    send_queue_drain_pending_ = false;
+    // A producer which pushed after the last pop but saw the drain still pending has left its
+    // message for this drain to pick up.
+    if (send_queue_.Empty() || send_queue_drain_pending_.exchange(true))
+      return;
   }
 }
 
 void Connection::DoStartSending(SendRequest const request) {
-  sending_ = true;
+  // Messages are handed to the socket as soon as they arrive, without waiting for earlier ones to
+  // be written, so that several can be in the send window at once.
   const std::function<void(int)> message_sent_functor = request.message_sent_functor_;  // NOLINT
   MessageSentFunctor wrapped_functor([this, message_sent_functor](int result) {
     InvokeSentFunctor(message_sent_functor, result);
   });
 
-  if (Stopped()) {
+  if (Stopped())
     InvokeSentFunctor(message_sent_functor, kSendFailure);
-    FinishSendAndQueueNext();
-  } else {
-    EncodeData(request.encrypted_data_);
-    strand_.dispatch(std::bind(&Connection::StartWrite, shared_from_this(), wrapped_functor));
+  else
+    StartWrite(EncodeData(request.encrypted_data_), request.priority_, request.in_order_,
+               wrapped_functor);
+}
+
+void Connection::StartSendingStream(const StreamSourceFunctor& source,
+                                    Parameters::MessagePriority priority,
+                                    const MessageSentFunctor& message_sent_functor) {
+  strand_.post(std::bind(&Connection::DoStartSendingStream, shared_from_this(),
+                         std::make_shared<OutgoingStream>(source, priority, message_sent_functor)));
+}
+
+void Connection::DoStartSendingStream(std::shared_ptr<OutgoingStream> stream) {
+  if (Stopped())
+    return InvokeSentFunctor(stream->message_sent_functor, kSendFailure);
+
+  const MessageSentFunctor message_sent_functor(stream->message_sent_functor);
+  stream->message_number =
+      socket_.StartMessage(stream->priority, [this, message_sent_functor](int result) {
+        InvokeSentFunctor(message_sent_functor, result);
+      });
+  // The first part carries a size prefix which marks the message as streamed.
+  std::string size_prefix(4, 0);
+  for (int i = 0; i != 4; ++i)
+    size_prefix[i] = static_cast<char>(Receiver::kStreamedMessageSize >> (8 * (3 - i)));
+  stream->next_part.push_back(SharedBuffer(std::move(size_prefix)));
+  PullStreamChunk(*stream);
+  WriteStreamPart(stream);
+}
+
+void Connection::PullStreamChunk(OutgoingStream& stream) {
+  while (stream.more) {
+    std::string chunk;
+    stream.more = stream.source(chunk);
+    if (!chunk.empty()) {
+      stream.next_part.push_back(SharedBuffer(std::move(chunk)));
+      return;
+    }
   }
 }
 
+void Connection::WriteStreamPart(std::shared_ptr<OutgoingStream> stream) {
+  std::vector<SharedBuffer> part;
+  part.swap(stream->next_part);
+  // Look ahead to find whether this is the last part.
+  PullStreamChunk(*stream);
+  bool last(stream->next_part.empty());
+  if (last)
+    stream->source = nullptr;
+  socket_.AsyncWritePart(stream->message_number, std::move(part), last,
+                         strand_.wrap(std::bind(&Connection::HandleStreamPartWritten,
+                                                shared_from_this(), stream, last, args::_1)));
+}
+
+void Connection::HandleStreamPartWritten(std::shared_ptr<OutgoingStream> stream, bool last,
+                                         const bs::error_code& ec) {
+  // The message_sent_functor is invoked by the socket once the last part is acknowledged, or
+  // with kConnectionClosed if the socket closes first.
+  if (ec || Stopped()) {
+    LOG(kError) << "Failed to write stream from " << *multiplexer_ << " to "
+                << socket_.PeerEndpoint() << " - " << (ec ? ec.message() : "connection stopped.");
+    return DoClose(boost::asio::error::not_connected);
+  }
+  if (!last)
+    WriteStreamPart(stream);
+}
+
 void Connection::CheckTimeout(const bs::error_code& ec) {
   if (ec && ec != boost::asio::error::operation_aborted) {
     LOG(kError) << "Connection check timeout error: " << ec.message();
@@ -289,7 +382,8 @@ bool Connection::Stopped() const { return (!transport_.lock() || !socket_.IsOpen
 bool Connection::TicksStopped() const { return (!transport_.lock() && !socket_.IsOpen()); }
 
 void Connection::StartTick() {
-  auto handler = strand_.wrap(std::bind(&Connection::HandleTick, shared_from_this()));
+  auto handler = strand_.wrap(
+      MakeAllocHandler(tick_allocator_, std::bind(&Connection::HandleTick, shared_from_this())));
   socket_.AsyncTick(handler);
 }
 
@@ -427,11 +521,7 @@ void Connection::HandleConnect(const bs::error_code& ec, const std::string& vali
 
   if (std::shared_ptr<Transport> transport = transport_.lock()) {
     peer_node_id_ = socket_.PeerNodeId();
-    auto self = shared_from_this();
-
-    transport->strand_.dispatch([transport, self]() {
-        self->FireOnConnectFunctor(Error());
-      });
+    FireOnConnectFunctor(Error());
   } else {
     LOG(kError) << "Pointer to Transport already destroyed.";
     return DoClose(boost::asio::error::not_connected);
@@ -441,9 +531,10 @@ void Connection::HandleConnect(const bs::error_code& ec, const std::string& vali
   timeout_state_ = TimeoutState::kConnected;
 
   StartProbing();
-  StartReadSize();
+  StartReadMessage();
   if (!validation_data.empty()) {
-    StartSending(validation_data, [this](int result) {
+    StartSending(SharedBuffer(validation_data), Parameters::kHighPriority,
+                 Parameters::in_order_delivery, [this](int result) {
       if (result != kSuccess) {
         LOG(kWarning) << "Failed to send validation data from " << *multiplexer_ << " to "
                       << socket_.PeerEndpoint() << "  Result: " << result;
@@ -452,72 +543,25 @@ void Connection::HandleConnect(const bs::error_code& ec, const std::string& vali
   }
 }
 
-void Connection::StartReadSize() {
+void Connection::StartReadMessage() {
   if (Stopped()) {
     LOG(kWarning) << "Connection from " << *multiplexer_ << " to " << socket_.PeerEndpoint()
                   << " already stopped.";
     return DoClose(boost::asio::error::not_connected);
   }
-  receive_buffer_.clear();
-  receive_buffer_.resize(sizeof(DataSize));
-  socket_.AsyncRead(
-      boost::asio::buffer(receive_buffer_), sizeof(DataSize),
-      strand_.wrap(std::bind(&Connection::HandleReadSize, shared_from_this(), args::_1)));
-}
-
-void Connection::HandleReadSize(const bs::error_code& ec) {
-  if (ec) {
-#ifndef NDEBUG
-    if (!Stopped()) {
-      LOG(kWarning) << "Failed to read size.  Connection from " << *multiplexer_ << " to "
-                    << socket_.PeerEndpoint() << " error - " << ec.message();
-    }
-#endif
-    return DoClose(boost::asio::error::not_connected);
-  }
-
-  if (Stopped()) {
-    LOG(kWarning) << "Failed to read size.  Connection from " << *multiplexer_ << " to "
-                  << socket_.PeerEndpoint() << " already stopped.";
-    return DoClose(boost::asio::error::not_connected);
-  }
-
-  data_size_ =
-      (((((receive_buffer_.at(0) << 8) | receive_buffer_.at(1)) << 8) | receive_buffer_.at(2))
-       << 8) |
-      receive_buffer_.at(3);
   // Allow some leeway for encryption overhead
-  if (data_size_ > ManagedConnections::kMaxMessageSize() + 1024) {
-    LOG(kError) << "Won't receive a message of size " << data_size_ << " which is > "
-                << ManagedConnections::kMaxMessageSize() + 1024 << ", closing.";
-    return DoClose(boost::asio::error::not_connected);
-  }
-
-  data_received_ = 0;
-
-  StartReadData();
+  socket_.AsyncReadMessage(
+      receive_message_, receive_piece_, ManagedConnections::kMaxMessageSize() + 1024,
+      strand_.wrap(MakeAllocHandler(
+          read_allocator_,
+          std::bind(&Connection::HandleReadMessage, shared_from_this(), args::_1))));
 }
 
-void Connection::StartReadData() {
-  if (Stopped()) {
-    LOG(kWarning) << "Connection from " << *multiplexer_ << " to " << socket_.PeerEndpoint()
-                  << " already stopped.";
-    return DoClose(boost::asio::error::not_connected);
-  }
-  DataSize buffer_size = data_received_;
-  buffer_size += std::min(socket_.BestReadBufferSize(), data_size_ - data_received_);
-  receive_buffer_.resize(buffer_size);
-  boost::asio::mutable_buffer data_buffer = boost::asio::buffer(receive_buffer_) + data_received_;
-  socket_.AsyncRead(
-      boost::asio::buffer(data_buffer), 1,
-      strand_.wrap(std::bind(&Connection::HandleReadData, shared_from_this(), args::_1, args::_2)));
-}
-
-void Connection::HandleReadData(const bs::error_code& ec, size_t length) {
+void Connection::HandleReadMessage(const bs::error_code& ec) {
   if (ec) {
 #ifndef NDEBUG
     if (!Stopped()) {
-      LOG(kError) << "Failed to read data.  Connection from " << *multiplexer_ << " to "
+      LOG(kError) << "Failed to read message.  Connection from " << *multiplexer_ << " to "
                   << socket_.PeerEndpoint() << " error - " << ec.message();
     }
 #endif
@@ -525,58 +569,113 @@ void Connection::HandleReadData(const bs::error_code& ec, size_t length) {
   }
 
   if (Stopped()) {
-    LOG(kError) << "Failed to read data.  Connection from " << *multiplexer_ << " to "
+    LOG(kError) << "Failed to read message.  Connection from " << *multiplexer_ << " to "
                 << socket_.PeerEndpoint() << " already stopped.";
     return DoClose(boost::asio::error::not_connected);
   }
 
-  assert(static_cast<DataSize>(length) >= 0);
-  data_received_ += static_cast<DataSize>(length);
-  if (data_received_ == data_size_) {
-    if (std::shared_ptr<Transport> transport = transport_.lock()) {
-      transport->SignalMessageReceived(std::string(receive_buffer_.begin(), receive_buffer_.end()));
-      StartReadSize();
+  if (std::shared_ptr<Transport> transport = transport_.lock()) {
+    std::string message;
+    message.swap(receive_message_);
+    if (!receive_piece_.streamed) {
+      transport->SignalMessageReceived(std::move(message));
+      return StartReadMessage();
     }
-  } else {
-    // Need more data to complete the message.
-    //    if (length > 0)
-    //      timer_.expires_from_now(Parameters::speed_calculate_inverval);
-    //    // If transmission speed is too slow, the socket shall be forced closed
-    //    if (socket_.IsSlowTransmission(length)) {
-    //      LOG(kWarning) << "Connection to " << socket_.PeerEndpoint()
-    //                    << " has slow transmission - closing now.";
-    //      return DoClose();
-    //    }
-    StartReadData();
+    uint64_t stream_id(0);
+    if (receive_piece_.first) {
+      stream_id = ++next_stream_id;
+      if (!receive_piece_.last)
+        incoming_streams_[receive_piece_.message_number] = stream_id;
+    } else {
+      auto itr(incoming_streams_.find(receive_piece_.message_number));
+      if (itr == incoming_streams_.end()) {
+        LOG(kError) << "Received a piece of unknown stream " << receive_piece_.message_number
+                    << " from " << socket_.PeerEndpoint();
+        return DoClose(boost::asio::error::not_connected);
+      }
+      stream_id = itr->second;
+      if (receive_piece_.last)
+        incoming_streams_.erase(itr);
+    }
+    QueueStreamChunk(stream_id, std::move(message), receive_piece_.last);
+    if (queued_stream_bytes_ < kMaxQueuedStreamBytes)
+      return StartReadMessage();
+    read_paused_ = true;
   }
 }
 
-void Connection::EncodeData(const std::string& data) {
-  // Serialize message to internal buffer
+void Connection::QueueStreamChunk(uint64_t stream_id, std::string chunk, bool last) {
+  queued_stream_bytes_ += chunk.size();
+  PendingStreamChunks& pending(pending_stream_chunks_[stream_id]);
+  pending.chunks.emplace_back(std::move(chunk), last);
+  if (!pending.chunk_with_consumer)
+    SignalNextStreamChunk(stream_id);
+}
+
+void Connection::SignalNextStreamChunk(uint64_t stream_id) {
+  std::shared_ptr<Transport> transport(transport_.lock());
+  if (!transport)
+    return;
+  PendingStreamChunks& pending(pending_stream_chunks_[stream_id]);
+  assert(!pending.chunks.empty());
+  std::string chunk(std::move(pending.chunks.front().first));
+  bool last(pending.chunks.front().second);
+  pending.chunks.pop_front();
+  pending.chunk_with_consumer = true;
+  size_t size(chunk.size());
+  transport->SignalStreamChunkReceived(
+      stream_id, std::move(chunk), last,
+      strand_.wrap(std::bind(&Connection::HandleStreamChunkConsumed, shared_from_this(),
+                             stream_id, size)));
+}
+
+void Connection::HandleStreamChunkConsumed(uint64_t stream_id, size_t size) {
+  queued_stream_bytes_ -= size;
+  auto itr(pending_stream_chunks_.find(stream_id));
+  assert(itr != pending_stream_chunks_.end());
+  itr->second.chunk_with_consumer = false;
+  if (itr->second.chunks.empty())
+    pending_stream_chunks_.erase(itr);
+  else
+    SignalNextStreamChunk(stream_id);
+
+  if (read_paused_ && queued_stream_bytes_ < kMaxQueuedStreamBytes) {
+    read_paused_ = false;
+    StartReadMessage();
+  }
+}
+
+std::vector<SharedBuffer> Connection::EncodeData(const SharedBuffer& data) const {
+  // The size prefix is sent as its own segment ahead of the message, which is not copied.
   DataSize msg_size = static_cast<DataSize>(data.size());
-  send_buffer_.clear();
+  std::string size_prefix(4, 0);
   for (int i = 0; i != 4; ++i)
-    send_buffer_.push_back(static_cast<char>(msg_size >> (8 * (3 - i))));
-  send_buffer_.insert(send_buffer_.end(), data.begin(), data.end());
+    size_prefix[i] = static_cast<char>(msg_size >> (8 * (3 - i)));
+  std::vector<SharedBuffer> segments;
+  segments.reserve(2);
+  segments.push_back(SharedBuffer(std::move(size_prefix)));
+  segments.push_back(data);
+  return segments;
 }
 
-void Connection::StartWrite(const MessageSentFunctor& message_sent_functor) {
+void Connection::StartWrite(std::vector<SharedBuffer> data, Parameters::MessagePriority priority,
+                            bool in_order, const MessageSentFunctor& message_sent_functor) {
   if (Stopped()) {
     LOG(kError) << "Failed to write from " << *multiplexer_ << " to " << socket_.PeerEndpoint()
                 << " - connection stopped.";
     InvokeSentFunctor(message_sent_functor, kSendFailure);
-    FinishSendAndQueueNext();
     return DoClose(boost::asio::error::not_connected);
   }
   socket_.AsyncWrite(
-      boost::asio::buffer(send_buffer_), message_sent_functor,
-      strand_.wrap(std::bind(&Connection::HandleWrite, shared_from_this(), message_sent_functor)));
+      std::move(data), priority, in_order, message_sent_functor,
+      strand_.wrap(MakeAllocHandler(
+          write_allocator_,
+          std::bind(&Connection::HandleWrite, shared_from_this(), message_sent_functor))));
 }
 
 void Connection::HandleWrite(MessageSentFunctor message_sent_functor) {
-  // Message has now been fully sent, so safe to start sending next.  message_sent_functor will be
-  // invoked by Socket::HandleAck once peer has acknowledged receipt.
-  FinishSendAndQueueNext();
+  // Message has now been fully added to the send window.  message_sent_functor will be invoked by
+  // Socket::HandleAck once peer has acknowledged receipt.
   if (Stopped()) {
     LOG(kError) << "Failed to write from " << *multiplexer_ << " to " << socket_.PeerEndpoint()
                 << " - connection stopped.";
@@ -592,14 +691,14 @@ void Connection::HandleWrite(MessageSentFunctor message_sent_functor) {
 void Connection::StartProbing() {
   failed_probe_count_ = 0;
   probe_interval_timer_.expires_from_now(Parameters::keepalive_interval);
-  probe_interval_timer_.async_wait(
-      strand_.wrap(std::bind(&Connection::DoProbe, shared_from_this(), args::_1)));
+  probe_interval_timer_.async_wait(strand_.wrap(MakeAllocHandler(
+      probe_allocator_, std::bind(&Connection::DoProbe, shared_from_this(), args::_1))));
 }
 
 void Connection::DoProbe(const bs::error_code& ec) {
   if ((boost::asio::error::operation_aborted != ec) && !Stopped()) {
-    socket_.AsyncProbe(
-        strand_.wrap(std::bind(&Connection::HandleProbe, shared_from_this(), args::_1)));
+    socket_.AsyncProbe(strand_.wrap(MakeAllocHandler(
+        probe_allocator_, std::bind(&Connection::HandleProbe, shared_from_this(), args::_1))));
   }
 }
 
@@ -641,10 +740,17 @@ std::string Connection::PeerDebugId() const {
 }
 
 void Connection::FireOnConnectFunctor(const Error& error) {
-  if (on_connect_) {
-    auto h(std::move(on_connect_));
-    on_connect_ = nullptr;
-    h(error, shared_from_this());
+  // on_connect_ is only touched here on strand_, but the handler runs on the transport's strand,
+  // which differs from strand_ when the connection has a strand of its own.
+  if (!on_connect_)
+    return;
+  OnConnect handler;
+  handler.swap(on_connect_);
+  auto self = shared_from_this();
+  if (std::shared_ptr<Transport> transport = transport_.lock()) {
+    transport->strand_.dispatch([transport, self, handler, error]() { handler(error, self); });
+  } else {
+    handler(error, self);
   }
 }
 
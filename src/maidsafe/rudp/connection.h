@@ -21,10 +21,13 @@
 #ifndef MAIDSAFE_RUDP_CONNECTION_H_
 #define MAIDSAFE_RUDP_CONNECTION_H_
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <string>
 #include <vector>
 
@@ -33,7 +36,10 @@
 #include "boost/asio/ip/udp.hpp"
 #include "boost/asio/strand.hpp"
 
+#include "maidsafe/rudp/core/handler_allocator.h"
+#include "maidsafe/rudp/core/mpsc_queue.h"
 #include "maidsafe/rudp/core/socket.h"
+#include "maidsafe/rudp/packets/shared_buffer.h"
 #include "maidsafe/rudp/transport.h"
 
 namespace maidsafe {
@@ -68,9 +74,11 @@ class Connection : public std::enable_shared_from_this<Connection> {
   using Error         = boost::system::error_code;
   using OnConnect     = std::function<void(const Error&, const ConnectionPtr&)>;
 
+  // If own_strand is true, the connection runs on a strand of its own rather than the given one,
+  // which is the multiplexer's, and its socket hands received packets off to that strand.
   Connection(const std::shared_ptr<Transport>& transport,
              const boost::asio::io_service::strand& strand,
-             std::shared_ptr<Multiplexer> multiplexer);
+             std::shared_ptr<Multiplexer> multiplexer, bool own_strand = false);
 
   detail::Socket& Socket();
 
@@ -86,8 +94,18 @@ class Connection : public std::enable_shared_from_this<Connection> {
                        const std::function<void()>& failure_functor);
   void Ping(const NodeId& peer_node_id, const boost::asio::ip::udp::endpoint& peer_endpoint,
             const std::function<void(int)>& ping_functor);  // NOLINT (Fraser)
-  void StartSending(const std::string& data,
+  // Selects the congestion control algorithm for this node's sends on the connection.  May be
+  // called from any thread.
+  void SetCongestionControlAlgorithm(Parameters::CongestionControlAlgorithm algorithm);
+  // May be called from any thread without locking.  The message is queued and the queue is drained
+  // on strand_, which is only posted to when no drain is already pending.  If in_order is false,
+  // the peer hands the message up as soon as all of its own packets have arrived.
+  void StartSending(const SharedBuffer& data, Parameters::MessagePriority priority, bool in_order,
                     const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
+  // Sends the chunks supplied by source as a single streamed message, pulling the next chunk only
+  // once the previous one has been added to the send window.
+  void StartSendingStream(const StreamSourceFunctor& source, Parameters::MessagePriority priority,
+                          const std::function<void(int)>& message_sent_functor);  // NOLINT
   State state() const;
   // Sets the state_ to kPermanent or kUnvalidated and sets the lifespan_timer_ to expire at
   // pos_infin.
@@ -109,20 +127,40 @@ class Connection : public std::enable_shared_from_this<Connection> {
   Connection& operator=(const Connection&);
 
   struct SendRequest {
-    std::string encrypted_data_;
+    SharedBuffer encrypted_data_;
+    Parameters::MessagePriority priority_;
+    bool in_order_;
     std::function<void(int)> message_sent_functor_;  // NOLINT (Dan)
 
-    SendRequest(std::string encrypted_data,
+    SendRequest() : encrypted_data_(), priority_(Parameters::kNormalPriority), in_order_(true),
+                    message_sent_functor_() {}
+    SendRequest(SharedBuffer encrypted_data, Parameters::MessagePriority priority, bool in_order,
                 std::function<void(int)> message_sent_functor)  // NOLINT (Dan)
-#if defined(__GLIBCXX__)
-//  && __GLIBCXX__ < date (date in format of 20141218 as the date of fix of COW string)
-        : encrypted_data_(encrypted_data.data(), encrypted_data.size()),
-#else
         : encrypted_data_(std::move(encrypted_data)),
-#endif
+          priority_(priority),
+          in_order_(in_order),
           message_sent_functor_(std::move(message_sent_functor)) {}
   };
 
+  // A stream being sent.  Chunks are pulled from source one ahead of the part being written, so
+  // that the last part can be marked as such.
+  struct OutgoingStream {
+    OutgoingStream(StreamSourceFunctor source_in, Parameters::MessagePriority priority_in,
+                   std::function<void(int)> message_sent_functor_in)  // NOLINT (Fraser)
+        : source(std::move(source_in)),
+          priority(priority_in),
+          message_sent_functor(std::move(message_sent_functor_in)),
+          message_number(0),
+          next_part(),
+          more(true) {}
+    StreamSourceFunctor source;
+    Parameters::MessagePriority priority;
+    std::function<void(int)> message_sent_functor;  // NOLINT (Fraser)
+    uint32_t message_number;
+    std::vector<SharedBuffer> next_part;
+    bool more;
+  };
+
   void DoClose(const Error&);
 
   void DoStartConnecting(const NodeId& peer_node_id,
@@ -133,9 +171,14 @@ class Connection : public std::enable_shared_from_this<Connection> {
                          const std::function<void(int)>& ping_functor,  // NOLINT (Fraser)
                          const OnConnect& on_connect,
                          const std::function<void()>& failure_functor);
+  void DrainSendQueue();
   void DoStartSending(SendRequest const request);  // NOLINT (Fraser)
-  void DoQueueSendRequest(SendRequest request);
-  void FinishSendAndQueueNext();
+  void DoStartSendingStream(std::shared_ptr<OutgoingStream> stream);
+  // Pulls chunks from the stream's source until one is non-empty or the source is exhausted.
+  void PullStreamChunk(OutgoingStream& stream);
+  void WriteStreamPart(std::shared_ptr<OutgoingStream> stream);
+  void HandleStreamPartWritten(std::shared_ptr<OutgoingStream> stream, bool last,
+                               const boost::system::error_code& ec);
 
   void CheckTimeout(const boost::system::error_code& ec);
   void CheckLifespanTimeout(const boost::system::error_code& ec);
@@ -152,13 +195,17 @@ class Connection : public std::enable_shared_from_this<Connection> {
   void HandleConnect(const boost::system::error_code& ec, const std::string& validation_data,
                      std::function<void(int)> ping_functor);  // NOLINT (Fraser)
 
-  void StartReadSize();
-  void HandleReadSize(const boost::system::error_code& ec);
-
-  void StartReadData();
-  void HandleReadData(const boost::system::error_code& ec, size_t length);
-
-  void StartWrite(const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
+  void StartReadMessage();
+  void HandleReadMessage(const boost::system::error_code& ec);
+  // Queues a chunk of an incoming stream, handing it up at once unless an earlier chunk of the
+  // same stream is still with the consumer.
+  void QueueStreamChunk(uint64_t stream_id, std::string chunk, bool last);
+  void SignalNextStreamChunk(uint64_t stream_id);
+  void HandleStreamChunkConsumed(uint64_t stream_id, size_t size);
+
+  void StartWrite(std::vector<SharedBuffer> data, Parameters::MessagePriority priority,
+                  bool in_order,
+                  const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
   void HandleWrite(std::function<void(int)> message_sent_functor);        // NOLINT (Fraser)
 
   void StartProbing();
@@ -167,14 +214,26 @@ class Connection : public std::enable_shared_from_this<Connection> {
 
   void DoMakePermanent(bool validated);
 
-  void EncodeData(const std::string& data);
+  // Returns the size prefix and data of a message, as separate gather segments.
+  std::vector<SharedBuffer> EncodeData(const SharedBuffer& data) const;
 
   void InvokeSentFunctor(const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
                          int result) const;
 
+  // Takes on_connect_ on strand_ and invokes it on the transport's strand.
   void FireOnConnectFunctor(const Error&);
 
+  // Has packets received for the socket queued on the multiplexer's strand and handled on strand_.
+  void StartHandingOffPackets();
+
   std::weak_ptr<Transport> transport_;
+  MpscQueue<SendRequest> send_queue_;
+  std::atomic<bool> send_queue_drain_pending_;
+  // Recycle the memory of the handlers for the operations which repeat for as long as the
+  // connection is open, one allocator per kind of operation.
+  HandlerAllocator read_allocator_, write_allocator_, tick_allocator_, probe_allocator_,
+      handoff_allocator_, send_queue_allocator_;
+  const bool own_strand_;
   boost::asio::io_service::strand strand_;
   std::shared_ptr<Multiplexer> multiplexer_;
   detail::Socket socket_;
@@ -182,19 +241,33 @@ class Connection : public std::enable_shared_from_this<Connection> {
   boost::asio::deadline_timer timer_, probe_interval_timer_, lifespan_timer_;
   NodeId peer_node_id_;
   boost::asio::ip::udp::endpoint peer_endpoint_;
-  std::vector<unsigned char> send_buffer_, receive_buffer_;
-  DataSize data_size_, data_received_;
+  // The message being received, assembled directly from its packets by the socket, or a piece of
+  // a streamed message.
+  std::string receive_message_;
+  Receiver::MessagePiece receive_piece_;
+  // The ids given to the streamed messages being received, by message number.
+  std::map<uint32_t, uint64_t> incoming_streams_;
+  // Chunks of incoming streams waiting for the consumer, by stream id.  Only one chunk of each
+  // stream is handed up at a time, so that they are consumed in order, but other messages carry on
+  // being read meanwhile.  Reading pauses only while queued_stream_bytes_ is over the limit.
+  struct PendingStreamChunks {
+    PendingStreamChunks() : chunks(), chunk_with_consumer(false) {}
+    std::deque<std::pair<std::string, bool>> chunks;
+    bool chunk_with_consumer;
+  };
+  std::map<uint64_t, PendingStreamChunks> pending_stream_chunks_;
+  size_t queued_stream_bytes_;
+  bool read_paused_;
   uint8_t failed_probe_count_;
   State state_;
+  // Guards state_ and failure_functor_, which are also read on the transport's strand.
   mutable std::mutex state_mutex_;
   enum class TimeoutState {
     kConnecting,
     kConnected,
     kClosing
   } timeout_state_;
-  bool sending_;
   std::function<void()> failure_functor_;
-  std::queue<SendRequest> send_queue_;
   std::mutex handle_tick_lock_;
 
   OnConnect on_connect_;
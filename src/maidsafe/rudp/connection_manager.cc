@@ -20,7 +20,9 @@
 
 #include <algorithm>
 #include <cassert>
+#include <limits>
 #include <utility>
+#include <vector>
 
 #include "maidsafe/common/log.h"
 
@@ -45,27 +47,60 @@ namespace {
 
 typedef boost::asio::ip::udp::endpoint Endpoint;
 
+// The number of packets which can be waiting to be forwarded from one shard to another.
+const size_t kShardLinkCapacity(256);
+
 bool IsNormal(std::shared_ptr<Connection> connection) {
   return connection->state() == Connection::State::kPermanent ||
          connection->state() == Connection::State::kUnvalidated ||
          connection->state() == Connection::State::kBootstrapping;
 }
 
+template <typename Index>
+void EraseFromIndex(Index& index, const typename Index::key_type& key, uint32_t id) {
+  auto range(index.equal_range(key));
+  for (auto itr(range.first); itr != range.second; ++itr) {
+    if (itr->second == id) {
+      index.erase(itr);
+      return;
+    }
+  }
+}
+
 }  // unnamed namespace
 
 ConnectionManager::ConnectionManager(std::shared_ptr<Transport> transport,
                                      const boost::asio::io_service::strand& strand,
                                      MultiplexerPtr multiplexer, NodeId this_node_id,
                                      std::shared_ptr<asymm::PublicKey> this_public_key)
+    : ConnectionManager(std::move(transport),
+                        std::vector<MultiplexerShard>(1, MultiplexerShard(strand, multiplexer)),
+                        std::move(this_node_id), std::move(this_public_key)) {}
+
+ConnectionManager::ConnectionManager(std::shared_ptr<Transport> transport,
+                                     std::vector<MultiplexerShard> shards, NodeId this_node_id,
+                                     std::shared_ptr<asymm::PublicKey> this_public_key)
     : connections_(),
+      published_connections_(std::make_shared<const ConnectionGroup>()),
       mutex_(),
       transport_(transport),
-      strand_(strand),
-      multiplexer_(std::move(multiplexer)),
+      strand_(shards.front().strand),
+      multiplexer_(shards.front().multiplexer),
+      shards_(std::move(shards)),
+      shard_links_(),
+      next_shard_(0),
       kThisNodeId_(std::move(this_node_id)),
       this_public_key_(std::move(this_public_key)),
-      sockets_() {
-  multiplexer_->dispatcher_.SetConnectionManager(this);
+      sockets_mutex_(),
+      sockets_(std::make_shared<const SocketTable>()) {
+  for (size_t from(0); from != shards_.size(); ++from) {
+    for (size_t to(0); to != shards_.size(); ++to) {
+      shard_links_.push_back(from == to ? nullptr
+                                        : std::make_shared<ShardLink>(kShardLinkCapacity));
+    }
+  }
+  for (const auto& shard : shards_)
+    shard.multiplexer->dispatcher_.SetConnectionManager(this);
 }
 
 ConnectionManager::~ConnectionManager() {
@@ -75,13 +110,15 @@ ConnectionManager::~ConnectionManager() {
 void ConnectionManager::Close() {
   std::lock_guard<std::mutex> lock(mutex_);
 
-  for (auto connection : connections_) {
+  for (const auto& element : connections_) {
+    ConnectionPtr connection(element.second);
     strand_.post([connection]() {
         connection->Close();
         });
   }
 
-  multiplexer_->dispatcher_.SetConnectionManager(nullptr);
+  for (const auto& shard : shards_)
+    shard.multiplexer->dispatcher_.SetConnectionManager(nullptr);
 }
 
 bool ConnectionManager::CanStartConnectingTo(NodeId peer_id, Endpoint peer_ep) const {
@@ -112,7 +149,8 @@ void ConnectionManager::Connect(const NodeId& peer_id, const Endpoint& peer_endp
                                 const bptime::time_duration& connect_attempt_timeout,
                                 const bptime::time_duration& lifespan,
                                 OnConnect on_connect,
-                                const std::function<void()>& failure_functor) {
+                                const std::function<void()>& failure_functor,
+                                Parameters::CongestionControlAlgorithm algorithm) {
   std::lock_guard<std::mutex> lock(mutex_);
 
   auto transport = transport_.lock();
@@ -131,8 +169,10 @@ void ConnectionManager::Connect(const NodeId& peer_id, const Endpoint& peer_endp
 
   being_connected_.insert(std::make_pair(peer_id, peer_endpoint));
 
-  auto connection = std::make_shared<Connection>(transport, strand_, multiplexer_);
+  auto connection = MakeConnection(transport);
 
+  // Both are queued on the connection's strand, so the algorithm is in place before connecting.
+  connection->SetCongestionControlAlgorithm(algorithm);
   connection->StartConnecting(peer_id, peer_endpoint, validation_data, connect_attempt_timeout,
                               lifespan, on_connect, failure_functor);
 }
@@ -146,8 +186,17 @@ int ConnectionManager::AddConnection(ConnectionPtr connection) {
   if (!IsNormal(connection))
     return kInvalidConnection;
   std::lock_guard<std::mutex> lock(mutex_);
-  auto result(connections_.insert(connection));
-  return result.second ? kSuccess : kConnectionAlreadyExists;
+  HashedNodeId peer_id(connection->Socket().PeerNodeId());
+  auto range(connections_.equal_range(peer_id));
+  if (std::any_of(range.first, range.second,
+                  [&connection](const ConnectionGroup::value_type& element) {
+                    return element.second == connection;
+                  })) {
+    return kConnectionAlreadyExists;
+  }
+  connections_.emplace(std::move(peer_id), connection);
+  PublishConnections();
+  return kSuccess;
 }
 
 bool ConnectionManager::CloseConnection(const NodeId& peer_id) {
@@ -158,7 +207,7 @@ bool ConnectionManager::CloseConnection(const NodeId& peer_id) {
     return false;
   }
 
-  ConnectionPtr connection(*itr);
+  ConnectionPtr connection(itr->second);
   lock.unlock();
   strand_.dispatch([=] { connection->Close(); });  // NOLINT (Fraser)
   return true;
@@ -168,7 +217,20 @@ void ConnectionManager::RemoveConnection(ConnectionPtr connection) {
   std::lock_guard<std::mutex> lock(mutex_);
   assert(IsNormal(connection) || connection->state() == Connection::State::kDuplicate);
   MarkDoneConnecting(connection->PeerNodeId(), connection->PeerEndpoint());
-  connections_.erase(connection);
+  auto is_connection([&connection](const ConnectionGroup::value_type& element) {
+    return element.second == connection;
+  });
+  const NodeId peer_id(connection->Socket().PeerNodeId());
+  auto range(connections_.equal_range(HashedNodeId(peer_id, HashedNodeId::kReference)));
+  auto itr(std::find_if(range.first, range.second, is_connection));
+  if (itr == range.second) {
+    // The connection's peer id can't have changed since it was added, but fall back to a search.
+    itr = std::find_if(connections_.begin(), connections_.end(), is_connection);
+    if (itr == connections_.end())
+      return;
+  }
+  connections_.erase(itr);
+  PublishConnections();
 }
 
 ConnectionManager::ConnectionPtr ConnectionManager::GetConnection(const NodeId& peer_id) {
@@ -178,114 +240,145 @@ ConnectionManager::ConnectionPtr ConnectionManager::GetConnection(const NodeId&
     LOG(kInfo) << kThisNodeId_ << " Not currently connected to " << peer_id;
     return ConnectionPtr();
   }
-  return *itr;
+  return itr->second;
 }
 
 void ConnectionManager::Ping(const NodeId& peer_id, const Endpoint& peer_endpoint,
                              const std::function<void(int)>& ping_functor) {  // NOLINT (Fraser)
   if (std::shared_ptr<Transport> transport = transport_.lock()) {
     assert(ping_functor);
-    ConnectionPtr connection(std::make_shared<Connection>(transport, strand_, multiplexer_));
+    ConnectionPtr connection(MakeConnection(transport));
     connection->Ping(peer_id, peer_endpoint, ping_functor);
   } else {
     assert(0 && "Transport already closed");
   }
 }
 
-bool ConnectionManager::Send(const NodeId& peer_id, const std::string& message,
+bool ConnectionManager::Send(const NodeId& peer_id, const SharedBuffer& message,
+                             Parameters::MessagePriority priority, bool in_order,
                              const std::function<void(int)>& message_sent_functor) {  // NOLINT
-  std::unique_lock<std::mutex> lock(mutex_);
-  auto itr(FindConnection(peer_id));
-  if (itr == connections_.end()) {
+  const std::shared_ptr<const ConnectionGroup> connections(
+      std::atomic_load(&published_connections_));
+  auto itr(connections->find(HashedNodeId(peer_id, HashedNodeId::kReference)));
+  if (itr == connections->end()) {
     LOG(kWarning) << kThisNodeId_ << " Not currently connected to " << peer_id;
     return false;
   }
 
-  ConnectionPtr connection(*itr);
-  lock.unlock();
-  // using COW std::string will cause thread sanitizer warning of data racing
-  std::shared_ptr<std::string> message_ptr(new std::string(message.data(), message.size()));
-  strand_.dispatch([=] { connection->StartSending(*message_ptr, message_sent_functor); });
+  // Safe from any thread; the connection queues the message for its own strand.
+  itr->second->StartSending(message, priority, in_order, message_sent_functor);
   return true;
 }
 
-Socket* ConnectionManager::GetSocket(const boost::asio::const_buffer& data,
-                                     const Endpoint& endpoint) {
-  uint32_t socket_id(0);
-  if (!Packet::DecodeDestinationSocketId(&socket_id, data)) {
+bool ConnectionManager::SendStream(
+    const NodeId& peer_id, const StreamSourceFunctor& source, Parameters::MessagePriority priority,
+    const std::function<void(int)>& message_sent_functor) {  // NOLINT
+  const std::shared_ptr<const ConnectionGroup> connections(
+      std::atomic_load(&published_connections_));
+  auto itr(connections->find(HashedNodeId(peer_id, HashedNodeId::kReference)));
+  if (itr == connections->end()) {
+    LOG(kWarning) << kThisNodeId_ << " Not currently connected to " << peer_id;
+    return false;
+  }
+
+  // Safe from any thread; the connection posts the stream onto its own strand.
+  itr->second->StartSendingStream(source, priority, message_sent_functor);
+  return true;
+}
+
+std::shared_ptr<Socket> ConnectionManager::GetSocket(const boost::asio::const_buffer& data,
+                                                     const Endpoint& endpoint,
+                                                     uint32_t* socket_id, bool* retarget) {
+  *retarget = false;
+  if (!Packet::DecodeDestinationSocketId(socket_id, data)) {
     LOG(kError) << kThisNodeId_ << " Received a non-RUDP packet from " << endpoint;
     return nullptr;
   }
 
-  SocketMap::const_iterator socket_iter(sockets_.end());
-  if (socket_id == 0) {
-    HandshakePacket handshake_packet;
-    if (!handshake_packet.Decode(data)) {
-      LOG(kVerbose) << kThisNodeId_ << " Failed to decode handshake packet from "
-                    << endpoint;
-      return nullptr;
-    }
-    if (handshake_packet.ConnectionReason() == Session::kNormal) {
-      // This is a handshake packet on a newly-added socket
-      LOG(kVerbose) << kThisNodeId_
-                    << " This is a handshake packet on a newly-added socket from " << endpoint;
-      socket_iter = std::find_if(sockets_.begin(), sockets_.end(),
-                                 [endpoint](const SocketMap::value_type & socket_pair) {
-        return socket_pair.second->PeerEndpoint() == endpoint && !socket_pair.second->IsConnected();
-      });
-      // If the socket wasn't found, this could be a connect attempt from a peer using symmetric
-      // NAT, so the peer's port may be different to what this node was told to expect.
-      if (socket_iter == sockets_.end()) {
-        socket_iter = std::find_if(sockets_.begin(), sockets_.end(),
-                                   [endpoint](const SocketMap::value_type & socket_pair) {
-          return socket_pair.second->PeerEndpoint().address() == endpoint.address() &&
-                 !OnPrivateNetwork(socket_pair.second->PeerEndpoint()) &&
-                 !socket_pair.second->IsConnected();
-        });
-        if (socket_iter != sockets_.end()) {
-          LOG(kVerbose) << kThisNodeId_ << " Updating peer's endpoint from "
-                        << socket_iter->second->PeerEndpoint() << " to " << endpoint;
-          socket_iter->second->UpdatePeerEndpoint(endpoint);
-          LOG(kVerbose) << kThisNodeId_
-                        << " Peer's endpoint now: " << socket_iter->second->PeerEndpoint()
-                        << "  and guessed port = " << socket_iter->second->PeerGuessedPort();
-        }
+  if (*socket_id == 0)
+    return FindHandshakeSocket(data, endpoint, socket_id, retarget);
+
+  // This packet is intended for a specific connection.  Only a snapshot of the socket table is read
+  // here, so no lock is taken on the receive path.
+  const SocketTablePtr sockets(std::atomic_load(&sockets_));
+  auto socket_iter(sockets->by_id.find(*socket_id));
+  if (socket_iter != sockets->by_id.end())
+    return socket_iter->second.Lock();
+
+  const unsigned char* p = boost::asio::buffer_cast<const unsigned char*>(data);
+  LOG(kVerbose) << kThisNodeId_ << "  Received a packet \"0x" << std::hex
+                << static_cast<int>(*p) << std::dec << "\" for unknown connection " << *socket_id
+                << " from " << endpoint;
+  return nullptr;
+}
+
+std::shared_ptr<Socket> ConnectionManager::FindHandshakeSocket(
+    const boost::asio::const_buffer& data, const Endpoint& endpoint, uint32_t* socket_id,
+    bool* retarget) {
+  uint32_t connection_reason(0);
+  if (!HandshakePacket::DecodeConnectionReason(&connection_reason, data)) {
+    LOG(kVerbose) << kThisNodeId_ << " Failed to decode handshake packet from " << endpoint;
+    return nullptr;
+  }
+
+  const SocketTablePtr sockets(std::atomic_load(&sockets_));
+  auto peer_range(sockets->by_endpoint.equal_range(endpoint));
+  if (connection_reason == Session::kNormal) {
+    // This is a handshake packet on a newly-added socket
+    LOG(kVerbose) << kThisNodeId_
+                  << " This is a handshake packet on a newly-added socket from " << endpoint;
+    for (auto itr(peer_range.first); itr != peer_range.second; ++itr) {
+      std::shared_ptr<Socket> socket(sockets->by_id.at(itr->second).Lock());
+      if (socket && !socket->IsConnectedForDispatch()) {
+        *socket_id = itr->second;
+        return socket;
       }
-    } else {  // Session::mode_ != kNormal
-      socket_iter = std::find_if(sockets_.begin(), sockets_.end(),
-                                 [endpoint](const SocketMap::value_type & socket_pair) {
-        return socket_pair.second->PeerEndpoint() == endpoint;
-      });
-      if (socket_iter == sockets_.end()) {
-        // This is a handshake packet from a peer trying to ping this node or join the network
-        HandlePingFrom(handshake_packet, endpoint);
+    }
+    // If the socket wasn't found, this could be a connect attempt from a peer using symmetric
+    // NAT, so the peer's port may be different to what this node was told to expect.
+    auto address_range(sockets->by_address.equal_range(endpoint.address()));
+    for (auto itr(address_range.first); itr != address_range.second; ++itr) {
+      const SocketEntry& entry(sockets->by_id.at(itr->second));
+      if (OnPrivateNetwork(entry.peer_endpoint))
+        continue;
+      std::shared_ptr<Socket> socket(entry.Lock());
+      if (!socket || socket->IsConnectedForDispatch())
+        continue;
+      // The socket updates its peer endpoint and is re-indexed on its own strand.
+      LOG(kVerbose) << kThisNodeId_ << " Retargeting socket " << itr->second << " from "
+                    << entry.peer_endpoint << " to " << endpoint;
+      *socket_id = itr->second;
+      *retarget = true;
+      return socket;
+    }
+  } else {  // Session::mode_ != kNormal
+    if (peer_range.first == peer_range.second) {
+      // This is a handshake packet from a peer trying to ping this node or join the network
+      HandshakePacket handshake_packet;
+      if (!handshake_packet.Decode(data)) {
+        LOG(kVerbose) << kThisNodeId_ << " Failed to decode handshake packet from "
+                      << endpoint;
         return nullptr;
-      } else {
-        if (sockets_.size() == 1U) {
-          // This is a handshake packet from a peer replying to this node's join attempt,
-          // or from a peer starting a zero state network with this node
-          LOG(kVerbose) << kThisNodeId_ << " This is a handshake packet from " << endpoint
-                        << " which is replying to a join request, or starting a new network";
-        } else {
-          LOG(kVerbose) << kThisNodeId_ << " This is a handshake packet from " << endpoint
-                        << " which is replying to a ping request";
-        }
       }
+      HandlePingFrom(handshake_packet, endpoint);
+      return nullptr;
     }
-  } else {
-    // This packet is intended for a specific connection.
-    socket_iter = sockets_.find(socket_id);
+    if (sockets->by_id.size() == 1U) {
+      // This is a handshake packet from a peer replying to this node's join attempt,
+      // or from a peer starting a zero state network with this node
+      LOG(kVerbose) << kThisNodeId_ << " This is a handshake packet from " << endpoint
+                    << " which is replying to a join request, or starting a new network";
+    } else {
+      LOG(kVerbose) << kThisNodeId_ << " This is a handshake packet from " << endpoint
+                    << " which is replying to a ping request";
+    }
+    *socket_id = peer_range.first->second;
+    return sockets->by_id.at(*socket_id).Lock();
   }
 
-  if (socket_iter != sockets_.end()) {
-    return socket_iter->second;
-  } else {
-    const unsigned char* p = boost::asio::buffer_cast<const unsigned char*>(data);
-    LOG(kVerbose) << kThisNodeId_ << "  Received a packet \"0x" << std::hex
-                  << static_cast<int>(*p) << std::dec << "\" for unknown connection " << socket_id
-                  << " from " << endpoint;
-    return nullptr;
-  }
+  LOG(kVerbose) << kThisNodeId_ << "  Received a handshake packet for unknown connection from "
+                << endpoint;
+  return nullptr;
 }
 
 void ConnectionManager::HandlePingFrom(const HandshakePacket& handshake_packet,
@@ -308,7 +401,7 @@ void ConnectionManager::HandlePingFrom(const HandshakePacket& handshake_packet,
     std::lock_guard<std::mutex> lock(mutex_);
     auto itr(FindConnection(handshake_packet.node_id()));
     if (itr != connections_.end() && !bootstrap_and_drop)
-      joining_connection = *itr;
+      joining_connection = itr->second;
   }
   if (joining_connection) {
     LOG(kWarning) << kThisNodeId_ << " received another bootstrap connection request "
@@ -338,10 +431,10 @@ bool ConnectionManager::MakeConnectionPermanent(const NodeId& peer_id, bool vali
     LOG(kWarning) << kThisNodeId_ << " Not currently connected to " << peer_id;
     return false;
   }
-  (*itr)->MakePermanent(validated);
+  itr->second->MakePermanent(validated);
   // TODO(Fraser#5#): 2012-09-11 - Handle passing back peer_endpoint iff it's direct-connected.
-  if (!OnPrivateNetwork((*itr)->Socket().PeerEndpoint()))
-    peer_endpoint = (*itr)->Socket().PeerEndpoint();
+  if (!OnPrivateNetwork(itr->second->Socket().PeerEndpoint()))
+    peer_endpoint = itr->second->Socket().PeerEndpoint();
   return true;
 }
 
@@ -350,11 +443,12 @@ Endpoint ConnectionManager::ThisEndpoint(const NodeId& peer_id) {
   auto itr(FindConnection(peer_id));
   if (itr == connections_.end())
     return Endpoint();
-  return (*itr)->Socket().ThisEndpoint();
+  return itr->second->Socket().ThisEndpoint();
 }
 
 void ConnectionManager::SetBestGuessExternalEndpoint(const Endpoint& external_endpoint) {
-  multiplexer_->best_guess_external_endpoint_ = external_endpoint;
+  for (const auto& shard : shards_)
+    shard.multiplexer->best_guess_external_endpoint_ = external_endpoint;
 }
 
 Endpoint ConnectionManager::RemoteNatDetectionEndpoint(const NodeId& peer_id) {
@@ -362,22 +456,124 @@ Endpoint ConnectionManager::RemoteNatDetectionEndpoint(const NodeId& peer_id) {
   auto itr(FindConnection(peer_id));
   if (itr == connections_.end())
     return Endpoint();
-  return (*itr)->Socket().RemoteNatDetectionEndpoint();
+  return itr->second->Socket().RemoteNatDetectionEndpoint();
 }
 
-uint32_t ConnectionManager::AddSocket(Socket* socket) {
-  // Generate a new unique id for the socket.
+uint32_t ConnectionManager::AddSocket(Socket* socket, const std::weak_ptr<void>& owner,
+                                      uint32_t shard_index, uint32_t shard_count) {
+  std::lock_guard<std::mutex> lock(sockets_mutex_);
+  std::shared_ptr<SocketTable> sockets(std::make_shared<SocketTable>(*sockets_));
+  // Generate a new unique id for the socket, belonging to the given shard.
+  const uint32_t kIdsPerShard(std::numeric_limits<uint32_t>::max() / shard_count);
   uint32_t id = 0;
-  while (id == 0 || sockets_.find(id) != sockets_.end())
-    id = RandomUint32();
+  while (id == 0 || sockets->by_id.find(id) != sockets->by_id.end())
+    id = (RandomUint32() % kIdsPerShard) * shard_count + shard_index;
 
-  sockets_[id] = socket;
+  SocketEntry entry = {socket, owner, !owner.expired(), socket->PeerEndpoint()};
+  sockets->Insert(id, entry);
+  std::atomic_store(&sockets_, SocketTablePtr(std::move(sockets)));
   return id;
 }
 
 void ConnectionManager::RemoveSocket(uint32_t id) {
-  if (id)
-    sockets_.erase(id);
+  if (!id)
+    return;
+  std::lock_guard<std::mutex> lock(sockets_mutex_);
+  if (sockets_->by_id.find(id) == sockets_->by_id.end())
+    return;
+  std::shared_ptr<SocketTable> sockets(std::make_shared<SocketTable>(*sockets_));
+  sockets->Erase(id);
+  std::atomic_store(&sockets_, SocketTablePtr(std::move(sockets)));
+}
+
+std::shared_ptr<Socket> ConnectionManager::GetSocket(uint32_t id) {
+  const SocketTablePtr sockets(std::atomic_load(&sockets_));
+  auto socket_iter(sockets->by_id.find(id));
+  return socket_iter == sockets->by_id.end() ? nullptr : socket_iter->second.Lock();
+}
+
+void ConnectionManager::ForwardToShard(uint32_t from_shard, uint32_t socket_id,
+                                       const boost::asio::const_buffer& data,
+                                       const Endpoint& endpoint, bool retarget) {
+  const uint32_t to_shard(socket_id % shards_.size());
+  std::shared_ptr<ShardLink> link(shard_links_[from_shard * shards_.size() + to_shard]);
+  assert(link);
+  ForwardedPacket forwarded;
+  forwarded.socket_id = socket_id;
+  if (!forwarded.packet.Assign(data, endpoint, retarget) ||
+      !link->packets.Push(std::move(forwarded))) {
+    LOG(kVerbose) << kThisNodeId_ << " Dropping packet from " << endpoint << " for shard "
+                  << to_shard << " while it is busy";
+    return;
+  }
+  if (link->drain_pending.exchange(true))
+    return;
+  // The socket is looked up again, and handles the packet, on its own shard's strand.
+  MultiplexerShard& shard(shards_[to_shard]);
+  std::shared_ptr<Multiplexer> multiplexer(shard.multiplexer);
+  shard.strand.post(MakeAllocHandler(link->allocator, [link, multiplexer]() {
+    DrainShardLink(*link, *multiplexer);
+  }));
+}
+
+void ConnectionManager::DrainShardLink(ShardLink& link, Multiplexer& multiplexer) {
+  ForwardedPacket forwarded;
+  for (;;) {
+    while (link.packets.Pop(forwarded)) {
+      multiplexer.dispatcher_.HandleForwardedFrom(forwarded.socket_id, forwarded.packet.Data(),
+                                                  forwarded.packet.endpoint,
+                                                  forwarded.packet.retarget);
+    }
+    // A packet queued after the ring was found empty, but before the flag is cleared, came without
+    // a drain being posted, so is handled here.
+    link.drain_pending.exchange(false);
+    if (link.packets.Empty() || link.drain_pending.exchange(true))
+      return;
+  }
+}
+
+ConnectionManager::ConnectionPtr ConnectionManager::MakeConnection(
+    const std::shared_ptr<Transport>& transport) {
+  const MultiplexerShard& shard(shards_[next_shard_++ % shards_.size()]);
+  // Connections only get strands of their own when there are spare threads to run them, since each
+  // received packet then has to be copied and handed off to its connection's strand.
+  bool own_strand(Parameters::thread_count > shards_.size());
+  return std::make_shared<Connection>(transport, shard.strand, shard.multiplexer, own_strand);
+}
+
+void ConnectionManager::ReindexSocket(uint32_t id, const Endpoint& peer_endpoint) {
+  std::lock_guard<std::mutex> lock(sockets_mutex_);
+  auto itr(sockets_->by_id.find(id));
+  if (itr == sockets_->by_id.end() || itr->second.peer_endpoint == peer_endpoint)
+    return;
+  std::shared_ptr<SocketTable> sockets(std::make_shared<SocketTable>(*sockets_));
+  SocketEntry entry(itr->second);
+  entry.peer_endpoint = peer_endpoint;
+  sockets->Erase(id);
+  sockets->Insert(id, entry);
+  std::atomic_store(&sockets_, SocketTablePtr(std::move(sockets)));
+}
+
+std::shared_ptr<Socket> ConnectionManager::SocketEntry::Lock() const {
+  if (!owned)
+    return std::shared_ptr<Socket>(std::shared_ptr<Socket>(), socket);
+  std::shared_ptr<void> locked_owner(owner.lock());
+  return locked_owner ? std::shared_ptr<Socket>(locked_owner, socket) : nullptr;
+}
+
+void ConnectionManager::SocketTable::Insert(uint32_t id, const SocketEntry& entry) {
+  by_id.insert(std::make_pair(id, entry));
+  by_endpoint.insert(std::make_pair(entry.peer_endpoint, id));
+  by_address.insert(std::make_pair(entry.peer_endpoint.address(), id));
+}
+
+void ConnectionManager::SocketTable::Erase(uint32_t id) {
+  auto itr(by_id.find(id));
+  if (itr == by_id.end())
+    return;
+  EraseFromIndex(by_endpoint, itr->second.peer_endpoint, id);
+  EraseFromIndex(by_address, itr->second.peer_endpoint.address(), id);
+  by_id.erase(itr);
 }
 
 size_t ConnectionManager::NormalConnectionsCount() const {
@@ -385,13 +581,17 @@ size_t ConnectionManager::NormalConnectionsCount() const {
   return connections_.size();
 }
 
-ConnectionManager::ConnectionGroup::iterator ConnectionManager::FindConnection(
+void ConnectionManager::PublishConnections() {
+  assert(!mutex_.try_lock());
+  std::atomic_store(&published_connections_,
+                    std::shared_ptr<const ConnectionGroup>(
+                        std::make_shared<ConnectionGroup>(connections_)));
+}
+
+ConnectionManager::ConnectionGroup::const_iterator ConnectionManager::FindConnection(
     const NodeId& peer_id) const {
   assert(!mutex_.try_lock());
-  return std::find_if(connections_.begin(), connections_.end(),
-                      [&peer_id](const ConnectionPtr & connection) {
-    return connection->Socket().PeerNodeId() == peer_id;
-  });
+  return connections_.find(HashedNodeId(peer_id, HashedNodeId::kReference));
 }
 
 NodeId ConnectionManager::node_id() const { return kThisNodeId_; }
@@ -401,7 +601,8 @@ std::shared_ptr<asymm::PublicKey> ConnectionManager::public_key() const { return
 std::string ConnectionManager::DebugString() {
   std::string s;
   std::lock_guard<std::mutex> lock(mutex_);
-  for (auto c : connections_) {
+  for (const auto& element : connections_) {
+    const ConnectionPtr& c(element.second);
     s += "\t\tPeer " + c->PeerDebugId();
     s += std::string("  ") + boost::lexical_cast<std::string>(c->state());
     s += std::string("   Expires in ") + bptime::to_simple_string(c->ExpiresFromNow()) + "\n";
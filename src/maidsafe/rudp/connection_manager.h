@@ -19,6 +19,7 @@
 #ifndef MAIDSAFE_RUDP_CONNECTION_MANAGER_H_
 #define MAIDSAFE_RUDP_CONNECTION_MANAGER_H_
 
+#include <atomic>
 #include <unordered_map>
 #include <cstdint>
 #include <functional>
@@ -28,6 +29,7 @@
 #include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "boost/asio/buffer.hpp"
 #include "boost/asio/strand.hpp"
@@ -37,6 +39,15 @@
 #include "maidsafe/common/node_id.h"
 #include "maidsafe/common/rsa.h"
 
+#include "maidsafe/rudp/hashed_node_id.h"
+#include "maidsafe/rudp/managed_connections.h"
+#include "maidsafe/rudp/parameters.h"
+#include "maidsafe/rudp/core/handler_allocator.h"
+#include "maidsafe/rudp/core/multiplexer_shard.h"
+#include "maidsafe/rudp/core/received_packet.h"
+#include "maidsafe/rudp/core/spsc_ring.h"
+#include "maidsafe/rudp/packets/shared_buffer.h"
+
 namespace maidsafe {
 
 namespace rudp {
@@ -61,6 +72,10 @@ class ConnectionManager {
                     const boost::asio::io_service::strand& strand,
                     std::shared_ptr<Multiplexer> multiplexer, NodeId this_node_id,
                     std::shared_ptr<asymm::PublicKey> this_public_key);
+  // The first shard is the transport's own strand and multiplexer.  New connections are spread
+  // across all the shards.
+  ConnectionManager(std::shared_ptr<Transport> transport, std::vector<MultiplexerShard> shards,
+                    NodeId this_node_id, std::shared_ptr<asymm::PublicKey> this_public_key);
   ~ConnectionManager();
 
   void Close();
@@ -70,7 +85,9 @@ class ConnectionManager {
                const boost::posix_time::time_duration& connect_attempt_timeout,
                const boost::posix_time::time_duration& lifespan,
                OnConnect on_connect,
-               const std::function<void()>& failure_functor);
+               const std::function<void()>& failure_functor,
+               Parameters::CongestionControlAlgorithm algorithm =
+                   Parameters::congestion_control_algorithm);
 
   int AddConnection(std::shared_ptr<Connection> connection);
   bool CloseConnection(const NodeId& peer_id);
@@ -80,8 +97,13 @@ class ConnectionManager {
   void Ping(const NodeId& peer_id, const Endpoint& peer_endpoint,
             const std::function<void(int)>& ping_functor);  // NOLINT (Fraser)
   // Returns false if the connection doesn't exist.
-  bool Send(const NodeId& peer_id, const std::string& message,
+  bool Send(const NodeId& peer_id, const SharedBuffer& message,
+            Parameters::MessagePriority priority, bool in_order,
             const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
+  // Returns false if the connection doesn't exist.
+  bool SendStream(const NodeId& peer_id, const StreamSourceFunctor& source,
+                  Parameters::MessagePriority priority,
+                  const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
 
   bool MakeConnectionPermanent(const NodeId& peer_id, bool validated, Endpoint& peer_endpoint);
 
@@ -95,13 +117,28 @@ class ConnectionManager {
   // Get the remote endpoint offered for NAT detection by peer.
   Endpoint RemoteNatDetectionEndpoint(const NodeId& peer_id);
 
-  // Add a socket. Returns a new unique id for the socket.
-  uint32_t AddSocket(Socket* socket);
+  // Add a socket, which owner (if not empty) contains. Returns a new unique id for the socket,
+  // congruent to shard_index modulo shard_count.
+  uint32_t AddSocket(Socket* socket, const std::weak_ptr<void>& owner, uint32_t shard_index,
+                     uint32_t shard_count);
   void RemoveSocket(uint32_t id);
+  // Re-indexes the socket under its updated peer endpoint.  Called on the socket's own strand.
+  void ReindexSocket(uint32_t id, const Endpoint& peer_endpoint);
   // Called by the Dispatcher when a new packet arrives for a socket.  Can return nullptr if no
-  // appropriate socket found.
-  Socket* GetSocket(const boost::asio::const_buffer& data,
-                    const Endpoint& endpoint);
+  // appropriate socket found, or if the socket's owner has been destroyed.  The returned pointer
+  // keeps the owner alive.  Sets socket_id to the socket's id, and retarget if the socket is to
+  // update its peer endpoint to endpoint (see Socket::HandleReceiveFrom).  Never touches the state
+  // of the socket, which belongs to the socket's own strand.
+  std::shared_ptr<Socket> GetSocket(const boost::asio::const_buffer& data,
+                                    const Endpoint& endpoint, uint32_t* socket_id,
+                                    bool* retarget);
+  std::shared_ptr<Socket> GetSocket(uint32_t id);
+  // Called by the Dispatcher, on from_shard's strand, when a packet arrives on a shard other than
+  // the one owning the socket it is for.  The packet is copied into a pooled buffer and queued for
+  // the owning shard's strand, or dropped if the queue is full.
+  void ForwardToShard(uint32_t from_shard, uint32_t socket_id,
+                      const boost::asio::const_buffer& data, const Endpoint& endpoint,
+                      bool retarget);
 
   size_t NormalConnectionsCount() const;
 
@@ -119,12 +156,60 @@ class ConnectionManager {
 
  private:
   typedef std::shared_ptr<Multiplexer> MultiplexerPtr;
-  typedef std::set<ConnectionPtr> ConnectionGroup;
-  // Map of destination socket id to corresponding socket object.
-  typedef std::unordered_map<uint32_t, Socket*> SocketMap;
+  // Connections indexed by their peer's id.  More than one connection to a peer can exist briefly,
+  // e.g. while a replaced connection is closing.
+  typedef std::unordered_multimap<HashedNodeId, ConnectionPtr, HashedNodeId::Hasher>
+      ConnectionGroup;
+  // A socket along with its owner and the peer endpoint under which it is indexed.
+  struct SocketEntry {
+    // Returns nullptr if the socket's owner has been destroyed.
+    std::shared_ptr<Socket> Lock() const;
+
+    Socket* socket;
+    std::weak_ptr<void> owner;
+    // False for a socket registered without an owner, whose lifetime is managed by its user.
+    bool owned;
+    Endpoint peer_endpoint;
+  };
+  // Sockets indexed by destination socket id, and by peer endpoint and address for routing
+  // handshakes, which carry no destination socket id.  Published as an immutable snapshot so that
+  // the receive path can read it without locking; writers copy, modify and swap.  A snapshot can
+  // still be in use after a socket has been removed from the table, so entries only hold weak
+  // references to the sockets' owners, and the receive path locks one for as long as it is
+  // handing a packet to the socket.
+  struct SocketTable {
+    void Insert(uint32_t id, const SocketEntry& entry);
+    void Erase(uint32_t id);
+
+    std::unordered_map<uint32_t, SocketEntry> by_id;
+    std::multimap<Endpoint, uint32_t> by_endpoint;
+    std::multimap<boost::asio::ip::address, uint32_t> by_address;
+  };
+  typedef std::shared_ptr<const SocketTable> SocketTablePtr;
+  struct ForwardedPacket {
+    ForwardedPacket() : socket_id(0), packet() {}
+    uint32_t socket_id;
+    ReceivedPacket packet;
+  };
+  // The packets forwarded from one shard to another.  Only the source shard's strand pushes and
+  // only the destination's pops, so neither side locks or allocates, and a drain is posted to the
+  // destination only when none is already pending.
+  struct ShardLink {
+    explicit ShardLink(size_t capacity) : packets(capacity), drain_pending(false), allocator() {}
+    SpscRing<ForwardedPacket> packets;
+    std::atomic<bool> drain_pending;
+    HandlerAllocator allocator;
+  };
 
   void HandlePingFrom(const HandshakePacket& handshake_packet, const Endpoint& endpoint);
-  ConnectionGroup::iterator FindConnection(const NodeId& peer_id) const;
+  // Creates a connection on the next shard in turn.
+  ConnectionPtr MakeConnection(const std::shared_ptr<Transport>& transport);
+  std::shared_ptr<Socket> FindHandshakeSocket(const boost::asio::const_buffer& data,
+                                              const Endpoint& endpoint, uint32_t* socket_id,
+                                              bool* retarget);
+  static void DrainShardLink(ShardLink& link, Multiplexer& multiplexer);
+  ConnectionGroup::const_iterator FindConnection(const NodeId& peer_id) const;
+  void PublishConnections();
 
   // TODO(PeterJ): Instead of using this set, it would be nicer if we
   // added a "not yet connected connection" into the connetions_ group
@@ -134,13 +219,21 @@ class ConnectionManager {
   // Because the connections can be in an idle state with no pending async operations, they are kept
   // alive with a shared_ptr in this set, as well as in the async operation handlers.
   ConnectionGroup connections_;
+  // A copy of connections_ republished after every change to it, so that Send can find a peer's
+  // connection without locking mutex_.
+  std::shared_ptr<const ConnectionGroup> published_connections_;
   mutable std::mutex mutex_;
   std::weak_ptr<Transport> transport_;
   boost::asio::io_service::strand strand_;
   std::shared_ptr<Multiplexer> multiplexer_;
+  std::vector<MultiplexerShard> shards_;
+  // Indexed by source shard * shard count + destination shard; null where the two are the same.
+  std::vector<std::shared_ptr<ShardLink>> shard_links_;
+  std::atomic<uint32_t> next_shard_;
   const NodeId kThisNodeId_;
   std::shared_ptr<asymm::PublicKey> this_public_key_;
-  SocketMap sockets_;
+  std::mutex sockets_mutex_;
+  SocketTablePtr sockets_;
 };
 
 }  // namespace detail
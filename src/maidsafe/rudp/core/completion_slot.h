@@ -0,0 +1,154 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_COMPLETION_SLOT_H_
+#define MAIDSAFE_RUDP_CORE_COMPLETION_SLOT_H_
+
+#include <new>
+#include <utility>
+
+#include "boost/asio/handler_alloc_hook.hpp"
+#include "boost/asio/handler_invoke_hook.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/assert.hpp"
+#include "boost/system/error_code.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Holds the handler of a pending asynchronous operation until the operation completes, at which
+// point the handler is posted to the io_service and invoked with a default error_code.  Stands in
+// for a timer which is waited on without expiring and cancelled to signal completion, without the
+// cost of the timer queue.  The handler's memory is allocated using its own allocation hooks.  Only
+// one handler may be pending at a time, and the slot is not thread-safe.
+class CompletionSlot {
+ public:
+  explicit CompletionSlot(boost::asio::io_service& asio_service)
+      : asio_service_(asio_service), pending_(nullptr) {}
+
+  // A handler still pending is destroyed without being invoked.
+  ~CompletionSlot() {
+    if (pending_)
+      pending_->Destroy();
+  }
+
+  template <typename Handler>
+  void Wait(Handler handler) {
+    BOOST_ASSERT(!pending_);
+    pending_ = PendingHandlerImpl<Handler>::Create(std::move(handler));
+  }
+
+  // Posts the pending handler, if there is one.
+  void Complete() {
+    if (PendingHandler* pending = pending_) {
+      pending_ = nullptr;
+      pending->Post(asio_service_);
+    }
+  }
+
+  bool Pending() const { return pending_ != nullptr; }
+
+ private:
+  // Disallow copying and assignment.
+  CompletionSlot(const CompletionSlot&);
+  CompletionSlot& operator=(const CompletionSlot&);
+
+  class PendingHandler {
+   public:
+    // Both free the pending handler.
+    virtual void Post(boost::asio::io_service& asio_service) = 0;
+    virtual void Destroy() = 0;
+
+   protected:
+    ~PendingHandler() {}
+  };
+
+  template <typename Handler>
+  class Invoker {
+   public:
+    explicit Invoker(Handler handler) : handler_(std::move(handler)) {}
+
+    void operator()() { handler_(boost::system::error_code()); }
+
+    friend void* asio_handler_allocate(size_t n, Invoker* invoker) {
+      using boost::asio::asio_handler_allocate;
+      return asio_handler_allocate(n, &invoker->handler_);
+    }
+
+    friend void asio_handler_deallocate(void* p, size_t n, Invoker* invoker) {
+      using boost::asio::asio_handler_deallocate;
+      asio_handler_deallocate(p, n, &invoker->handler_);
+    }
+
+    template <typename Function>
+    friend void asio_handler_invoke(Function f, Invoker* invoker) {
+      using boost::asio::asio_handler_invoke;
+      asio_handler_invoke(f, &invoker->handler_);
+    }
+
+   private:
+    Handler handler_;
+  };
+
+  template <typename Handler>
+  class PendingHandlerImpl : public PendingHandler {
+   public:
+    static PendingHandler* Create(Handler handler) {
+      using boost::asio::asio_handler_allocate;
+      void* memory(asio_handler_allocate(sizeof(PendingHandlerImpl), &handler));
+      return new (memory) PendingHandlerImpl(std::move(handler));
+    }
+
+    void Post(boost::asio::io_service& asio_service) override {
+      Handler handler(std::move(handler_));
+      Free(handler);
+      asio_service.post(Invoker<Handler>(std::move(handler)));
+    }
+
+    void Destroy() override {
+      Handler handler(std::move(handler_));
+      Free(handler);
+    }
+
+   private:
+    explicit PendingHandlerImpl(Handler handler) : handler_(std::move(handler)) {}
+
+    // The memory is freed using a copy of the handler, since the original is destroyed first.
+    void Free(Handler& handler) {
+      this->~PendingHandlerImpl();
+      using boost::asio::asio_handler_deallocate;
+      asio_handler_deallocate(this, sizeof(PendingHandlerImpl), &handler);
+    }
+
+    Handler handler_;
+  };
+
+  boost::asio::io_service& asio_service_;
+  PendingHandler* pending_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_COMPLETION_SLOT_H_
@@ -0,0 +1,283 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/congestion_algorithm.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+// Startup gain of 2/ln(2), the smallest which doubles the sending rate every round trip.
+const double kHighGain = 2.885;
+const double kProbeBandwidthGains[] = {1.25, 0.75, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0};
+const size_t kProbeBandwidthGainCount =
+    sizeof(kProbeBandwidthGains) / sizeof(kProbeBandwidthGains[0]);
+const double kProbeBandwidthWindowGain = 2.0;
+// Number of acks over which the maximum bandwidth sample is taken.
+const size_t kBandwidthSampleCount = 10;
+const bptime::time_duration kMinRoundTripTimeExpiry = bptime::seconds(10);
+
+const double kCubicBeta = 0.7;
+const double kCubicC = 0.4;
+
+size_t ClampWindow(double window) {
+  if (window < Parameters::default_window_size)
+    return Parameters::default_window_size;
+  if (window > Parameters::maximum_window_size)
+    return Parameters::maximum_window_size;
+  return static_cast<size_t>(window);
+}
+
+// The delay between bursts which gives the requested rate in packets per second.
+bptime::time_duration BurstDelay(double packets_per_second) {
+  if (packets_per_second <= 0.0)
+    return Parameters::default_send_delay;
+  return bptime::microseconds(
+      static_cast<int64_t>(1000000.0 * Parameters::default_burst_send_size / packets_per_second));
+}
+
+bptime::time_duration RoundTripDuration(uint32_t round_trip_time) {
+  return round_trip_time ? bptime::microseconds(round_trip_time)
+                         : Parameters::default_send_timeout;
+}
+
+}  // unnamed namespace
+
+std::unique_ptr<CongestionAlgorithm> MakeCongestionAlgorithm(
+    Parameters::CongestionControlAlgorithm algorithm) {
+  switch (algorithm) {
+    case Parameters::kRateBased:
+      return std::unique_ptr<CongestionAlgorithm>(new RateBasedAlgorithm);
+    case Parameters::kCubic:
+      return std::unique_ptr<CongestionAlgorithm>(new CubicAlgorithm);
+    case Parameters::kBufferBased:
+    default:
+      return std::unique_ptr<CongestionAlgorithm>(new BufferBasedAlgorithm);
+  }
+}
+
+// BufferBasedAlgorithm
+
+BufferBasedAlgorithm::BufferBasedAlgorithm() : send_window_size_(Parameters::default_window_size) {}
+
+void BufferBasedAlgorithm::OnAck(const CongestionSample& sample) {
+  // The window will grow and shrink in increments of the maximum_segment_size.
+  //
+  // Growth occurs one maximum_segment_size at a time when the receiver has enough
+  //    room to hold a full maximum_segment_size of data.
+  //
+  // The send_window_size_ will decrease by a maximum_segment_size when the receiver
+  // has less than 50% maximum_segment_size headroom.
+  if (sample.available_buffer_size >= (sample.send_data_size * Parameters::maximum_segment_size)) {
+    send_window_size_ += Parameters::maximum_segment_size;
+    send_window_size_ = std::min(send_window_size_,
+                                 static_cast<size_t>(Parameters::maximum_window_size));
+  } else if (sample.available_buffer_size <
+             (sample.send_data_size * Parameters::maximum_segment_size / 2)) {
+    send_window_size_ -= Parameters::maximum_segment_size;
+    send_window_size_ = std::max(send_window_size_,
+                                 static_cast<size_t>(Parameters::default_window_size));
+  }
+}
+
+void BufferBasedAlgorithm::OnLoss(const bptime::ptime& /*now*/) {}
+
+size_t BufferBasedAlgorithm::SendWindowSize() const { return send_window_size_; }
+
+bptime::time_duration BufferBasedAlgorithm::SendDelay() const {
+  return Parameters::default_send_delay;
+}
+
+double BufferBasedAlgorithm::PacingRate() const { return 0.0; }
+
+// RateBasedAlgorithm
+
+RateBasedAlgorithm::RateBasedAlgorithm()
+    : state_(kStartup),
+      bandwidth_samples_(),
+      min_round_trip_time_(0),
+      min_round_trip_time_stamp_(),
+      round_start_(),
+      full_bandwidth_(0),
+      rounds_without_growth_(0),
+      gain_cycle_index_(0),
+      pacing_gain_(kHighGain),
+      window_gain_(kHighGain) {}
+
+void RateBasedAlgorithm::OnAck(const CongestionSample& sample) {
+  // The receiver's delivery rate is the bandwidth sample, falling back to the packet-pair capacity
+  // estimate until enough packets have arrived for the receiver to measure it.
+  uint32_t bandwidth = sample.packets_receiving_rate ? sample.packets_receiving_rate
+                                                     : sample.estimated_link_capacity;
+  if (bandwidth) {
+    bandwidth_samples_.push_back(bandwidth);
+    while (bandwidth_samples_.size() > kBandwidthSampleCount)
+      bandwidth_samples_.pop_front();
+  }
+
+  if (sample.round_trip_time &&
+      (min_round_trip_time_ == 0 || sample.round_trip_time <= min_round_trip_time_ ||
+       sample.now - min_round_trip_time_stamp_ > kMinRoundTripTimeExpiry)) {
+    min_round_trip_time_ = sample.round_trip_time;
+    min_round_trip_time_stamp_ = sample.now;
+  }
+
+  if (!RoundElapsed(sample.now))
+    return;
+  round_start_ = sample.now;
+
+  switch (state_) {
+    case kStartup:
+      // Leave startup once three rounds have failed to grow the bandwidth by a quarter.
+      if (BottleneckBandwidth() >= full_bandwidth_ * 1.25) {
+        full_bandwidth_ = BottleneckBandwidth();
+        rounds_without_growth_ = 0;
+      } else if (++rounds_without_growth_ >= 3) {
+        state_ = kDrain;
+        pacing_gain_ = 1.0 / kHighGain;
+      }
+      break;
+    case kDrain:
+      // One round at the inverse gain drains the queue built up during startup.
+      state_ = kProbeBandwidth;
+      gain_cycle_index_ = 0;
+      pacing_gain_ = kProbeBandwidthGains[gain_cycle_index_];
+      window_gain_ = kProbeBandwidthWindowGain;
+      break;
+    case kProbeBandwidth:
+      gain_cycle_index_ = (gain_cycle_index_ + 1) % kProbeBandwidthGainCount;
+      pacing_gain_ = kProbeBandwidthGains[gain_cycle_index_];
+      break;
+  }
+}
+
+void RateBasedAlgorithm::OnLoss(const bptime::ptime& /*now*/) {}
+
+size_t RateBasedAlgorithm::SendWindowSize() const {
+  uint32_t bandwidth = BottleneckBandwidth();
+  if (bandwidth == 0 || min_round_trip_time_ == 0)
+    return Parameters::default_window_size;
+  double bandwidth_delay_product = bandwidth * (min_round_trip_time_ / 1000000.0);
+  return ClampWindow(window_gain_ * bandwidth_delay_product);
+}
+
+bptime::time_duration RateBasedAlgorithm::SendDelay() const { return BurstDelay(PacingRate()); }
+
+double RateBasedAlgorithm::PacingRate() const { return pacing_gain_ * BottleneckBandwidth(); }
+
+uint32_t RateBasedAlgorithm::BottleneckBandwidth() const {
+  return bandwidth_samples_.empty()
+             ? 0
+             : *std::max_element(bandwidth_samples_.begin(), bandwidth_samples_.end());
+}
+
+bool RateBasedAlgorithm::RoundElapsed(const bptime::ptime& now) const {
+  return round_start_.is_not_a_date_time() ||
+         now - round_start_ >= RoundTripDuration(min_round_trip_time_);
+}
+
+// CubicAlgorithm
+
+CubicAlgorithm::CubicAlgorithm()
+    : window_(Parameters::default_window_size),
+      slow_start_threshold_(Parameters::maximum_window_size),
+      window_at_loss_(0.0),
+      origin_(0.0),
+      time_to_origin_(0.0),
+      round_trip_time_(0),
+      epoch_start_(),
+      last_growth_(),
+      last_loss_() {}
+
+void CubicAlgorithm::OnAck(const CongestionSample& sample) {
+  if (sample.round_trip_time)
+    round_trip_time_ = sample.round_trip_time;
+
+  if (InSlowStart()) {
+    if (last_growth_.is_not_a_date_time() ||
+        sample.now - last_growth_ >= RoundTripDuration(round_trip_time_)) {
+      window_ = std::min(window_ * 2.0, slow_start_threshold_);
+      last_growth_ = sample.now;
+    }
+    return;
+  }
+
+  if (epoch_start_.is_not_a_date_time()) {
+    epoch_start_ = sample.now;
+    if (window_ < window_at_loss_) {
+      time_to_origin_ = std::cbrt((window_at_loss_ - window_) / kCubicC);
+      origin_ = window_at_loss_;
+    } else {
+      time_to_origin_ = 0.0;
+      origin_ = window_;
+    }
+  }
+
+  double round_trip_seconds = RoundTripDuration(round_trip_time_).total_microseconds() / 1000000.0;
+  double t = (sample.now - epoch_start_).total_microseconds() / 1000000.0 + round_trip_seconds;
+  double target = kCubicC * std::pow(t - time_to_origin_, 3.0) + origin_;
+  // Never grow more slowly than an AIMD flow with the same multiplicative decrease would.
+  double aimd_window = window_at_loss_ * kCubicBeta +
+                       (3.0 * (1.0 - kCubicBeta) / (1.0 + kCubicBeta)) * (t / round_trip_seconds);
+  target = std::max(target, aimd_window);
+  if (target > window_)
+    window_ = std::min(target, window_ * 1.5);
+  window_ = std::min(window_, static_cast<double>(Parameters::maximum_window_size));
+}
+
+void CubicAlgorithm::OnLoss(const bptime::ptime& now) {
+  // Treat all losses within one round trip as a single congestion event.
+  if (!last_loss_.is_not_a_date_time() && now - last_loss_ < RoundTripDuration(round_trip_time_))
+    return;
+  last_loss_ = now;
+
+  // Release bandwidth sooner when successive losses happen at smaller windows.
+  if (window_ < window_at_loss_)
+    window_at_loss_ = window_ * (1.0 + kCubicBeta) / 2.0;
+  else
+    window_at_loss_ = window_;
+  window_ = std::max(window_ * kCubicBeta, static_cast<double>(Parameters::default_window_size));
+  slow_start_threshold_ = window_;
+  epoch_start_ = bptime::ptime();
+}
+
+size_t CubicAlgorithm::SendWindowSize() const { return ClampWindow(window_); }
+
+bptime::time_duration CubicAlgorithm::SendDelay() const { return BurstDelay(PacingRate()); }
+
+double CubicAlgorithm::PacingRate() const {
+  // Pace the window out evenly over a round trip.
+  if (round_trip_time_ == 0)
+    return 0.0;
+  return window_ / (round_trip_time_ / 1000000.0);
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,157 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_CONGESTION_ALGORITHM_H_
+#define MAIDSAFE_RUDP_CORE_CONGESTION_ALGORITHM_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+#include "maidsafe/rudp/parameters.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// The measurements passed to a congestion algorithm with each acknowledgement.
+struct CongestionSample {
+  CongestionSample()
+      : now(),
+        round_trip_time(0),
+        available_buffer_size(0),
+        packets_receiving_rate(0),
+        estimated_link_capacity(0),
+        send_data_size(0) {}
+  boost::posix_time::ptime now;
+  // Smoothed round trip time in microseconds.
+  uint32_t round_trip_time;
+  // Free space in bytes in the receiver's window.
+  uint32_t available_buffer_size;
+  // Smoothed rate in packets per second at which the receiver is getting data.
+  uint32_t packets_receiving_rate;
+  // Smoothed packet-pair estimate in packets per second of the link's capacity.
+  uint32_t estimated_link_capacity;
+  // The payload size in bytes currently used for data packets.
+  size_t send_data_size;
+};
+
+// Decides how many unacknowledged data packets a connection may have in flight and how quickly it
+// may send them.  Owned by CongestionControl, which keeps the shared RTT and rate estimates.
+class CongestionAlgorithm {
+ public:
+  virtual ~CongestionAlgorithm() {}
+
+  virtual void OnAck(const CongestionSample& sample) = 0;
+
+  // Called for each packet reported lost, either by a negative ack or a send timeout.
+  virtual void OnLoss(const boost::posix_time::ptime& now) = 0;
+
+  // Maximum number of unacknowledged packets.
+  virtual size_t SendWindowSize() const = 0;
+
+  // Delay between bursts of Parameters::default_burst_send_size packets.
+  virtual boost::posix_time::time_duration SendDelay() const = 0;
+
+  // Rate in packets per second at which sends should be paced, or 0 if sends are not paced and
+  // instead go out in bursts separated by SendDelay().
+  virtual double PacingRate() const = 0;
+};
+
+std::unique_ptr<CongestionAlgorithm> MakeCongestionAlgorithm(
+    Parameters::CongestionControlAlgorithm algorithm);
+
+// Grows and shrinks the window in steps of Parameters::maximum_segment_size depending on whether
+// the receiver has room for a further segment of data, and sends at a fixed rate.
+class BufferBasedAlgorithm : public CongestionAlgorithm {
+ public:
+  BufferBasedAlgorithm();
+  virtual void OnAck(const CongestionSample& sample);
+  virtual void OnLoss(const boost::posix_time::ptime& now);
+  virtual size_t SendWindowSize() const;
+  virtual boost::posix_time::time_duration SendDelay() const;
+  virtual double PacingRate() const;
+
+ private:
+  size_t send_window_size_;
+};
+
+// BBR-style.  Models the path by its bottleneck bandwidth (a windowed maximum of the receiver's
+// delivery rate) and its minimum round trip time, paces sends at a gain-cycled multiple of the
+// bandwidth and keeps about two bandwidth-delay products in flight.  Loss is not a signal.
+class RateBasedAlgorithm : public CongestionAlgorithm {
+ public:
+  RateBasedAlgorithm();
+  virtual void OnAck(const CongestionSample& sample);
+  virtual void OnLoss(const boost::posix_time::ptime& now);
+  virtual size_t SendWindowSize() const;
+  virtual boost::posix_time::time_duration SendDelay() const;
+  virtual double PacingRate() const;
+
+  enum State { kStartup, kDrain, kProbeBandwidth };
+  State state() const { return state_; }
+  // Bottleneck bandwidth estimate in packets per second.
+  uint32_t BottleneckBandwidth() const;
+  // Minimum round trip time in microseconds.
+  uint32_t MinRoundTripTime() const { return min_round_trip_time_; }
+
+ private:
+  bool RoundElapsed(const boost::posix_time::ptime& now) const;
+
+  State state_;
+  std::deque<uint32_t> bandwidth_samples_;
+  uint32_t min_round_trip_time_;
+  boost::posix_time::ptime min_round_trip_time_stamp_;
+  boost::posix_time::ptime round_start_;
+  uint32_t full_bandwidth_;
+  int rounds_without_growth_;
+  size_t gain_cycle_index_;
+  double pacing_gain_, window_gain_;
+};
+
+// CUBIC-style.  After a loss the window is cut by a constant factor and then regrows as a cubic
+// function of the time since that loss, flattening out around the window at which it occurred.
+// Before the first loss the window doubles every round trip.
+class CubicAlgorithm : public CongestionAlgorithm {
+ public:
+  CubicAlgorithm();
+  virtual void OnAck(const CongestionSample& sample);
+  virtual void OnLoss(const boost::posix_time::ptime& now);
+  virtual size_t SendWindowSize() const;
+  virtual boost::posix_time::time_duration SendDelay() const;
+  virtual double PacingRate() const;
+
+  bool InSlowStart() const { return window_ < slow_start_threshold_; }
+
+ private:
+  double window_, slow_start_threshold_, window_at_loss_, origin_, time_to_origin_;
+  uint32_t round_trip_time_;
+  boost::posix_time::ptime epoch_start_, last_growth_, last_loss_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_CONGESTION_ALGORITHM_H_
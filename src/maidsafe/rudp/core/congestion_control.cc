@@ -43,10 +43,10 @@ CongestionControl::CongestionControl()
       round_trip_time_variance_(0),
       packets_receiving_rate_(0),
       estimated_link_capacity_(0),
-      send_window_size_(Parameters::default_window_size),
+      algorithm_type_(Parameters::congestion_control_algorithm),
+      algorithm_(MakeCongestionAlgorithm(algorithm_type_)),
       receive_window_size_(Parameters::default_window_size),
       send_data_size_(Parameters::default_data_size),
-      send_delay_(Parameters::default_send_delay),
       send_timeout_(Parameters::default_send_timeout),
       receive_delay_(Parameters::default_receive_delay),
       receive_timeout_(Parameters::default_receive_timeout),
@@ -63,6 +63,13 @@ CongestionControl::CongestionControl()
       bits_per_second_(0),
       last_record_transmit_time_() {}
 
+void CongestionControl::SetAlgorithm(Parameters::CongestionControlAlgorithm algorithm) {
+  if (algorithm == algorithm_type_)
+    return;
+  algorithm_type_ = algorithm;
+  algorithm_ = MakeCongestionAlgorithm(algorithm);
+}
+
 void CongestionControl::OnOpen(uint32_t /*send_seqnum*/, uint32_t /*receive_seqnum*/) {
   transmitted_bytes_ = std::numeric_limits<uintmax_t>::max();
 }
@@ -144,7 +151,6 @@ void CongestionControl::OnGenerateAck(uint32_t /*seqnum*/) {
   //   receive_window_size_ *= (1000 / Parameters::ack_interval.total_milliseconds());
   //   receive_window_size_ = std::max(receive_window_size_, Parameters::default_window_size);
   //   receive_window_size_ = std::min(receive_window_size_, Parameters::maximum_window_size);
-  // TODO(Team) calculate SND (send_delay_).
 }
 
 void CongestionControl::OnAck(uint32_t /*seqnum*/) {}
@@ -183,29 +189,26 @@ void CongestionControl::OnAck(uint32_t /*seqnum*/, uint32_t round_trip_time,
   corrupted_packets_ = 0;
   lost_packets_ = 0;
 
-  // The send_window_size is adjusted based on the receiver's available buffer.
-  // The window size will grow and shrink in increments of the maximum_segment_size.
-  //
-  // Growth occurs one maximum_segment_size at a time when the receiver has enough
-  //    room to hold a full maximum_segment_size of data.
-  //
-  // The send_window_size_ will decrease by a maximum_segment_size when the receiver
-  // has less than 50% maximum_segment_size headroom.
-  //
-  if (available_buffer_size >= (send_data_size_ * Parameters::maximum_segment_size)) {
-    send_window_size_ += Parameters::maximum_segment_size;
-    send_window_size_ = std::min(send_window_size_,
-                                 static_cast<size_t>(Parameters::maximum_window_size));
-  } else if (available_buffer_size < (send_data_size_ * Parameters::maximum_segment_size/2)) {
-    send_window_size_ -= Parameters::maximum_segment_size;
-    send_window_size_ = std::max(send_window_size_,
-                                 static_cast<size_t>(Parameters::default_window_size));
-  }
+  // The send window and send delay are left to the selected algorithm.
+  CongestionSample sample;
+  sample.now = TickTimer::Now();
+  sample.round_trip_time = round_trip_time_;
+  sample.available_buffer_size = available_buffer_size;
+  sample.packets_receiving_rate = packets_receiving_rate_;
+  sample.estimated_link_capacity = estimated_link_capacity_;
+  sample.send_data_size = send_data_size_;
+  algorithm_->OnAck(sample);
 }
 
-void CongestionControl::OnNegativeAck(uint32_t /*seqnum*/) { ++corrupted_packets_; }
+void CongestionControl::OnNegativeAck(uint32_t /*seqnum*/) {
+  ++corrupted_packets_;
+  algorithm_->OnLoss(TickTimer::Now());
+}
 
-void CongestionControl::OnSendTimeout(uint32_t /*seqnum*/) { ++lost_packets_; }
+void CongestionControl::OnSendTimeout(uint32_t /*seqnum*/) {
+  ++lost_packets_;
+  algorithm_->OnLoss(TickTimer::Now());
+}
 
 void CongestionControl::OnAckOfAck(uint32_t round_trip_time) {
   uint32_t diff = (round_trip_time < round_trip_time_) ? (round_trip_time_ - round_trip_time)
@@ -271,7 +274,7 @@ uint32_t CongestionControl::PacketsReceivingRate() const { return packets_receiv
 
 uint32_t CongestionControl::EstimatedLinkCapacity() const { return estimated_link_capacity_; }
 
-size_t CongestionControl::SendWindowSize() const { return send_window_size_; }
+size_t CongestionControl::SendWindowSize() const { return algorithm_->SendWindowSize(); }
 
 size_t CongestionControl::ReceiveWindowSize() const { return receive_window_size_; }
 
@@ -282,7 +285,11 @@ int32_t CongestionControl::BestReadBufferSize() const {
   return static_cast<int32_t>(receive_window_size_ * Parameters::max_data_size);
 }
 
-boost::posix_time::time_duration CongestionControl::SendDelay() const { return send_delay_; }
+boost::posix_time::time_duration CongestionControl::SendDelay() const {
+  return algorithm_->SendDelay();
+}
+
+double CongestionControl::PacingRate() const { return algorithm_->PacingRate(); }
 
 boost::posix_time::time_duration CongestionControl::SendTimeout() const { return send_timeout_; }
 
@@ -23,9 +23,11 @@
 
 #include <cstdint>
 #include <deque>
+#include <memory>
 
 #include "boost/date_time/posix_time/posix_time_types.hpp"
 
+#include "maidsafe/rudp/core/congestion_algorithm.h"
 #include "maidsafe/rudp/core/sliding_window.h"
 #include "maidsafe/rudp/packets/data_packet.h"
 #include "maidsafe/rudp/core/tick_timer.h"
@@ -41,6 +43,12 @@ class CongestionControl {
  public:
   CongestionControl();
 
+  // Select the algorithm used to size the send window and pace sends.  Defaults to
+  // Parameters::congestion_control_algorithm.  Selecting the algorithm already in use keeps its
+  // state; selecting another starts it afresh.
+  void SetAlgorithm(Parameters::CongestionControlAlgorithm algorithm);
+  Parameters::CongestionControlAlgorithm Algorithm() const { return algorithm_type_; }
+
   // Event notifications.
   void OnOpen(uint32_t send_seqnum, uint32_t receive_seqnum);
   void OnClose();
@@ -66,6 +74,8 @@ class CongestionControl {
   size_t ReceiveWindowSize() const;
   size_t SendDataSize() const;
   boost::posix_time::time_duration SendDelay() const;
+  // Packets per second at which sends are paced, or 0 if they are sent in bursts every SendDelay().
+  double PacingRate() const;
   boost::posix_time::time_duration SendTimeout() const;
   boost::posix_time::time_duration ReceiveDelay() const;
   boost::posix_time::time_duration ReceiveTimeout() const;
@@ -96,10 +106,11 @@ class CongestionControl {
   uint32_t packets_receiving_rate_;
   uint32_t estimated_link_capacity_;
 
-  size_t send_window_size_;
+  Parameters::CongestionControlAlgorithm algorithm_type_;
+  std::unique_ptr<CongestionAlgorithm> algorithm_;
+
   size_t receive_window_size_;
   size_t send_data_size_;
-  boost::posix_time::time_duration send_delay_;
   boost::posix_time::time_duration send_timeout_;
   boost::posix_time::time_duration receive_delay_;
   boost::posix_time::time_duration receive_timeout_;
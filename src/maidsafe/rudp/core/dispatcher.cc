@@ -27,6 +27,7 @@
 
 #include "maidsafe/rudp/connection_manager.h"
 #include "maidsafe/rudp/packets/packet.h"
+#include "maidsafe/rudp/core/receive_batch.h"
 #include "maidsafe/rudp/core/socket.h"
 
 namespace ip = boost::asio::ip;
@@ -37,47 +38,78 @@ namespace rudp {
 
 namespace detail {
 
-Dispatcher::Dispatcher() : connection_manager_(nullptr) {}
+Dispatcher::Dispatcher() : connection_manager_(nullptr), shard_index_(0), shard_count_(1) {}
 
 void Dispatcher::SetConnectionManager(ConnectionManager *connection_manager) {
-  std::lock_guard<decltype(mutex_)> guard(mutex_);
-  connection_manager_ = connection_manager;
+  connection_manager_.store(connection_manager, std::memory_order_release);
 }
 
-uint32_t Dispatcher::AddSocket(Socket* socket) {
-  ConnectionManager *connection_manager;
-  {
-    std::lock_guard<decltype(mutex_)> guard(mutex_);
-    connection_manager = connection_manager_;
-  }
-  return connection_manager ? connection_manager->AddSocket(socket) : 0;
+void Dispatcher::SetShard(uint32_t shard_index, uint32_t shard_count) {
+  assert(shard_index < shard_count);
+  shard_index_ = shard_index;
+  shard_count_ = shard_count;
+}
+
+uint32_t Dispatcher::AddSocket(Socket* socket, const std::weak_ptr<void>& owner) {
+  ConnectionManager* connection_manager(connection_manager_.load(std::memory_order_acquire));
+  return connection_manager
+             ? connection_manager->AddSocket(socket, owner, shard_index_, shard_count_)
+             : 0;
 }
 
 void Dispatcher::RemoveSocket(uint32_t id) {
-  ConnectionManager *connection_manager;
-  {
-    std::lock_guard<decltype(mutex_)> guard(mutex_);
-    connection_manager = connection_manager_;
-  }
+  ConnectionManager* connection_manager(connection_manager_.load(std::memory_order_acquire));
   if (connection_manager)
     connection_manager->RemoveSocket(id);
 }
 
+void Dispatcher::ReindexSocket(uint32_t id, const ip::udp::endpoint& peer_endpoint) {
+  ConnectionManager* connection_manager(connection_manager_.load(std::memory_order_acquire));
+  if (connection_manager)
+    connection_manager->ReindexSocket(id, peer_endpoint);
+}
+
 void Dispatcher::HandleReceiveFrom(const boost::asio::const_buffer& data,
                                    const ip::udp::endpoint& endpoint) {
-  ConnectionManager* connection_manager;
-  {
-    std::lock_guard<decltype(mutex_)> guard(mutex_);
-    connection_manager = connection_manager_;
-  }
+  ConnectionManager* connection_manager(connection_manager_.load(std::memory_order_acquire));
+  HandleReceiveFrom(connection_manager, data, endpoint);
+}
+
+void Dispatcher::HandleReceiveFrom(const ReceiveBatch& batch) {
+  ConnectionManager* connection_manager(connection_manager_.load(std::memory_order_acquire));
+  for (size_t i = 0; i != batch.Size(); ++i)
+    HandleReceiveFrom(connection_manager, batch.Data(i), batch.SenderEndpoint(i));
+}
+
+void Dispatcher::HandleReceiveFrom(ConnectionManager* connection_manager,
+                                   const boost::asio::const_buffer& data,
+                                   const ip::udp::endpoint& endpoint) {
   if (connection_manager) {
-    Socket* socket(connection_manager->GetSocket(data, endpoint));
+    // Holding the socket keeps it alive even if its connection is closed on another thread.  The
+    // socket's state belongs to its own strand, so its id is taken from the lookup instead.
+    uint32_t socket_id(0);
+    bool retarget(false);
+    std::shared_ptr<Socket> socket(
+        connection_manager->GetSocket(data, endpoint, &socket_id, &retarget));
     if (socket) {
-      socket->HandleReceiveFrom(data, endpoint);
+      if (socket_id % shard_count_ != shard_index_)
+        connection_manager->ForwardToShard(shard_index_, socket_id, data, endpoint, retarget);
+      else
+        socket->HandleReceiveFrom(data, endpoint, retarget);
     }
   }
 }
 
+void Dispatcher::HandleForwardedFrom(uint32_t socket_id, const boost::asio::const_buffer& data,
+                                     const ip::udp::endpoint& endpoint, bool retarget) {
+  ConnectionManager* connection_manager(connection_manager_.load(std::memory_order_acquire));
+  if (connection_manager) {
+    std::shared_ptr<Socket> socket(connection_manager->GetSocket(socket_id));
+    if (socket)
+      socket->HandleReceiveFrom(data, endpoint, retarget);
+  }
+}
+
 }  // namespace detail
 
 }  // namespace rudp
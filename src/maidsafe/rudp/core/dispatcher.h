@@ -21,8 +21,9 @@
 #ifndef MAIDSAFE_RUDP_CORE_DISPATCHER_H_
 #define MAIDSAFE_RUDP_CORE_DISPATCHER_H_
 
+#include <atomic>
 #include <cstdint>
-#include <mutex>
+#include <memory>
 
 #include "boost/asio/buffer.hpp"
 #include "boost/asio/ip/udp.hpp"
@@ -34,6 +35,7 @@ namespace rudp {
 namespace detail {
 
 class ConnectionManager;
+class ReceiveBatch;
 class Socket;
 
 class Dispatcher {
@@ -42,23 +44,42 @@ class Dispatcher {
 
   void SetConnectionManager(ConnectionManager* connection_manager);
 
-  // Add a socket. Returns a new unique id for the socket.
-  uint32_t AddSocket(Socket* socket);
+  // Set which of the connection manager's shards this dispatcher serves.  Sockets added here are
+  // given ids belonging to the shard, and packets for other shards' sockets are forwarded to them.
+  void SetShard(uint32_t shard_index, uint32_t shard_count);
+
+  // Add a socket, which owner (if not empty) contains. Returns a new unique id for the socket.
+  uint32_t AddSocket(Socket* socket, const std::weak_ptr<void>& owner);
 
   // Remove the socket corresponding to the given id.
   void RemoveSocket(uint32_t id);
 
+  // Re-index the socket with the given id after its peer endpoint has been updated.
+  void ReindexSocket(uint32_t id, const boost::asio::ip::udp::endpoint& peer_endpoint);
+
   // Handle a new packet by dispatching to the appropriate socket.
   void HandleReceiveFrom(const boost::asio::const_buffer& data,
                          const boost::asio::ip::udp::endpoint& endpoint);
 
+  // Handle every packet held in the batch, looking up the connection manager only once.
+  void HandleReceiveFrom(const ReceiveBatch& batch);
+
+  // Handle a packet forwarded by another shard for the socket with the given id.
+  void HandleForwardedFrom(uint32_t socket_id, const boost::asio::const_buffer& data,
+                           const boost::asio::ip::udp::endpoint& endpoint, bool retarget);
+
  private:
+  void HandleReceiveFrom(ConnectionManager* connection_manager,
+                         const boost::asio::const_buffer& data,
+                         const boost::asio::ip::udp::endpoint& endpoint);
+
   // Disallow copying and assignment.
   Dispatcher(const Dispatcher&);
   Dispatcher& operator=(const Dispatcher&);
 
-  std::mutex mutex_;
-  ConnectionManager* connection_manager_;
+  // Read on every received packet, so held atomically rather than behind a mutex.
+  std::atomic<ConnectionManager*> connection_manager_;
+  uint32_t shard_index_, shard_count_;
 };
 
 }  // namespace detail
@@ -0,0 +1,127 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_HANDLER_ALLOCATOR_H_
+#define MAIDSAFE_RUDP_CORE_HANDLER_ALLOCATOR_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "boost/asio/handler_alloc_hook.hpp"
+#include "boost/asio/handler_invoke_hook.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Recycles the memory asio needs for the completion handlers of one kind of operation, so that
+// repeating the operation doesn't go to the heap each time.  Holds a few fixed-size slots which are
+// claimed and released atomically, since asio may free a handler's memory on a different thread
+// from the one which allocated it.  Requests which are too large, or made while every slot is in
+// use, fall back to the heap.
+class HandlerAllocator {
+ public:
+  enum { kSlotSize = 256, kSlotCount = 4 };
+
+  HandlerAllocator() : slots_(), in_use_() {
+    for (auto& in_use : in_use_)
+      in_use.store(false, std::memory_order_relaxed);
+  }
+
+  void* Allocate(std::size_t size) {
+    if (size <= kSlotSize) {
+      for (std::size_t i(0); i != kSlotCount; ++i) {
+        if (!in_use_[i].load(std::memory_order_relaxed) &&
+            !in_use_[i].exchange(true, std::memory_order_acquire)) {
+          return &slots_[i];
+        }
+      }
+    }
+    return ::operator new(size);
+  }
+
+  void Deallocate(void* pointer) {
+    for (std::size_t i(0); i != kSlotCount; ++i) {
+      if (pointer == &slots_[i]) {
+        in_use_[i].store(false, std::memory_order_release);
+        return;
+      }
+    }
+    ::operator delete(pointer);
+  }
+
+ private:
+  // Disallow copying and assignment.
+  HandlerAllocator(const HandlerAllocator&);
+  HandlerAllocator& operator=(const HandlerAllocator&);
+
+  typedef std::aligned_storage<kSlotSize, alignof(std::max_align_t)>::type Slot;
+  std::array<Slot, kSlotCount> slots_;
+  std::array<std::atomic<bool>, kSlotCount> in_use_;
+};
+
+// Wraps a handler so that asio allocates its memory, and that of any operation wrapping it which
+// forwards the allocation hooks, from a HandlerAllocator.  The allocator must outlive the handler.
+template <typename Handler>
+class AllocHandler {
+ public:
+  AllocHandler(HandlerAllocator& allocator, Handler handler)
+      : allocator_(allocator), handler_(std::move(handler)) {}
+
+  template <typename... Args>
+  void operator()(Args&&... args) {
+    handler_(std::forward<Args>(args)...);
+  }
+
+  friend void* asio_handler_allocate(std::size_t n, AllocHandler* handler) {
+    return handler->allocator_.Allocate(n);
+  }
+
+  friend void asio_handler_deallocate(void* p, std::size_t /*n*/, AllocHandler* handler) {
+    handler->allocator_.Deallocate(p);
+  }
+
+  template <typename Function>
+  friend void asio_handler_invoke(Function f, AllocHandler* handler) {
+    using boost::asio::asio_handler_invoke;
+    asio_handler_invoke(f, &handler->handler_);
+  }
+
+ private:
+  HandlerAllocator& allocator_;
+  Handler handler_;
+};
+
+template <typename Handler>
+AllocHandler<Handler> MakeAllocHandler(HandlerAllocator& allocator, Handler handler) {
+  return AllocHandler<Handler>(allocator, std::move(handler));
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_HANDLER_ALLOCATOR_H_
@@ -0,0 +1,156 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_MPSC_QUEUE_H_
+#define MAIDSAFE_RUDP_CORE_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// An unbounded queue which any number of threads may push onto without locking, and which a single
+// consumer pops from.  Each item is held in a node linked onto the head with an atomic exchange, so
+// a push never waits for other producers or the consumer.  T must be default constructible.
+//
+// Nodes come from a fixed pool which the consumer returns them to, so a push only allocates while
+// more than pool_size items are queued at once.  The pool's free list is a stack whose head packs
+// a node index with a tag counting its changes, so a producer can't pop a node which was taken and
+// returned again since it read the head.
+template <typename T>
+class MpscQueue {
+ public:
+  enum { kDefaultPoolSize = 64 };
+
+  explicit MpscQueue(size_t pool_size = kDefaultPoolSize)
+      : stub_(), head_(&stub_), tail_(&stub_), pool_(new Node[pool_size]), pool_size_(pool_size),
+        free_head_(0) {
+    for (size_t i(0); i != pool_size_; ++i)
+      ReleaseNode(&pool_[i]);
+  }
+
+  ~MpscQueue() {
+    T item;
+    while (Pop(item)) {}
+    if (tail_ != &stub_)
+      ReleaseNode(tail_);
+  }
+
+  // May be called from any thread.
+  void Push(T item) {
+    Node* node(AcquireNode());
+    node->item = std::move(item);
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node* previous(head_.exchange(node));
+    previous->next.store(node);
+  }
+
+  // May only be called by the consumer.  Returns false if the queue is empty, or if the only items
+  // are still being linked in by their producers, who are then responsible for having them popped.
+  bool Pop(T& item) {
+    Node* tail(tail_);
+    Node* next(tail->next.load());
+    if (!next)
+      return false;
+    // next becomes the new stub, so its item is moved out rather than the node being released.
+    item = std::move(next->item);
+    next->item = T();
+    tail_ = next;
+    if (tail != &stub_)
+      ReleaseNode(tail);
+    return true;
+  }
+
+  // May only be called by the consumer.
+  bool Empty() const { return tail_->next.load() == nullptr; }
+
+ private:
+  struct Node {
+    Node() : next(nullptr), free_next(0), item() {}
+    std::atomic<Node*> next;
+    // The free list entry below this one, as an index into pool_ plus one, or 0 at the bottom.
+    std::atomic<uint32_t> free_next;
+    T item;
+  };
+
+  static const uint64_t kIndexMask = 0xffffffff;
+  static const uint64_t kTagIncrement = kIndexMask + 1;
+
+  // Disallow copying and assignment.
+  MpscQueue(const MpscQueue&);
+  MpscQueue& operator=(const MpscQueue&);
+
+  bool Pooled(const Node* node) const {
+    return node >= pool_.get() && node < pool_.get() + pool_size_;
+  }
+
+  // May be called from any thread.  Falls back to the heap when the pool is exhausted.
+  Node* AcquireNode() {
+    uint64_t head(free_head_.load(std::memory_order_acquire));
+    for (;;) {
+      uint32_t index(static_cast<uint32_t>(head & kIndexMask));
+      if (index == 0)
+        return new Node;
+      Node* node(&pool_[index - 1]);
+      uint64_t next(((head & ~kIndexMask) + kTagIncrement) |
+                    node->free_next.load(std::memory_order_relaxed));
+      if (free_head_.compare_exchange_weak(head, next, std::memory_order_acquire,
+                                           std::memory_order_acquire)) {
+        return node;
+      }
+    }
+  }
+
+  // May only be called by the consumer.
+  void ReleaseNode(Node* node) {
+    if (!Pooled(node)) {
+      delete node;
+      return;
+    }
+    uint64_t index(static_cast<uint64_t>(node - pool_.get()) + 1);
+    uint64_t head(free_head_.load(std::memory_order_relaxed));
+    uint64_t next(0);
+    do {
+      node->free_next.store(static_cast<uint32_t>(head & kIndexMask), std::memory_order_relaxed);
+      next = ((head & ~kIndexMask) + kTagIncrement) | index;
+    } while (!free_head_.compare_exchange_weak(head, next, std::memory_order_release,
+                                               std::memory_order_relaxed));
+  }
+
+  Node stub_;
+  std::atomic<Node*> head_;
+  Node* tail_;
+  std::unique_ptr<Node[]> pool_;
+  const size_t pool_size_;
+  std::atomic<uint64_t> free_head_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_MPSC_QUEUE_H_
@@ -28,8 +28,14 @@
 #  ifndef MAP_ANONYMOUS
 #    define MAP_ANONYMOUS MAP_ANON
 #  endif
+#  include <sys/socket.h>
 #endif
+#ifdef MAIDSAFE_LINUX
+#  include <linux/filter.h>
+#endif
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 
 #include "maidsafe/rudp/managed_connections.h"
 #include "maidsafe/rudp/packets/packet.h"
@@ -46,39 +52,43 @@ namespace detail {
 
 Multiplexer::Multiplexer(boost::asio::io_service& asio_service)
     : socket_(asio_service),
-      sender_endpoint_(),
+      send_batch_buffer_size_(std::max(Parameters::send_batch_size, 1U) * Parameters::max_size),
+      send_batch_buffer_(allocate_dma_buffer_(send_batch_buffer_size_)),
+      send_batch_(send_batch_buffer_, Parameters::max_size,
+                  std::max(Parameters::send_batch_size, 1U)),
+      receive_buffer_size_(std::max(Parameters::receive_batch_size, 1U) * Parameters::max_size),
+      receive_buffer_(allocate_dma_buffer_(receive_buffer_size_)),
+      receive_batch_(receive_buffer_, Parameters::max_size,
+                     std::max(Parameters::receive_batch_size, 1U)),
       dispatcher_(),
+      timing_wheel_(asio_service),
       external_endpoint_(),
       best_guess_external_endpoint_(),
       mutex_() {
-        bool bad = false;
-        for (auto &i : receive_buffers_) {
-          i = allocate_dma_buffer_(Parameters::max_size);
-          if (!(i))
-            bad = true;
-        }
+        bool bad = !receive_buffer_ || !send_batch_buffer_;
         for (auto &i : send_buffers_) {
           i = allocate_dma_buffer_(Parameters::max_size);
           if (!(i))
             bad = true;
         }
         if (bad) {
-          for (auto &i : receive_buffers_)
-            if (i)
-              deallocate_dma_buffer_(i, Parameters::max_size);
+          if (receive_buffer_)
+            deallocate_dma_buffer_(receive_buffer_, receive_buffer_size_);
+          if (send_batch_buffer_)
+            deallocate_dma_buffer_(send_batch_buffer_, send_batch_buffer_size_);
           for (auto &i : send_buffers_)
             if (i)
               deallocate_dma_buffer_(i, Parameters::max_size);
           throw std::bad_alloc();
         }
-        receive_buffer_ = receive_buffers_.begin();
         send_buffer_ = send_buffers_.begin();
       }
 
 Multiplexer::~Multiplexer() {
-  for (auto &i : receive_buffers_)
-    if (i)
-      deallocate_dma_buffer_(i, Parameters::max_size);
+  if (receive_buffer_)
+    deallocate_dma_buffer_(receive_buffer_, receive_buffer_size_);
+  if (send_batch_buffer_)
+    deallocate_dma_buffer_(send_batch_buffer_, send_batch_buffer_size_);
   for (auto &i : send_buffers_)
     if (i)
       deallocate_dma_buffer_(i, Parameters::max_size);
@@ -96,6 +106,8 @@ void Multiplexer::deallocate_dma_buffer_(unsigned char *buf, size_t /*len*/) {
 unsigned char *Multiplexer::allocate_dma_buffer_(size_t len) {
   void *ret = mmap(nullptr, len, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_SHARED,
                    -1, 0);
+  if (ret == MAP_FAILED)
+    return nullptr;
   return reinterpret_cast<unsigned char *>(ret);
 }
 void Multiplexer::deallocate_dma_buffer_(unsigned char *buf, size_t len) {
@@ -103,7 +115,7 @@ void Multiplexer::deallocate_dma_buffer_(unsigned char *buf, size_t len) {
 }
 #endif
 
-ReturnCode Multiplexer::Open(const ip::udp::endpoint& endpoint) {
+ReturnCode Multiplexer::Open(const ip::udp::endpoint& endpoint, bool reuse_port) {
   std::lock_guard<std::mutex> lock(mutex_);
   if (socket_.is_open()) {
     LOG(kWarning) << "Multiplexer already open.";
@@ -130,7 +142,22 @@ ReturnCode Multiplexer::Open(const ip::udp::endpoint& endpoint) {
     return kSetOptionFailure;
   }
 
-  if (endpoint.port() == 0U) {
+  if (reuse_port) {
+#ifdef SO_REUSEPORT
+    socket_.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true),
+                       ec);
+#else
+    ec = boost::asio::error::operation_not_supported;
+#endif
+    if (ec) {
+      LOG(kError) << "Multiplexer setting SO_REUSEPORT error while attempting on " << endpoint
+                  << "  Error: " << ec.message();
+      return kSetOptionFailure;
+    }
+  }
+
+  // A shared port must be one the kernel handed out, so that no other process can join it.
+  if (endpoint.port() == 0U && !reuse_port) {
     // Try to bind to Resilience port first. If this fails, just fall back to port 0 (i.e. any port)
     socket_.bind(ip::udp::endpoint(endpoint.address(), ManagedConnections::kResiliencePort()), ec);
     if (!ec)
@@ -147,6 +174,28 @@ ReturnCode Multiplexer::Open(const ip::udp::endpoint& endpoint) {
   return kSuccess;
 }
 
+bool Multiplexer::SteerBySocketId(uint32_t shard_count) {
+#if defined(MAIDSAFE_LINUX) && defined(SO_ATTACH_REUSEPORT_CBPF)
+  // The program is run over the UDP payload, in which the destination socket id is the big-endian
+  // word at offset 12.  Packets too short to hold one make the load fail, returning shard 0.
+  sock_filter code[] = {
+      {BPF_LD | BPF_W | BPF_ABS, 0, 0, 12},
+      {BPF_ALU | BPF_MOD | BPF_K, 0, 0, shard_count},
+      {BPF_RET | BPF_A, 0, 0, 0}};
+  sock_fprog program = {static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code};
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (setsockopt(socket_.native_handle(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program,
+                 sizeof(program)) != 0) {
+    LOG(kWarning) << "Failed to attach socket id steering program, error " << errno;
+    return false;
+  }
+  return true;
+#else
+  static_cast<void>(shard_count);
+  return false;
+#endif
+}
+
 bool Multiplexer::IsOpen() const {
   std::lock_guard<std::mutex> lock(mutex_);
   return socket_.is_open();
@@ -34,6 +34,9 @@
 
 #include "maidsafe/rudp/operations/dispatch_op.h"
 #include "maidsafe/rudp/core/dispatcher.h"
+#include "maidsafe/rudp/core/receive_batch.h"
+#include "maidsafe/rudp/core/send_batch.h"
+#include "maidsafe/rudp/core/timing_wheel.h"
 #include "maidsafe/rudp/packets/packet.h"
 #include "maidsafe/rudp/parameters.h"
 #include "maidsafe/rudp/return_codes.h"
@@ -52,8 +55,14 @@ class Multiplexer {
   explicit Multiplexer(boost::asio::io_service& asio_service);
   ~Multiplexer();
 
-  // Open the multiplexer.  If endpoint is valid, the new socket will be bound to it.
-  ReturnCode Open(const boost::asio::ip::udp::endpoint& endpoint);
+  // Open the multiplexer.  If endpoint is valid, the new socket will be bound to it.  If reuse_port
+  // is true, the socket may share its endpoint with other multiplexers opened the same way.
+  ReturnCode Open(const boost::asio::ip::udp::endpoint& endpoint, bool reuse_port = false);
+
+  // Have the kernel deliver each packet arriving on this multiplexer's shared endpoint to the
+  // multiplexer at index (destination socket id % shard_count) in the order they were opened.
+  // Returns false where this is unsupported, in which case packets land on any of them.
+  bool SteerBySocketId(uint32_t shard_count);
 
   // Whether the multiplexer is open.
   bool IsOpen() const;
@@ -61,17 +70,14 @@ class Multiplexer {
   // Close the multiplexer.
   void Close();
 
-  // Asynchronously receive a single packet and dispatch it.
+  // Asynchronously receive a packet and dispatch it, along with any further packets which can then
+  // be received in batches without blocking.
   template <typename DispatchHandler>
   void AsyncDispatch(DispatchHandler handler) {
     std::lock_guard<std::mutex> lock(mutex_);
-    unsigned char *data = *receive_buffer_++;
-    if (receive_buffer_ == receive_buffers_.end())
-      receive_buffer_ = receive_buffers_.begin();
-    auto buffer = boost::asio::buffer(data, Parameters::max_size);
-    DispatchOp<DispatchHandler> op(handler, socket_, buffer,
-                                   sender_endpoint_, dispatcher_);
-    socket_.async_receive_from(buffer, sender_endpoint_, 0, op);
+    DispatchOp<DispatchHandler> op(handler, socket_, receive_batch_, dispatcher_);
+    socket_.async_receive_from(receive_batch_.FirstSlot(), receive_batch_.FirstSlotEndpoint(), 0,
+                               op);
   }
 
  private:
@@ -157,7 +163,7 @@ class Multiplexer {
     if (send_buffer_ == send_buffers_.end())
       send_buffer_ = send_buffers_.begin();
     std::vector<boost::asio::mutable_buffer> buffers;
-    buffers.reserve(2);  // in case Encode expands for a gather send
+    buffers.reserve(SendBatch::kMaxBuffersPerPacket);  // in case Encode expands for a gather send
     buffers.push_back(boost::asio::mutable_buffer(data, Parameters::max_size));
     if (size_t length = packet.Encode(buffers)) {
       boost::system::error_code ec;
@@ -192,6 +198,47 @@ class Multiplexer {
     return kSendFailure;
   }
 
+  // Called by the socket objects to send a burst of packets to one endpoint using as few system
+  // calls as possible.  The packets must remain valid until this returns.  Returns the number of
+  // leading packets in the burst which were sent successfully.
+  template <typename Packet>
+  size_t SendTo(const std::vector<const Packet*>& packets,
+                const boost::asio::ip::udp::endpoint& endpoint) {
+    auto &state = getPacketLossState();
+    size_t sent(0);
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (sent < packets.size()) {
+      size_t queued(sent);
+      while (queued < packets.size() && !send_batch_.IsFull()) {
+        size_t length(send_batch_.Add(*packets[queued], endpoint));
+        if (length == 0)
+          break;
+        if (state.enabled && state.should_drop_this_packet(length))
+          send_batch_.DropLast();
+        ++queued;
+      }
+      if (send_batch_.IsEmpty())
+        return sent;  // Failed to encode a packet.
+
+      boost::system::error_code ec;
+      size_t batch_size(send_batch_.Size());
+      size_t batch_sent(send_batch_.SendTo(socket_, ec));
+      sent += batch_sent;
+      if (batch_sent != batch_size) {
+#ifndef NDEBUG
+        if (!socket_.local_endpoint(ec).address().is_unspecified()) {
+          LOG(kWarning) << "Error sending burst of " << batch_size << " packets to " << endpoint
+                        << " - only " << batch_sent << " sent.";
+        }
+#endif
+        return sent;
+      }
+      if (queued != sent)
+        return sent;  // Failed to encode a packet.
+    }
+    return sent;
+  }
+
   boost::asio::ip::udp::endpoint local_endpoint() const;
 
   // Returns external_endpoint_ if valid, else best_guess_external_endpoint_.
@@ -199,6 +246,7 @@ class Multiplexer {
 
   friend class ConnectionManager;
   friend class Socket;
+  friend class Transport;
 
  private:
   // Disallow copying and assignment.
@@ -217,15 +265,27 @@ class Multiplexer {
   // to the network stack. Read more about it at
   // http://www.freebsd.org/cgi/man.cgi?query=zero_copy.
   typedef std::array<unsigned char *, 2> dma_buffers_type_;
-  dma_buffers_type_ receive_buffers_, send_buffers_;
-  dma_buffers_type_::iterator receive_buffer_, send_buffer_;
+  dma_buffers_type_ send_buffers_;
+  dma_buffers_type_::iterator send_buffer_;
 
-  // The remote UDP endpoint we are sending to.
-  boost::asio::ip::udp::endpoint sender_endpoint_;
+  // A single mapping holding Parameters::send_batch_size slots of Parameters::max_size bytes each,
+  // into which bursts of packets are encoded before being sent together.  Protected by mutex_.
+  size_t send_batch_buffer_size_;
+  unsigned char *send_batch_buffer_;
+  SendBatch send_batch_;
+
+  // A single mapping holding Parameters::receive_batch_size slots of Parameters::max_size bytes
+  // each, and the batch of received packets and their senders which is laid over it.
+  size_t receive_buffer_size_;
+  unsigned char *receive_buffer_;
+  ReceiveBatch receive_batch_;
 
   // Dispatcher keeps track of the active sockets.
   Dispatcher dispatcher_;
 
+  // Drives the tick timers of all the sockets using this multiplexer.
+  TimingWheel timing_wheel_;
+
   // This node's external endpoint - passed to session and set during handshaking.
   boost::asio::ip::udp::endpoint external_endpoint_;
 
@@ -0,0 +1,53 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_MULTIPLEXER_SHARD_H_
+#define MAIDSAFE_RUDP_CORE_MULTIPLEXER_SHARD_H_
+
+#include <memory>
+#include <utility>
+
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/strand.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+class Multiplexer;
+
+// One of the multiplexers sharing a transport's endpoint, along with the strand which serialises
+// its dispatch loop and the connections pinned to it.
+struct MultiplexerShard {
+  MultiplexerShard(const boost::asio::io_service::strand& strand_in,
+                   std::shared_ptr<Multiplexer> multiplexer_in)
+      : strand(strand_in), multiplexer(std::move(multiplexer_in)) {}
+
+  boost::asio::io_service::strand strand;
+  std::shared_ptr<Multiplexer> multiplexer;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_MULTIPLEXER_SHARD_H_
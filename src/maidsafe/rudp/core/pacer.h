@@ -0,0 +1,91 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_PACER_H_
+#define MAIDSAFE_RUDP_CORE_PACER_H_
+
+#include <cstdint>
+
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Spreads sends evenly at a target rate.  Sending credit accrues with elapsed time and is capped at
+// one pacing quantum's worth of packets (at least one packet), so a connection resuming after an
+// idle period cannot release a burst, while very high rates need only one timer expiry per quantum.
+class Pacer {
+ public:
+  Pacer() : credit_(0.0), last_update_() {}
+
+  // The interval over which packets may be released together.
+  static boost::posix_time::time_duration Quantum() {
+    return boost::posix_time::microseconds(1000);
+  }
+
+  // Number of packets which may be sent now at the given rate in packets per second.
+  size_t Allowance(const boost::posix_time::ptime& now, double rate) {
+    Update(now, rate);
+    return static_cast<size_t>(credit_);
+  }
+
+  // Consume credit for packets which have been sent.
+  void OnSent(size_t count) {
+    credit_ -= count;
+    if (credit_ < 0.0)
+      credit_ = 0.0;
+  }
+
+  // The earliest time at which at least one more packet may be sent.
+  boost::posix_time::ptime NextSendTime(const boost::posix_time::ptime& now, double rate) {
+    Update(now, rate);
+    if (credit_ >= 1.0)
+      return now;
+    return now + boost::posix_time::microseconds(
+                     static_cast<int64_t>((1.0 - credit_) * 1000000.0 / rate) + 1);
+  }
+
+ private:
+  void Update(const boost::posix_time::ptime& now, double rate) {
+    double maximum_credit = rate * Quantum().total_microseconds() / 1000000.0;
+    if (maximum_credit < 1.0)
+      maximum_credit = 1.0;
+    if (last_update_.is_not_a_date_time() || now < last_update_) {
+      credit_ = 1.0;
+    } else {
+      credit_ += (now - last_update_).total_microseconds() * rate / 1000000.0;
+      if (credit_ > maximum_credit)
+        credit_ = maximum_credit;
+    }
+    last_update_ = now;
+  }
+
+  double credit_;
+  boost::posix_time::ptime last_update_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_PACER_H_
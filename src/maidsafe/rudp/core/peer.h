@@ -74,6 +74,12 @@ class Peer {
     return multiplexer_.SendTo(packet, peer_endpoint_);
   }
 
+  // Sends a burst of packets, returning the number of leading packets which were sent.
+  template <typename Packet>
+  size_t Send(const std::vector<const Packet*>& packets) {
+    return multiplexer_.SendTo(packets, peer_endpoint_);
+  }
+
  private:
   // Disallow copying and assignment.
   Peer(const Peer&);
@@ -0,0 +1,123 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/receive_batch.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include "boost/asio/error.hpp"
+
+namespace bs = boost::system;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+ReceiveBatch::ReceiveBatch(unsigned char* storage, size_t slot_size, size_t slot_count)
+    : slots_(slot_count),
+      slot_size_(slot_size),
+      size_(0)
+#ifdef MAIDSAFE_LINUX
+      , iovecs_(slot_count),
+      headers_(slot_count)
+#endif
+{
+  assert(slot_count > 0);
+  for (size_t i = 0; i != slot_count; ++i) {
+    slots_[i].data = storage ? storage + (i * slot_size) : nullptr;
+#ifdef MAIDSAFE_LINUX
+    iovecs_[i].iov_base = slots_[i].data;
+    iovecs_[i].iov_len = slot_size;
+    std::memset(&headers_[i], 0, sizeof(mmsghdr));
+    headers_[i].msg_hdr.msg_iov = &iovecs_[i];
+    headers_[i].msg_hdr.msg_iovlen = 1;
+    headers_[i].msg_hdr.msg_name = slots_[i].endpoint.data();
+#endif
+  }
+}
+
+boost::asio::const_buffer ReceiveBatch::Data(size_t index) const {
+  assert(index < size_);
+  return boost::asio::const_buffer(slots_[index].data, slots_[index].length);
+}
+
+boost::asio::mutable_buffer ReceiveBatch::FirstSlot() const {
+  return boost::asio::mutable_buffer(slots_.front().data, slot_size_);
+}
+
+void ReceiveBatch::AssignFirst(size_t length) {
+  slots_.front().length = length;
+  size_ = 1;
+}
+
+#ifdef MAIDSAFE_LINUX
+size_t ReceiveBatch::ReceiveFrom(boost::asio::ip::udp::socket& socket, bs::error_code& ec) {
+  size_ = 0;
+  for (auto& header : headers_)
+    header.msg_hdr.msg_namelen = static_cast<socklen_t>(slots_.front().endpoint.capacity());
+
+  int result(0);
+  do {
+    result = ::recvmmsg(socket.native_handle(), &headers_[0],
+                        static_cast<unsigned int>(headers_.size()), MSG_DONTWAIT, nullptr);
+  } while (result < 0 && errno == EINTR);
+
+  if (result < 0) {
+    ec = bs::error_code(errno, boost::asio::error::get_system_category());
+    return 0;
+  }
+
+  ec.clear();
+  for (int i = 0; i != result; ++i) {
+    slots_[i].length = headers_[i].msg_len;
+    slots_[i].endpoint.resize(headers_[i].msg_hdr.msg_namelen);
+  }
+  size_ = static_cast<size_t>(result);
+  return size_;
+}
+#else
+size_t ReceiveBatch::ReceiveFrom(boost::asio::ip::udp::socket& socket, bs::error_code& ec) {
+  size_ = 0;
+  bs::error_code local_ec;
+  while (size_ != slots_.size()) {
+    Slot& slot(slots_[size_]);
+    slot.length = socket.receive_from(boost::asio::buffer(slot.data, slot_size_), slot.endpoint, 0,
+                                      local_ec);
+    if (local_ec)
+      break;
+    ++size_;
+  }
+  // Only report the error if nothing was received, so the caller gets to dispatch what it has
+  // before the next call reports the (probably would_block) condition again.
+  if (size_ == 0)
+    ec = local_ec;
+  else
+    ec.clear();
+  return size_;
+}
+#endif
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,99 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_RECEIVE_BATCH_H_
+#define MAIDSAFE_RUDP_CORE_RECEIVE_BATCH_H_
+
+#include <cstdint>
+#include <vector>
+
+#ifdef MAIDSAFE_LINUX
+#  include <sys/socket.h>
+#  include <sys/uio.h>
+#endif
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/ip/udp.hpp"
+#include "boost/system/error_code.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// A fixed ring of pre-allocated datagram slots which can be filled by a single batched receive
+// call.  On Linux the slots are handed to the kernel in one recvmmsg call, elsewhere they are
+// filled by repeated non-blocking receive_from calls until the socket would block.
+class ReceiveBatch {
+ public:
+  using Endpoint = boost::asio::ip::udp::endpoint;
+
+  // The storage is not owned by the batch and must hold slot_count * slot_size bytes.
+  ReceiveBatch(unsigned char* storage, size_t slot_size, size_t slot_count);
+
+  // Maximum number of datagrams which can be held.
+  size_t Capacity() const { return slots_.size(); }
+
+  // Number of datagrams held from the last receive.
+  size_t Size() const { return size_; }
+
+  // The payload and sender of the datagram at index.  Precondition: index < Size().
+  boost::asio::const_buffer Data(size_t index) const;
+  const Endpoint& SenderEndpoint(size_t index) const { return slots_[index].endpoint; }
+
+  // The full buffer and endpoint of the first slot, for use by an asynchronous receive.
+  boost::asio::mutable_buffer FirstSlot() const;
+  Endpoint& FirstSlotEndpoint() { return slots_.front().endpoint; }
+
+  // Mark the batch as holding a single datagram of length bytes in the first slot, as completed
+  // by an asynchronous receive.
+  void AssignFirst(size_t length);
+
+  // Receive up to Capacity() datagrams without blocking.  Returns the number received, which is 0
+  // if ec is set (e.g. to would_block once the socket has been drained).
+  size_t ReceiveFrom(boost::asio::ip::udp::socket& socket, boost::system::error_code& ec);
+
+ private:
+  // Disallow copying and assignment.
+  ReceiveBatch(const ReceiveBatch&);
+  ReceiveBatch& operator=(const ReceiveBatch&);
+
+  struct Slot {
+    Slot() : data(nullptr), length(0), endpoint() {}
+    unsigned char* data;
+    size_t length;
+    Endpoint endpoint;
+  };
+
+  std::vector<Slot> slots_;
+  size_t slot_size_;
+  size_t size_;
+#ifdef MAIDSAFE_LINUX
+  std::vector<iovec> iovecs_;
+  std::vector<mmsghdr> headers_;
+#endif
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_RECEIVE_BATCH_H_
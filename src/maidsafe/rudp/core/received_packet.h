@@ -0,0 +1,68 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_RECEIVED_PACKET_H_
+#define MAIDSAFE_RUDP_CORE_RECEIVED_PACKET_H_
+
+#include <cstring>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/ip/udp.hpp"
+
+#include "maidsafe/rudp/packets/packet_buffer_pool.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// A datagram copied out of a multiplexer's receive buffer into a pooled buffer, so that it can be
+// queued for the strand which owns the socket it is for.
+struct ReceivedPacket {
+  ReceivedPacket() : buffer(), size(0), endpoint(), retarget(false) {}
+
+  // Returns false if the pool has no buffer for the datagram, which is then to be dropped.
+  bool Assign(const boost::asio::const_buffer& data,
+              const boost::asio::ip::udp::endpoint& endpoint_in, bool retarget_in) {
+    size = boost::asio::buffer_size(data);
+    buffer = PacketBufferPool::AllocateShared(size);
+    if (buffer.empty())
+      return false;
+    std::memcpy(buffer.data(), boost::asio::buffer_cast<const unsigned char*>(data), size);
+    endpoint = endpoint_in;
+    retarget = retarget_in;
+    return true;
+  }
+
+  boost::asio::const_buffer Data() const { return boost::asio::buffer(buffer.data(), size); }
+
+  PacketBuffer buffer;
+  size_t size;
+  boost::asio::ip::udp::endpoint endpoint;
+  // See Socket::HandleReceiveFrom.
+  bool retarget;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_RECEIVED_PACKET_H_
@@ -24,6 +24,7 @@
 #include <cassert>
 #include <cstring>
 #include <limits>
+#include <utility>
 
 #include "boost/assert.hpp"
 
@@ -35,6 +36,8 @@
 #include "maidsafe/rudp/core/tick_timer.h"
 #include "maidsafe/rudp/packets/ack_of_ack_packet.h"
 #include "maidsafe/rudp/packets/negative_ack_packet.h"
+#include "maidsafe/rudp/packets/packet_buffer_pool.h"
+#include "maidsafe/rudp/parameters.h"
 
 namespace ip = boost::asio::ip;
 namespace bptime = boost::posix_time;
@@ -45,6 +48,31 @@ namespace rudp {
 
 namespace detail {
 
+namespace {
+
+const size_t kSizePrefixLength = 4;
+
+// Reads the size prefix which starts each message from the packet's payload at offset.  A streamed
+// message's size is not limited by max_message_size.
+ReturnCode DecodeMessageSize(const DataPacket& packet, size_t offset, size_t max_message_size,
+                             size_t& message_size) {
+  unsigned char prefix[kSizePrefixLength];
+  if (packet.CopyData(offset, prefix, kSizePrefixLength) != kSizePrefixLength) {
+    LOG(kError) << "Message " << packet.MessageNumber() << " has no size prefix.";
+    return kInvalidParameter;
+  }
+  message_size = (static_cast<size_t>(prefix[0]) << 24) | (prefix[1] << 16) | (prefix[2] << 8) |
+                 prefix[3];
+  if ((message_size > max_message_size) && (message_size != Receiver::kStreamedMessageSize)) {
+    LOG(kError) << "Won't receive a message of size " << message_size << " which is > "
+                << max_message_size;
+    return kMessageTooLarge;
+  }
+  return kSuccess;
+}
+
+}  // unnamed namespace
+
 Receiver::Receiver(Peer& peer, TickTimer& tick_timer,
                    CongestionControl& congestion_control)  // NOLINT (Fraser)
     : peer_(peer),
@@ -52,11 +80,24 @@ Receiver::Receiver(Peer& peer, TickTimer& tick_timer,
       congestion_control_(congestion_control),
       unread_packets_(),
       acks_(),
+      spare_payload_buffers_(),
+      partial_messages_(),
+      unordered_ends_to_check_(),
+      blocked_unordered_ends_(),
+      received_sequences_(),
+      reserved_packet_buffers_(Parameters::maximum_window_size),
       last_ack_packet_sequence_number_(0),
-      ack_sent_time_(tick_timer_.Now()) {}
+      ack_sent_time_(tick_timer_.Now()) {
+  PacketBufferPool::ReserveShared(reserved_packet_buffers_);
+}
+
+Receiver::~Receiver() { PacketBufferPool::UnreserveShared(reserved_packet_buffers_); }
 
 void Receiver::Reset(uint32_t initial_sequence_number) {
   unread_packets_.Reset(initial_sequence_number);
+  partial_messages_.clear();
+  unordered_ends_to_check_.clear();
+  blocked_unordered_ends_.clear();
   last_ack_packet_sequence_number_ = initial_sequence_number;
 }
 
@@ -67,6 +108,17 @@ bool Receiver::Flushed() const {
                            //    last_ack_packet_sequence_number_ == 0);
 }
 
+void Receiver::RemoveUnreadPacket() {
+  RecyclePayload(unread_packets_.Front().packet);
+  unread_packets_.Remove();
+}
+
+void Receiver::RecyclePayload(DataPacket& packet) {
+  PacketBuffer buffer(packet.TakePayloadBuffer());
+  if (buffer.unique() && spare_payload_buffers_.size() < kMaxSparePayloadBuffers)
+    spare_payload_buffers_.push_back(std::move(buffer));
+}
+
 size_t Receiver::ReadData(const boost::asio::mutable_buffer& data) {
   unsigned char* begin = boost::asio::buffer_cast<unsigned char*>(data);
   unsigned char* ptr = begin;
@@ -80,23 +132,176 @@ size_t Receiver::ReadData(const boost::asio::mutable_buffer& data) {
     //                  << p.packet.LastPacketInMessage();
     if (p.lost) {
       break;
-    } else if (p.packet.Data().size() > p.bytes_read) {
-      size_t length = std::min<size_t>(end - ptr, p.packet.Data().size() - p.bytes_read);
-      std::memcpy(ptr, p.packet.Data().data() + p.bytes_read, length);
+    } else if (p.packet.DataSize() > p.bytes_read) {
+      size_t length = p.packet.CopyData(p.bytes_read, ptr, end - ptr);
       ptr += length;
       p.bytes_read += length;
-      if (p.packet.Data().size() == p.bytes_read) {
-        unread_packets_.Remove();
+      if (p.packet.DataSize() == p.bytes_read) {
+        RemoveUnreadPacket();
       }
     } else {
-      unread_packets_.Remove();
+      RemoveUnreadPacket();
     }
   }
 
   return ptr - begin;
 }
 
-void Receiver::HandleData(const DataPacket& packet) {
+ReturnCode Receiver::ReadMessage(std::string& message, size_t max_message_size,
+                                 MessagePiece& piece) {
+  while (!unread_packets_.IsEmpty() && !unread_packets_.Front().lost) {
+    UnreadPacket& p = unread_packets_.Front();
+    if (p.delivered) {
+      // Already handed up ahead of earlier messages.
+      RemoveUnreadPacket();
+      continue;
+    }
+    size_t offset = p.bytes_read;
+    uint32_t message_number = p.packet.MessageNumber();
+    bool last_packet = p.packet.LastPacketInMessage();
+    auto partial(partial_messages_.find(message_number));
+    // A message starts with the first in-order packet carrying its number.  FirstPacketInMessage
+    // isn't relied on here, since older peers set it on every packet of a message but the first.
+    bool first_packet = partial == partial_messages_.end() && offset == 0;
+    if (first_packet) {
+      size_t message_size(0);
+      ReturnCode result(DecodeMessageSize(p.packet, offset, max_message_size, message_size));
+      if (result != kSuccess)
+        return result;
+      offset += kSizePrefixLength;
+      partial = partial_messages_.insert(std::make_pair(message_number, PartialMessage())).first;
+      partial->second.streamed = (message_size == kStreamedMessageSize);
+      partial->second.data.resize(partial->second.streamed ? 0 : message_size);
+      partial->second.received = 0;
+    } else if (partial == partial_messages_.end()) {
+      LOG(kError) << "Packet " << unread_packets_.Begin() << " continues message "
+                  << message_number << " which was never started.";
+      return kInvalidParameter;
+    }
+
+    PartialMessage& assembly(partial->second);
+    if (assembly.streamed) {
+      // Hand the packet's payload straight up.
+      message.resize(p.packet.DataSize() - offset);
+      p.packet.CopyData(offset, reinterpret_cast<unsigned char*>(&message[0]), message.size());
+      RemoveUnreadPacket();
+      if (last_packet)
+        partial_messages_.erase(partial);
+      piece.message_number = message_number;
+      piece.streamed = true;
+      piece.first = first_packet;
+      piece.last = last_packet;
+      return kSuccess;
+    }
+
+    size_t length = p.packet.CopyData(
+        offset, reinterpret_cast<unsigned char*>(&assembly.data[0]) + assembly.received,
+        assembly.data.size() - assembly.received);
+    assembly.received += length;
+    if ((offset + length != p.packet.DataSize()) ||
+        (last_packet != (assembly.received == assembly.data.size()))) {
+      LOG(kError) << "Message " << message_number << " of size " << assembly.data.size()
+                  << " does not end with its last packet.";
+      partial_messages_.erase(partial);
+      return kInvalidParameter;
+    }
+    RemoveUnreadPacket();
+
+    if (last_packet) {
+      message.swap(assembly.data);
+      partial_messages_.erase(partial);
+      piece = MessagePiece();
+      piece.message_number = message_number;
+      piece.first = piece.last = true;
+      return kSuccess;
+    }
+  }
+  return ReadUnorderedMessage(message, max_message_size, piece);
+}
+
+ReturnCode Receiver::ReadUnorderedMessage(std::string& message, size_t max_message_size,
+                                          MessagePiece& piece) {
+  while (!unordered_ends_to_check_.empty()) {
+    // Walk back towards the message's first packet, checking that every packet between has arrived
+    // and that none of the message has been read.  Packets of other messages interleaved with it
+    // are passed over.  Packets are only ever read in order from the front of the window, so if
+    // any of the message has been read, its first packet and those up to next_to_check are gone.
+    const UnorderedMessageEnd end(unordered_ends_to_check_.front());
+    unordered_ends_to_check_.pop_front();
+    uint32_t last = end.last, first = end.next_to_check;
+    bool complete(false), gone(!unread_packets_.Contains(last));
+    uint32_t message_number(gone ? 0 : unread_packets_[last].packet.MessageNumber());
+    while (!gone && !complete) {
+      if (!unread_packets_.Contains(first)) {
+        // The start of the message has already been read in order.
+        gone = true;
+        break;
+      }
+      const UnreadPacket& p = unread_packets_[first];
+      if (p.lost)
+        break;
+      if (p.packet.MessageNumber() != message_number) {
+        first = UnreadPacketWindow::Previous(first);
+      } else if (p.delivered || p.bytes_read != 0) {
+        gone = true;
+      } else if (p.packet.FirstPacketInMessage()) {
+        // Only peers which set this flag correctly send packets out of order.
+        complete = true;
+      } else {
+        first = UnreadPacketWindow::Previous(first);
+      }
+    }
+    if (!gone && !complete) {
+      // Stopped at a lost packet; check again once it arrives.
+      blocked_unordered_ends_.insert(std::make_pair(first, last));
+      continue;
+    }
+    if (gone)
+      continue;
+
+    size_t message_size(0);
+    ReturnCode result(
+        DecodeMessageSize(unread_packets_[first].packet, 0, max_message_size, message_size));
+    if (result != kSuccess)
+      return result;
+    if (message_size == kStreamedMessageSize)
+      continue;  // Streamed messages are only read in order.
+    std::string assembled(message_size, 0);
+    size_t received(0), offset(kSizePrefixLength);
+    for (uint32_t n = first;; n = UnreadPacketWindow::Next(n)) {
+      UnreadPacket& p = unread_packets_[n];
+      if (p.packet.MessageNumber() != message_number)
+        continue;
+      size_t length = p.packet.CopyData(
+          offset, reinterpret_cast<unsigned char*>(&assembled[0]) + received,
+          message_size - received);
+      received += length;
+      if (offset + length != p.packet.DataSize()) {
+        LOG(kError) << "Message " << message_number << " of size " << message_size
+                    << " does not end with its last packet.";
+        return kInvalidParameter;
+      }
+      offset = 0;
+      p.delivered = true;
+      RecyclePayload(p.packet);
+      if (n == last)
+        break;
+    }
+    if (received != message_size) {
+      LOG(kError) << "Message " << message_number << " of size " << message_size
+                  << " does not end with its last packet.";
+      return kInvalidParameter;
+    }
+    message.swap(assembled);
+    piece = MessagePiece();
+    piece.message_number = message_number;
+    piece.first = piece.last = true;
+    return kSuccess;
+  }
+  return kPendingResult;
+}
+
+void Receiver::HandleData(DataPacket& packet) {
   unread_packets_.SetMaximumSize(congestion_control_.ReceiveWindowSize());
 
   uint32_t seqnum = packet.PacketSequenceNumber();
@@ -118,10 +323,23 @@ void Receiver::HandleData(const DataPacket& packet) {
     // The packet will be ignored if already received
     if (p.lost) {
       congestion_control_.OnDataPacketReceived(seqnum);
-      p.packet = packet;
+      // Take the payload without copying it; it is copied exactly once more, into the
+      // application's buffer by ReadData.
+      using std::swap;
+      swap(p.packet, packet);
+      if (!spare_payload_buffers_.empty()) {
+        packet.SetPayloadBuffer(std::move(spare_payload_buffers_.back()));
+        spare_payload_buffers_.pop_back();
+      }
       p.lost = false;
       p.bytes_read = 0;
-      received_sequences_.insert(seqnum);
+      received_sequences_.Insert(seqnum);
+      if (!p.packet.InOrder() && p.packet.LastPacketInMessage())
+        unordered_ends_to_check_.push_back(UnorderedMessageEnd(seqnum, seqnum));
+      auto blocked(blocked_unordered_ends_.equal_range(seqnum));
+      for (auto itr(blocked.first); itr != blocked.second; ++itr)
+        unordered_ends_to_check_.push_back(UnorderedMessageEnd(itr->second, seqnum));
+      blocked_unordered_ends_.erase(blocked.first, blocked.second);
     } else {
       LOG(kWarning) << "Seqnum already received: " << seqnum;
     }
@@ -131,7 +349,7 @@ void Receiver::HandleData(const DataPacket& packet) {
                   << unread_packets_.End();
   }
 
-  if (received_sequences_.size() % congestion_control_.AckInterval() == 0) {
+  if (received_sequences_.Size() % congestion_control_.AckInterval() == 0) {
     // Send acknowledgement packets immediately.
     HandleTick();
   } else {
@@ -155,10 +373,8 @@ void Receiver::HandleAckOfAck(const AckOfAckPacket& packet) {
       congestion_control_.OnAckOfAck(static_cast<uint32_t>(rtt_us));
     }
 
-    for (auto seq_range : a.packet.GetSequenceRanges()) {
-      for (uint32_t seq = seq_range.first; seq <= seq_range.second; ++seq)
-        received_sequences_.erase(seq);
-    }
+    for (auto seq_range : a.packet.GetSequenceRanges())
+      received_sequences_.Erase(seq_range.first, seq_range.second);
   }
 
   while (acks_.Contains(ack_seqnum)) {
@@ -256,18 +472,8 @@ uint32_t Receiver::AvailableBufferSize() const {
 }
 
 void Receiver::AddAckPacketSequenceNumbers(AckPacket & packet) {
-  auto iter = received_sequences_.begin();
-  auto iter_end = received_sequences_.end();
-  while (iter != iter_end) {
-    uint32_t first = *iter;
-    uint32_t last = first;
-    ++iter;
-    while (iter != iter_end && *iter == last+1) {
-      last = *iter;
-      ++iter;
-    }
-    packet.AddSequenceNumbers(first, last);
-  }
+  for (const auto& range : received_sequences_.Ranges())
+    packet.AddSequenceNumbers(range.first, range.second);
 }
 
 }  // namespace detail
@@ -23,15 +23,19 @@
 
 #include <cstdint>
 #include <deque>
-#include <set>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "boost/asio/buffer.hpp"
 #include "boost/asio/deadline_timer.hpp"
 #include "boost/asio/ip/udp.hpp"
 #include "boost/date_time/posix_time/posix_time_types.hpp"
 
+#include "maidsafe/rudp/return_codes.h"
 #include "maidsafe/rudp/packets/ack_packet.h"
 #include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/core/sequence_range_set.h"
 #include "maidsafe/rudp/core/sliding_window.h"
 
 namespace maidsafe {
@@ -48,7 +52,21 @@ class TickTimer;
 
 class Receiver {
  public:
+  // The size prefix of a message whose size is not known when it starts to be sent.
+  static const uint32_t kStreamedMessageSize = 0xffffffff;
+
+  // Identifies the message a ReadMessage result belongs to.  A message which is not streamed is
+  // always returned whole, as a single piece which is both its first and last.
+  struct MessagePiece {
+    MessagePiece() : message_number(0), streamed(false), first(false), last(false) {}
+    uint32_t message_number;
+    bool streamed, first, last;
+  };
+
+  // Raises the caps of the shared packet buffer pools by the most packets the unread window can
+  // hold, for as long as the receiver exists.
   explicit Receiver(Peer& peer, TickTimer& tick_timer, CongestionControl& congestion_control);
+  ~Receiver();
 
   // Reset receiver so that it is ready to start receiving data from the specified sequence number.
   void Reset(uint32_t initial_sequence_number);
@@ -59,8 +77,21 @@ class Receiver {
   // Reads some application data. Returns number of bytes copied.
   size_t ReadData(const boost::asio::mutable_buffer& data);
 
-  // Handle a data packet.
-  void HandleData(const DataPacket& packet);
+  // Message-oriented alternative to ReadData, which must not be mixed with it.  Assembles the next
+  // message from its packets into a buffer pre-sized from the message's 4-byte size prefix, freeing
+  // the packets as they are consumed.  Returns kSuccess and swaps the message into message once its
+  // last packet has been read, kPendingResult if more packets are needed, or an error if the size
+  // exceeds max_message_size or disagrees with the packets' message boundaries.  Messages sent
+  // with the in-order bit clear are returned as soon as all of their own packets have arrived, even
+  // if earlier packets are still missing.  A streamed message, whose size prefix is
+  // kStreamedMessageSize, is not assembled but returned a packet's payload at a time, in order,
+  // regardless of max_message_size.  piece describes what was returned.
+  ReturnCode ReadMessage(std::string& message, size_t max_message_size, MessagePiece& piece);
+
+  // Handle a data packet.  The packet is swapped into the receive window rather than copied.  On
+  // return it holds whatever the window slot previously held, along with a spare pooled buffer, if
+  // there is one, for its next Decode to copy into.
+  void HandleData(DataPacket& packet);
 
   // Handle an acknowledgement of an acknowledgement packet.
   void HandleAckOfAck(const AckOfAckPacket& packet);
@@ -73,6 +104,18 @@ class Receiver {
   Receiver(const Receiver&);
   Receiver& operator=(const Receiver&);
 
+  // Returns the first message sent out of order whose packets have all arrived.
+  ReturnCode ReadUnorderedMessage(std::string& message, size_t max_message_size,
+                                  MessagePiece& piece);
+
+  // Removes the packet at the front of unread_packets_, keeping its payload buffer as a spare.
+  void RemoveUnreadPacket();
+
+  // Takes the pooled buffer from a packet which has been read, keeping it as a spare if there is
+  // room, so that buffers circulate between the window and the socket without returning to the
+  // pool.
+  void RecyclePayload(DataPacket& packet);
+
   // Helper function to decide the addition of an ack packet to the sliding window
   void AddAckToWindow(const boost::posix_time::ptime& now);
 
@@ -98,10 +141,13 @@ class Receiver {
     UnreadPacket()
         : packet(),
           lost(true),
+          delivered(false),
           bytes_read(0),
           reserve_time(boost::asio::deadline_timer::traits_type::now()) {}
     DataPacket packet;
     bool lost;
+    // Set once the packet's message has been read ahead of earlier messages.
+    bool delivered;
     size_t bytes_read;
     boost::posix_time::ptime reserve_time;
 
@@ -127,8 +173,39 @@ class Receiver {
   typedef SlidingWindow<Ack> AckWindow;
   AckWindow acks_;
 
-  typedef std::set<uint32_t> ReceivedSequenceSet;
-  ReceivedSequenceSet received_sequences_;
+  // Pooled buffers taken from packets once they have been read, at most kMaxSparePayloadBuffers of
+  // them.  Only the packets still unread in the window hold buffers of their own.
+  enum { kMaxSparePayloadBuffers = 8 };
+  std::vector<PacketBuffer> spare_payload_buffers_;
+
+  // The messages being assembled by ReadMessage, keyed by message number.  Messages sent on
+  // different streams may have their packets interleaved, so several can be in progress at once.
+  struct PartialMessage {
+    PartialMessage() : data(), received(0), streamed(false) {}
+    std::string data;
+    size_t received;
+    bool streamed;
+  };
+  std::map<uint32_t, PartialMessage> partial_messages_;
+
+  // A received last packet of a message which may be delivered out of order, and the packet from
+  // which to carry on walking back to the message's first.  Every packet after next_to_check up to
+  // last is known to have arrived, so each packet is only checked once however often it is read.
+  struct UnorderedMessageEnd {
+    UnorderedMessageEnd(uint32_t last_in, uint32_t next_to_check_in)
+        : last(last_in), next_to_check(next_to_check_in) {}
+    uint32_t last, next_to_check;
+  };
+  // Message ends to be checked by the next read, because a packet they were waiting on arrived.
+  std::deque<UnorderedMessageEnd> unordered_ends_to_check_;
+  // The last packets of messages still missing a packet, keyed by that packet's sequence number.
+  std::multimap<uint32_t, uint32_t> blocked_unordered_ends_;
+
+  // Sequence numbers received but not yet confirmed by an ack of ack.
+  SequenceRangeSet received_sequences_;
+
+  // The number of buffers added to the shared packet buffer pools' caps for this receiver.
+  const size_t reserved_packet_buffers_;
 
   // The last packet sequence number to have been acknowledged.
   uint32_t last_ack_packet_sequence_number_;
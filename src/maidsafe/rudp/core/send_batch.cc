@@ -0,0 +1,114 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/send_batch.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include "boost/asio/error.hpp"
+
+namespace bs = boost::system;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+SendBatch::SendBatch(unsigned char* storage, size_t slot_size, size_t slot_count)
+    : slots_(slot_count),
+      slot_size_(slot_size),
+      size_(0)
+#ifdef MAIDSAFE_LINUX
+      , iovecs_(slot_count * kMaxBuffersPerPacket),
+      headers_(slot_count),
+      header_slots_(slot_count)
+#endif
+{
+  assert(slot_count > 0);
+  for (size_t i = 0; i != slot_count; ++i) {
+    slots_[i].data = storage ? storage + (i * slot_size) : nullptr;
+    slots_[i].buffers.reserve(kMaxBuffersPerPacket);
+  }
+}
+
+#ifdef MAIDSAFE_LINUX
+size_t SendBatch::SendTo(boost::asio::ip::udp::socket& socket, bs::error_code& ec) {
+  ec.clear();
+  // Gather every packet which is really to be sent into one array of message headers.
+  size_t count(0);
+  for (size_t i = 0; i != size_; ++i) {
+    Slot& slot(slots_[i]);
+    if (slot.dropped)
+      continue;
+    iovec* iov(&iovecs_[i * kMaxBuffersPerPacket]);
+    for (size_t j = 0; j != slot.buffers.size(); ++j) {
+      iov[j].iov_base = boost::asio::buffer_cast<void*>(slot.buffers[j]);
+      iov[j].iov_len = boost::asio::buffer_size(slot.buffers[j]);
+    }
+    mmsghdr& header(headers_[count]);
+    std::memset(&header, 0, sizeof(mmsghdr));
+    header.msg_hdr.msg_name = slot.endpoint.data();
+    header.msg_hdr.msg_namelen = static_cast<socklen_t>(slot.endpoint.size());
+    header.msg_hdr.msg_iov = iov;
+    header.msg_hdr.msg_iovlen = slot.buffers.size();
+    header_slots_[count] = i;
+    ++count;
+  }
+
+  size_t sent(0);
+  while (sent < count) {
+    int result(::sendmmsg(socket.native_handle(), &headers_[sent],
+                          static_cast<unsigned int>(count - sent), 0));
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      ec = bs::error_code(errno, boost::asio::error::get_system_category());
+      break;
+    }
+    sent += static_cast<size_t>(result);
+  }
+
+  // Translate the number of messages sent back to a count of leading slots.
+  size_t slots_sent(sent == count ? size_ : header_slots_[sent]);
+  size_ = 0;
+  return slots_sent;
+}
+#else
+size_t SendBatch::SendTo(boost::asio::ip::udp::socket& socket, bs::error_code& ec) {
+  ec.clear();
+  size_t sent(0);
+  for (; sent != size_; ++sent) {
+    Slot& slot(slots_[sent]);
+    if (slot.dropped)
+      continue;
+    socket.send_to(slot.buffers, slot.endpoint, 0, ec);
+    if (ec)
+      break;
+  }
+  size_ = 0;
+  return sent;
+}
+#endif
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
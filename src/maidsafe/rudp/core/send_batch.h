@@ -0,0 +1,135 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_SEND_BATCH_H_
+#define MAIDSAFE_RUDP_CORE_SEND_BATCH_H_
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#ifdef MAIDSAFE_LINUX
+#  include <sys/socket.h>
+#  include <sys/uio.h>
+#endif
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/ip/udp.hpp"
+#include "boost/system/error_code.hpp"
+
+#include "maidsafe/rudp/packets/data_packet.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// A fixed ring of pre-allocated slots into which packets are encoded, so that they can be handed
+// to the kernel by a single batched send call.  On Linux this is one sendmmsg call, elsewhere the
+// slots are sent by repeated send_to calls until one fails.
+class SendBatch {
+ public:
+  using Endpoint = boost::asio::ip::udp::endpoint;
+
+  // The maximum number of gather buffers an encoded packet may occupy.
+  enum {
+    kMaxBuffersPerPacket = 1 + DataPacket::kMaxDataSegments
+  };
+
+  // The storage is not owned by the batch and must hold slot_count * slot_size bytes.
+  SendBatch(unsigned char* storage, size_t slot_size, size_t slot_count);
+
+  // Maximum number of packets which can be held.
+  size_t Capacity() const { return slots_.size(); }
+
+  // Number of packets currently held.
+  size_t Size() const { return size_; }
+
+  bool IsEmpty() const { return size_ == 0; }
+  bool IsFull() const { return size_ == slots_.size(); }
+
+  // Discard all held packets.
+  void Clear() { size_ = 0; }
+
+  // Encode a packet into the next free slot.  Any gather buffers produced by the encoding (e.g. a
+  // DataPacket's payload) must remain valid until the batch is sent or cleared.  Returns the
+  // encoded length, or 0 if encoding failed in which case the slot is not used.
+  // Precondition: !IsFull().
+  template <typename Packet>
+  size_t Add(const Packet& packet, const Endpoint& endpoint) {
+    assert(!IsFull());
+    Slot& slot(slots_[size_]);
+    slot.buffers.clear();
+    slot.buffers.push_back(boost::asio::mutable_buffer(slot.data, slot_size_));
+    size_t length(packet.Encode(slot.buffers));
+    if (length == 0)
+      return 0;
+    assert(slot.buffers.size() <= kMaxBuffersPerPacket);
+    if (length < boost::asio::buffer_size(slot.buffers)) {
+      assert(slot.buffers.size() == 1);
+      // Trim the single buffer to the output length
+      slot.buffers[0] = boost::asio::mutable_buffer(slot.data, length);
+    }
+    slot.endpoint = endpoint;
+    slot.dropped = false;
+    ++size_;
+    return length;
+  }
+
+  // Mark the most recently added packet as one which should be treated as sent without actually
+  // being sent.  Used to simulate packet loss.
+  void DropLast() {
+    assert(!IsEmpty());
+    slots_[size_ - 1].dropped = true;
+  }
+
+  // Send all held packets, then clear the batch.  Returns the number of leading packets which were
+  // sent (dropped packets count as sent).  If not all were sent, ec holds the reason.
+  size_t SendTo(boost::asio::ip::udp::socket& socket, boost::system::error_code& ec);
+
+ private:
+  // Disallow copying and assignment.
+  SendBatch(const SendBatch&);
+  SendBatch& operator=(const SendBatch&);
+
+  struct Slot {
+    Slot() : data(nullptr), buffers(), endpoint(), dropped(false) {}
+    unsigned char* data;
+    std::vector<boost::asio::mutable_buffer> buffers;
+    Endpoint endpoint;
+    bool dropped;
+  };
+
+  std::vector<Slot> slots_;
+  size_t slot_size_;
+  size_t size_;
+#ifdef MAIDSAFE_LINUX
+  std::vector<iovec> iovecs_;
+  std::vector<mmsghdr> headers_;
+  std::vector<size_t> header_slots_;
+#endif
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_SEND_BATCH_H_
@@ -48,44 +48,65 @@ Sender::Sender(Peer& peer, TickTimer& tick_timer, CongestionControl& congestion_
       congestion_control_(congestion_control),
       unacked_packets_(),
       send_timeout_(),
-      current_message_number_(0) {}
+      pacer_(),
+      burst_sequence_numbers_(),
+      burst_packets_(),
+      negative_ack_ranges_() {}
 
 uint32_t Sender::GetNextPacketSequenceNumber() const { return unacked_packets_.End(); }
 
 bool Sender::Flushed() const { return unacked_packets_.IsEmpty(); }
 
-size_t Sender::AddData(const boost::asio::const_buffer& data, uint32_t message_number) {
+size_t Sender::AddData(std::vector<SharedBuffer>& data, uint32_t message_number, bool in_order,
+                       bool first_in_message, bool ends_message, size_t& packet_budget) {
   if ((congestion_control_.SendWindowSize() == 0) && (unacked_packets_.Size() == 0))
     unacked_packets_.SetMaximumSize(Parameters::default_window_size);
   else
     unacked_packets_.SetMaximumSize(congestion_control_.SendWindowSize());
 
-  const unsigned char* begin = boost::asio::buffer_cast<const unsigned char*>(data);
-  const unsigned char* ptr = begin;
-  const unsigned char* end = begin + boost::asio::buffer_size(data);
+  data.erase(std::remove_if(data.begin(), data.end(),
+                            [](const SharedBuffer& segment) { return segment.empty(); }),
+             data.end());
+  auto segment(data.begin());
+  size_t offset(0);
+  size_t added(0);
 
-  while (!unacked_packets_.IsFull() && (ptr < end)) {
-    size_t length = std::min<size_t>(congestion_control_.SendDataSize(), end - ptr);
+  while ((packet_budget != 0) && !unacked_packets_.IsFull() && (segment != data.end())) {
     uint32_t n = unacked_packets_.Append();
+    --packet_budget;
 
     UnackedPacket& p = unacked_packets_[n];
     p.packet.SetPacketSequenceNumber(n);
-    p.packet.SetFirstPacketInMessage(current_message_number_ == message_number);
-    current_message_number_ = message_number;
-    p.packet.SetLastPacketInMessage(ptr + length == end);
-    p.packet.SetInOrder(true);
+    p.packet.SetFirstPacketInMessage(first_in_message);
+    first_in_message = false;
+    // Fill the packet from as many segments as it can refer to.
+    size_t room = congestion_control_.SendDataSize();
+    while ((room != 0) && (segment != data.end()) &&
+           p.packet.AppendData(segment->Slice(offset, room))) {
+      size_t length = std::min(room, segment->size() - offset);
+      room -= length;
+      added += length;
+      offset += length;
+      if (offset == segment->size()) {
+        ++segment;
+        offset = 0;
+      }
+    }
+    p.packet.SetLastPacketInMessage(ends_message && (segment == data.end()));
+    p.packet.SetInOrder(in_order);
     p.packet.SetMessageNumber(message_number);
     p.packet.SetTimeStamp(0);
     p.packet.SetDestinationSocketId(peer_.SocketId());
-    p.packet.SetData(ptr, ptr + length);
     p.lost = true;  // Mark as lost so that DoSend() will send it.
-
-    ptr += length;
   }
 
+  if (segment != data.end())
+    *segment = segment->Slice(offset, segment->size() - offset);
+  data.erase(data.begin(), segment);
+
   DoSend();
 
-  return ptr - begin;
+  return added;
 }
 
 void Sender::HandleAck(const AckPacket& packet, std::vector<uint32_t>& completed_message_numbers) {
@@ -107,12 +128,11 @@ void Sender::HandleAck(const AckPacket& packet, std::vector<uint32_t>& completed
   peer_.Send(response_packet);
 
 
-  // mark ack'd packets
-  for (auto seq_range : packet.GetSequenceRanges()) {
-    for (uint32_t seq = seq_range.first; seq <= seq_range.second; ++seq) {
-      if (unacked_packets_.Contains(seq))
-        unacked_packets_[seq].ackd = true;
-    }
+  // mark ack'd packets, visiting only the part of each range which overlaps the window
+  for (const auto& seq_range : packet.GetSequenceRanges()) {
+    unacked_packets_.ForEachInRange(seq_range.first, seq_range.second, [this](uint32_t n) {
+      unacked_packets_[n].ackd = true;
+    });
   }
 
 
@@ -125,6 +145,8 @@ void Sender::HandleAck(const AckPacket& packet, std::vector<uint32_t>& completed
 //                      << unacked_packets_.Front().packet.MessageNumber();
     }
     new_room = true;
+    // Release this packet's references to the message's buffers.
+    unacked_packets_.Front().packet.ClearData();
     unacked_packets_.Remove();
   }
 
@@ -133,13 +155,14 @@ void Sender::HandleAck(const AckPacket& packet, std::vector<uint32_t>& completed
 }
 
 void Sender::HandleNegativeAck(const NegativeAckPacket& packet) {
-  // Mark the specified packets as lost.
-  for (uint32_t n = unacked_packets_.Begin(); n != unacked_packets_.End();
-       n = unacked_packets_.Next(n)) {
-    if (packet.ContainsSequenceNumber(n)) {
+  // Mark the specified packets as lost, visiting only the part of each range which overlaps the
+  // window.
+  packet.GetSequenceRanges(negative_ack_ranges_);
+  for (const auto& seq_range : negative_ack_ranges_) {
+    unacked_packets_.ForEachInRange(seq_range.first, seq_range.second, [this](uint32_t n) {
       congestion_control_.OnNegativeAck(n);
       unacked_packets_[n].lost = true;
-    }
+    });
   }
 
   DoSend();
@@ -158,37 +181,55 @@ void Sender::HandleTick() {
 }
 
 void Sender::DoSend() {
-  uint32_t packets_sent = 0;
   bptime::ptime now = tick_timer_.Now();
 
-  for (UnackedPacketWindow::seq_num_t n = unacked_packets_.Begin();
-       n != unacked_packets_.End() && packets_sent < Parameters::default_burst_send_size;
+  // When the congestion control paces sends, only as many packets as the pacer allows right now are
+  // sent.  Otherwise up to default_burst_send_size packets go out every SendDelay().
+  double pacing_rate = congestion_control_.PacingRate();
+  size_t burst_limit = pacing_rate > 0.0 ? pacer_.Allowance(now, pacing_rate)
+                                         : Parameters::default_burst_send_size;
+
+  // Gather the lost packets into a burst which is handed to the multiplexer in one go, so that the
+  // whole burst is sent using as few system calls as possible.
+  burst_sequence_numbers_.clear();
+  burst_packets_.clear();
+  bool more_to_send(false);
+  for (UnackedPacketWindow::seq_num_t n = unacked_packets_.Begin(); n != unacked_packets_.End();
        n = unacked_packets_.Next(n)) {
     UnackedPacket& p = unacked_packets_[n];
     if (p.lost) {
-      // peer_.Send is a blockable function call, it will only returned when
-      // the UDP socket sent out the packet successfully. So here the all
-      // un-acked packets can be sent out one-by-one in a bunch, i.e. the whole
-      // buffer (packet_size * window_size) will be sent out at once.
-      // If we make the Send to be unblockable, i.e. handled by a seperate
-      // thread, then we will need to first Check whether we are allowed to
-      // send another packet at this time.
-      if (peer_.Send(p.packet) == kSuccess) {
-        ++packets_sent;
-        p.lost = false;
-        p.last_send_time = now;
-        congestion_control_.OnDataPacketSent(n);
-      } else {
-        LOG(kVerbose) << "DoSend - failed sending packet " << n;
+      if (burst_packets_.size() == burst_limit) {
+        more_to_send = true;
+        break;
       }
+      burst_sequence_numbers_.push_back(n);
+      burst_packets_.push_back(&p.packet);
     }
   }
 
-  if (packets_sent)
+  // peer_.Send only returns once the UDP socket has accepted the leading packets of the burst, so
+  // the whole burst is sent out at once.
+  size_t packets_sent(burst_packets_.empty() ? 0 : peer_.Send(burst_packets_));
+  for (size_t i = 0; i < packets_sent; ++i) {
+    UnackedPacket& p = unacked_packets_[burst_sequence_numbers_[i]];
+    p.lost = false;
+    p.last_send_time = now;
+    congestion_control_.OnDataPacketSent(burst_sequence_numbers_[i]);
+  }
+  if (packets_sent < burst_packets_.size())
+    LOG(kVerbose) << "DoSend - failed sending packet " << burst_sequence_numbers_[packets_sent];
+
+  if (pacing_rate > 0.0) {
+    pacer_.OnSent(packets_sent);
+    if (more_to_send)
+      tick_timer_.TickAt(pacer_.NextSendTime(now, pacing_rate));
+    else
+      tick_timer_.TickAt(now + congestion_control_.SendTimeout());
+  } else if (packets_sent) {
     tick_timer_.TickAt(now + congestion_control_.SendDelay());
-  else
+  } else {
     tick_timer_.TickAt(now + congestion_control_.SendTimeout());
-
+  }
 
   // Set the send timeout so that unacknowledged packets can be marked as lost.
   if (!unacked_packets_.IsEmpty()) {
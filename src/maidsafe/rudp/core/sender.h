@@ -22,6 +22,7 @@
 #define MAIDSAFE_RUDP_CORE_SENDER_H_
 
 #include <cstdint>
+#include <utility>
 #include <vector>
 
 #include "boost/asio/buffer.hpp"
@@ -29,8 +30,10 @@
 #include "boost/date_time/posix_time/posix_time_types.hpp"
 
 #include "maidsafe/rudp/return_codes.h"
+#include "maidsafe/rudp/core/pacer.h"
 #include "maidsafe/rudp/core/sliding_window.h"
 #include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/packets/shared_buffer.h"
 #include "maidsafe/rudp/packets/shutdown_packet.h"
 
 namespace maidsafe {
@@ -56,8 +59,14 @@ class Sender {
   // Determine whether all data has been transmitted to the peer.
   bool Flushed() const;
 
-  // Adds some application data to be sent. Returns number of bytes copied.
-  size_t AddData(const boost::asio::const_buffer& data, uint32_t message_number);
+  // Adds some application data to be sent, as packets referring to slices of the given buffers.
+  // The data taken is removed from the front of data.  Returns number of bytes taken.  If in_order
+  // is false, the peer may deliver the message ahead of earlier ones.  first_in_message indicates
+  // that none of the message has been added yet, and ends_message that the message ends with this
+  // data rather than continuing in a later call.  At most packet_budget packets are added, and
+  // packet_budget is reduced by the number added.
+  size_t AddData(std::vector<SharedBuffer>& data, uint32_t message_number, bool in_order,
+                 bool first_in_message, bool ends_message, size_t& packet_budget);
 
   // Notify the other side that the current connection is to be dropped
   void NotifyClose();
@@ -115,7 +124,15 @@ class Sender {
   // The next time at which all unacked packets will be considered lost.
   boost::posix_time::ptime send_timeout_;
 
-  uint32_t current_message_number_;
+  // Spreads sends at the congestion control's pacing rate, when it has one.
+  Pacer pacer_;
+
+  // Scratch space used by DoSend() to gather a burst of packets for a single batched send.
+  std::vector<UnackedPacketWindow::seq_num_t> burst_sequence_numbers_;
+  std::vector<const DataPacket*> burst_packets_;
+
+  // Scratch space used by HandleNegativeAck() to hold the ranges of a negative ack.
+  std::vector<std::pair<uint32_t, uint32_t>> negative_ack_ranges_;
 };
 
 }  // namespace detail
@@ -0,0 +1,111 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/sequence_range_set.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+// Orders ranges by their last element, for finding the first range which ends at or after n.
+bool EndsBefore(const SequenceRangeSet::Range& range, uint32_t n) { return range.second < n; }
+
+}  // unnamed namespace
+
+bool SequenceRangeSet::Contains(uint32_t n) const {
+  auto it = std::lower_bound(ranges_.begin(), ranges_.end(), n, EndsBefore);
+  return it != ranges_.end() && it->first <= n;
+}
+
+void SequenceRangeSet::Insert(uint32_t n) {
+  // Fast path for in-order arrival.
+  if (ranges_.empty() || n > ranges_.back().second) {
+    if (!ranges_.empty() && n == ranges_.back().second + 1)
+      ranges_.back().second = n;
+    else
+      ranges_.push_back(Range(n, n));
+    ++size_;
+    return;
+  }
+
+  auto it = std::lower_bound(ranges_.begin(), ranges_.end(), n, EndsBefore);
+  assert(it != ranges_.end());
+  if (it->first <= n)
+    return;  // Already present.
+
+  bool joins_next = (n + 1 == it->first);
+  bool joins_previous = (it != ranges_.begin() && (it - 1)->second + 1 == n);
+  if (joins_previous && joins_next) {
+    (it - 1)->second = it->second;
+    ranges_.erase(it);
+  } else if (joins_previous) {
+    (it - 1)->second = n;
+  } else if (joins_next) {
+    it->first = n;
+  } else {
+    ranges_.insert(it, Range(n, n));
+  }
+  ++size_;
+}
+
+void SequenceRangeSet::Erase(uint32_t first, uint32_t last) {
+  assert(first <= last);
+  auto begin = std::lower_bound(ranges_.begin(), ranges_.end(), first, EndsBefore);
+  auto end = begin;
+  bool keep_head(false), keep_tail(false);
+  Range head, tail;
+  for (; end != ranges_.end() && end->first <= last; ++end) {
+    size_ -= std::min(end->second, last) - std::max(end->first, first) + 1;
+    if (end->first < first) {
+      keep_head = true;
+      head = Range(end->first, first - 1);
+    }
+    if (end->second > last) {
+      keep_tail = true;
+      tail = Range(last + 1, end->second);
+    }
+  }
+
+  // Replace the overlapped ranges [begin, end) with whatever parts of them lie outside the erased
+  // range.  At most two parts can survive: a head of the first range and a tail of the last.
+  auto out = begin;
+  if (keep_head && keep_tail && begin + 1 == end) {
+    // A single range is split in two.
+    *out = head;
+    ranges_.insert(out + 1, tail);
+    return;
+  }
+  if (keep_head)
+    *out++ = head;
+  if (keep_tail)
+    *out++ = tail;
+  ranges_.erase(out, end);
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
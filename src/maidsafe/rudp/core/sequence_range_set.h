@@ -0,0 +1,74 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_SEQUENCE_RANGE_SET_H_
+#define MAIDSAFE_RUDP_CORE_SEQUENCE_RANGE_SET_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// A set of sequence numbers held as a sorted vector of disjoint, non-adjacent inclusive ranges.
+// Packets mostly arrive in order, so inserting usually just extends the last range, and generating
+// or erasing acknowledgement ranges costs time proportional to the number of ranges rather than the
+// number of sequence numbers.
+class SequenceRangeSet {
+ public:
+  typedef std::pair<uint32_t, uint32_t> Range;
+
+  SequenceRangeSet() : ranges_(), size_(0) {}
+
+  // Number of sequence numbers in the set.
+  size_t Size() const { return size_; }
+
+  bool IsEmpty() const { return size_ == 0; }
+
+  // The ranges in ascending order.
+  const std::vector<Range>& Ranges() const { return ranges_; }
+
+  bool Contains(uint32_t n) const;
+
+  // Add a single sequence number.  Has no effect if it is already present.
+  void Insert(uint32_t n);
+
+  // Remove all sequence numbers in the inclusive range [first, last].
+  void Erase(uint32_t first, uint32_t last);
+
+  void Clear() {
+    ranges_.clear();
+    size_ = 0;
+  }
+
+ private:
+  std::vector<Range> ranges_;
+  size_t size_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_SEQUENCE_RANGE_SET_H_
@@ -23,7 +23,7 @@
 
 #include <cstdint>
 #include <cassert>
-#include <deque>
+#include <vector>
 
 #include "maidsafe/common/utils.h"
 
@@ -35,6 +35,10 @@ namespace rudp {
 
 namespace detail {
 
+// A window of items indexed by sequence number.  The items are held in a fixed ring of pre-allocated
+// slots whose count is a power of two, so that a sequence number maps to its slot as (n & mask).
+// Slots are reused rather than freed; Append resets its slot by assigning a default-constructed T,
+// so anything an item owns should be taken from it before it is removed if it is to be reused.
 template <typename T>
 class SlidingWindow {
  public:
@@ -45,22 +49,34 @@ class SlidingWindow {
   static const seq_num_t kMaxSequenceNumber = 0x7fffffff;
 
   // Construct to start with a random sequence number.
-  SlidingWindow() : items_(), maximum_size_(0), begin_(0), end_(0) {
+  SlidingWindow() : items_(), mask_(0), size_(0), maximum_size_(0), begin_(0), end_(0) {
     Reset(GenerateSequenceNumber());
   }
 
   // Construct to start with a specified sequence number.
   explicit SlidingWindow(seq_num_t initial_sequence_number)
-      : items_(), maximum_size_(0), begin_(0), end_(0) {
+      : items_(), mask_(0), size_(0), maximum_size_(0), begin_(0), end_(0) {
     Reset(initial_sequence_number);
   }
 
   // Reset to empty starting with the specified sequence number.
   void Reset(seq_num_t initial_sequence_number) {
     assert(initial_sequence_number <= kMaxSequenceNumber);
-    maximum_size_ = Parameters::default_window_size;
+    size_t capacity(1);
+    while (capacity < Parameters::maximum_window_size)
+      capacity <<= 1;
+    // The sequence number space is itself a power of two, so (n & mask_) stays consistent across
+    // wraparound.
+    assert(capacity <= static_cast<size_t>(kMaxSequenceNumber) + 1);
+    if (capacity != items_.size()) {
+      items_.clear();
+      items_.resize(capacity);
+      mask_ = static_cast<seq_num_t>(capacity - 1);
+    }
+    maximum_size_ = Parameters::default_window_size < capacity ? Parameters::default_window_size
+                                                                : capacity;
     begin_ = end_ = initial_sequence_number;
-    items_.clear();
+    size_ = 0;
   }
 
   // Get the sequence number of the first item in window.
@@ -86,22 +102,25 @@ class SlidingWindow {
   // Set the maximum size of the window.
   void SetMaximumSize(size_t size) {
     maximum_size_ = size < Parameters::maximum_window_size ? size : Parameters::maximum_window_size;
+    if (maximum_size_ > items_.size())
+      maximum_size_ = items_.size();
   }
 
   // Get the current size of the window.
-  size_t Size() const { return items_.size(); }
+  size_t Size() const { return size_; }
 
   // Get whether the window is empty.
-  bool IsEmpty() const { return items_.empty(); }
+  bool IsEmpty() const { return size_ == 0; }
 
   // Get whether the window is full.
-  bool IsFull() const { return items_.size() >= maximum_size_; }
+  bool IsFull() const { return size_ >= maximum_size_; }
 
   // Add a new item to the end.
   // Precondition: !IsFull().
   seq_num_t Append() {
     assert(!IsFull());
-    items_.push_back(T());
+    items_[end_ & mask_] = T();
+    ++size_;
     seq_num_t n = end_;
     end_ = Next(end_);
     return n;
@@ -111,7 +130,7 @@ class SlidingWindow {
   // Precondition: !IsEmpty().
   void Remove() {
     assert(!IsEmpty());
-    items_.erase(items_.begin());
+    --size_;
     begin_ = Next(begin_);
   }
 
@@ -125,29 +144,67 @@ class SlidingWindow {
 
   // Get the element at the front of the window.
   // Precondition: !IsEmpty().
-  T& Front() { return items_.front(); }
+  T& Front() {
+    assert(!IsEmpty());
+    return items_[begin_ & mask_];
+  }
 
   // Get the element at the front of the window.
   // Precondition: !IsEmpty().
-  const T& Front() const { return items_.front(); }
+  const T& Front() const {
+    assert(!IsEmpty());
+    return items_[begin_ & mask_];
+  }
 
   // Get the element at the back of the window.
   // Precondition: !IsEmpty().
   T& Back() {
     assert(!IsEmpty());
-    return items_.back();
+    return items_[(end_ - 1) & mask_];
   }
 
   // Get the element at the back of the window.
   // Precondition: !IsEmpty().
   const T& Back() const {
     assert(!IsEmpty());
-    return items_.back();
+    return items_[(end_ - 1) & mask_];
+  }
+
+  // Invoke f(n) for each sequence number n in the inclusive range [first, last] which is in the
+  // window, in window order.  The range may wrap around past kMaxSequenceNumber, but a range longer
+  // than the window could ever be, such as one with first and last reversed, is ignored.  The cost
+  // is proportional to the size of the overlap, not of the range or the window.
+  template <typename Function>
+  void ForEachInRange(seq_num_t first, seq_num_t last, Function f) {
+    const seq_num_t range_size = ((last - first) & kMaxSequenceNumber) + 1;
+    if (range_size > items_.size())
+      return;
+    const seq_num_t offset_of_first = (first - begin_) & kMaxSequenceNumber;
+    const seq_num_t offset_of_begin = (begin_ - first) & kMaxSequenceNumber;
+    seq_num_t start, count;
+    if (offset_of_first < size_) {
+      // The range starts inside the window.
+      start = offset_of_first;
+      count = range_size < size_ - start ? range_size : static_cast<seq_num_t>(size_ - start);
+    } else if (offset_of_begin < range_size) {
+      // The range starts before the window and reaches into it.
+      start = 0;
+      count = range_size - offset_of_begin;
+      if (count > size_)
+        count = static_cast<seq_num_t>(size_);
+    } else {
+      return;
+    }
+    for (seq_num_t n = (begin_ + start) & kMaxSequenceNumber; count != 0; --count, n = Next(n))
+      f(n);
   }
 
   // Get the sequence number that follows a given number.
   static seq_num_t Next(seq_num_t n) { return (n == kMaxSequenceNumber) ? 0 : n + 1; }
 
+  // Get the sequence number that precedes a given number.
+  static seq_num_t Previous(seq_num_t n) { return (n == 0) ? kMaxSequenceNumber : n - 1; }
+
  private:
   // Disallow copying and assignment.
   SlidingWindow(const SlidingWindow&);
@@ -156,12 +213,7 @@ class SlidingWindow {
   // Helper function to convert a sequence number into an index in the window.
   size_t SequenceNumberToIndex(seq_num_t n) const {
     assert(Contains(n));
-    if (begin_ <= end_)
-      return n - begin_;
-    else if (n < end_)
-      return kMaxSequenceNumber - begin_ + n + 1;
-    else
-      return n - begin_;
+    return n & mask_;
   }
 
   // Helper function to generate an initial sequence number.
@@ -180,8 +232,14 @@ class SlidingWindow {
       return (n < end) || ((n >= begin) && (n <= kMaxSequenceNumber));
   }
 
-  // The items in the window.
-  std::deque<T> items_;
+  // The ring of slots holding the items in the window.  Its size is a power of two.
+  std::vector<T> items_;
+
+  // Mask converting a sequence number into an index in items_.
+  seq_num_t mask_;
+
+  // The number of items currently in the window.
+  size_t size_;
 
   // The maximum number of items allowed in the window.
   size_t maximum_size_;
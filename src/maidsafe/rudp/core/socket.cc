@@ -21,6 +21,7 @@
 #include "maidsafe/rudp/core/socket.h"
 
 #include <algorithm>
+#include <iterator>
 #include <utility>
 #include <limits>
 #include <vector>
@@ -41,7 +42,6 @@
 
 namespace ip = boost::asio::ip;
 namespace bs = boost::system;
-namespace bptime = boost::posix_time;
 namespace args = std::placeholders;
 
 namespace maidsafe {
@@ -50,43 +50,65 @@ namespace rudp {
 
 namespace detail {
 
+namespace {
+
+// The number of packets which can be waiting to be handed off to the owner's strand.
+const size_t kHandoffCapacity(256);
+
+}  // unnamed namespace
+
 Socket::Socket(Multiplexer& multiplexer, NatType& nat_type)  // NOLINT (Fraser)
     : dispatcher_(multiplexer.dispatcher_),
+      owner_(),
       peer_(multiplexer),
-      tick_timer_(multiplexer.socket_.get_io_service()),
+      tick_timer_(multiplexer.timing_wheel_),
       session_(peer_, tick_timer_, multiplexer.external_endpoint_, multiplexer.mutex_,
                multiplexer.local_endpoint(), nat_type),
       congestion_control_(),
       sender_(peer_, tick_timer_, congestion_control_),
       receiver_(peer_, tick_timer_, congestion_control_),
-      waiting_connect_(multiplexer.socket_.get_io_service()),
+      waiting_connect_(multiplexer.timing_wheel_.AsioService()),
       waiting_connect_ec_(),
-      waiting_write_(multiplexer.socket_.get_io_service()),
-      waiting_write_buffer_(),
-      waiting_write_ec_(),
-      waiting_write_bytes_transferred_(0),
+      asio_service_(multiplexer.timing_wheel_.AsioService()),
+      write_streams_(),
+      current_write_stream_(0),
       waiting_write_message_number_(0),
       message_sent_functors_(),
-      waiting_read_(multiplexer.socket_.get_io_service()),
+      part_written_messages_(),
+      waiting_read_(multiplexer.timing_wheel_.AsioService()),
       waiting_read_buffer_(),
       waiting_read_transfer_at_least_(0),
+      waiting_read_message_(nullptr),
+      waiting_read_piece_(nullptr),
+      waiting_read_max_message_size_(0),
+      read_piece_(),
       waiting_read_ec_(),
       waiting_read_bytes_transferred_(0),
       // Request packet sequence numbers must be odd
       waiting_keepalive_sequence_number_(RandomUint32() | 0x00000001),
       waiting_probe_(multiplexer.socket_.get_io_service()),
       waiting_probe_ec_(),
-      waiting_flush_(multiplexer.socket_.get_io_service()),
-      waiting_flush_ec_() {
-  waiting_connect_.expires_at(bptime::pos_infin);
-  waiting_write_.expires_at(bptime::pos_infin);
-  waiting_read_.expires_at(bptime::pos_infin);
-  waiting_flush_.expires_at(bptime::pos_infin);
+      waiting_flush_(multiplexer.timing_wheel_.AsioService()),
+      waiting_flush_ec_(),
+      received_data_packet_(),
+      received_ack_packet_(),
+      received_ack_of_ack_packet_(),
+      received_negative_ack_packet_(),
+      received_keepalive_packet_(),
+      received_handshake_packet_(),
+      received_shutdown_packet_(),
+      handed_off_packets_(),
+      notify_handoff_(),
+      handoff_pending_(false),
+      connected_(false) {
+  write_streams_[current_write_stream_].packet_budget =
+      std::max(Parameters::stream_weights[current_write_stream_], 1U);
 }
 
 Socket::~Socket() {
   if (IsOpen())
     dispatcher_.RemoveSocket(session_.Id());
+  AbortWrites();
   for (auto message_sent_functor : message_sent_functors_)
     message_sent_functor.second(kConnectionClosed);
 }
@@ -105,6 +127,8 @@ bool Socket::IsOpen() const { return session_.IsOpen(); }
 
 bool Socket::IsConnected() const { return session_.IsConnected(); }
 
+bool Socket::IsConnectedForDispatch() const { return connected_.load(std::memory_order_acquire); }
+
 void Socket::UpdatePeerEndpoint(const ip::udp::endpoint& remote) {
   peer_.SetPeerGuessedPort();
   peer_.SetPeerEndpoint(remote);
@@ -130,17 +154,17 @@ void Socket::Close() {
     dispatcher_.RemoveSocket(session_.Id());
   }
   session_.Close();
+  connected_.store(false, std::memory_order_release);
   peer_.SetSocketId(0);
   tick_timer_.Cancel();
-  waiting_connect_.cancel();
-  waiting_write_ec_ = boost::asio::error::operation_aborted;
-  waiting_write_bytes_transferred_ = 0;
-  waiting_write_.cancel();
+  waiting_connect_.Complete();
+  AbortWrites();
   waiting_read_ec_ = boost::asio::error::operation_aborted;
   waiting_read_bytes_transferred_ = 0;
-  waiting_read_.cancel();
+  waiting_read_message_ = nullptr;
+  waiting_read_.Complete();
   waiting_flush_ec_ = boost::asio::error::operation_aborted;
-  waiting_flush_.cancel();
+  waiting_flush_.Complete();
   waiting_probe_ec_ = boost::asio::error::shut_down;
   waiting_probe_.cancel();
 }
@@ -156,7 +180,7 @@ uint32_t Socket::StartConnect(
   peer_.SetPeerEndpoint(remote);
   peer_.set_node_id(peer_node_id);
   peer_.SetSocketId(0);  // Assigned when handshake response is received.
-  return session_.Open(dispatcher_.AddSocket(this), this_node_id, this_public_key,
+  return session_.Open(dispatcher_.AddSocket(this, owner_), this_node_id, this_public_key,
                        sender_.GetNextPacketSequenceNumber(), open_mode, cookie_syn,
                        on_nat_detection_requested);
 }
@@ -178,60 +202,146 @@ void Socket::StartProbe() {
   }
 }
 
-void Socket::StartWrite(const boost::asio::const_buffer& data,
-                        const std::function<void(int)>& message_sent_functor) {  // NOLINT (Fraser)
+void Socket::StartWrite(std::vector<SharedBuffer> data, Parameters::MessagePriority priority,
+                        bool in_order,
+                        const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
+                        WriteCompletion completion) {
   // Check for a no-op write.
-  if (boost::asio::buffer_size(data) == 0) {
-    waiting_write_ec_.clear();
-    waiting_write_.cancel();
-    return;
+  if (std::all_of(data.begin(), data.end(),
+                  [](const SharedBuffer& segment) { return segment.empty(); })) {
+    return completion(boost::system::error_code(), 0);
   }
 
   // Try processing the write immediately. If there's space in the write buffer then the operation
-  // will complete immediately. Otherwise, it will wait until some other event frees up space in the
-  // buffer.
-  waiting_write_buffer_ = data;
-  waiting_write_bytes_transferred_ = 0;
+  // will complete immediately. Otherwise, it will wait behind any earlier writes of the same
+  // priority until some other event frees up space in the buffer.
+  BOOST_ASSERT(priority < Parameters::kMessagePriorityCount);
   ++waiting_write_message_number_;
   message_sent_functors_[waiting_write_message_number_] = message_sent_functor;
+  write_streams_[priority].waiting_writes.emplace_back(
+      std::move(data), waiting_write_message_number_, in_order, true, true, std::move(completion));
+  ProcessWrite();
+}
+
+uint32_t Socket::StartMessage(Parameters::MessagePriority priority,
+                              const std::function<void(int)>& message_sent_functor) {  // NOLINT
+  BOOST_ASSERT(priority < Parameters::kMessagePriorityCount);
+  ++waiting_write_message_number_;
+  message_sent_functors_[waiting_write_message_number_] = message_sent_functor;
+  PartWrittenMessage& message(part_written_messages_[waiting_write_message_number_]);
+  message.priority = priority;
+  message.started = false;
+  return waiting_write_message_number_;
+}
+
+void Socket::StartWritePart(uint32_t message_number, std::vector<SharedBuffer> data, bool last,
+                            WriteCompletion completion) {
+  auto itr(part_written_messages_.find(message_number));
+  if (itr == part_written_messages_.end()) {
+    LOG(kError) << "Message " << message_number << " was not started or has already ended.";
+    return completion(boost::asio::error::invalid_argument, 0);
+  }
+  // Parts are queued behind the other writes of the message's priority like whole messages.  A
+  // streamed message is always delivered in order, since its pieces are handed up as they arrive.
+  PartWrittenMessage message(itr->second);
+  if (last)
+    part_written_messages_.erase(itr);
+  else
+    itr->second.started = true;
+  write_streams_[message.priority].waiting_writes.emplace_back(
+      std::move(data), message_number, true, !message.started, last, std::move(completion));
   ProcessWrite();
 }
 
 void Socket::ProcessWrite() {
-  // There's only a waiting write if the write buffer is non-empty.
-  if (boost::asio::buffer_size(waiting_write_buffer_) == 0)
-    return;
+  // Hand as much of the waiting writes' data as the send window allows to the sender.  The streams
+  // take turns, each adding up to its weight in packets from its oldest write.
+  while (HasWaitingWrites()) {
+    WriteStream& stream(write_streams_[current_write_stream_]);
+    if (stream.waiting_writes.empty() || stream.packet_budget == 0) {
+      current_write_stream_ = (current_write_stream_ + 1) % write_streams_.size();
+      write_streams_[current_write_stream_].packet_budget =
+          std::max(Parameters::stream_weights[current_write_stream_], 1U);
+      continue;
+    }
+    WaitingWrite& write(stream.waiting_writes.front());
+    write.bytes_transferred +=
+        sender_.AddData(write.data, write.message_number, write.in_order,
+                        write.starts_message && write.bytes_transferred == 0, write.ends_message,
+                        stream.packet_budget);
+    if (!write.data.empty()) {
+      if (stream.packet_budget != 0)
+        return;  // The send window is full.
+      continue;
+    }
+    // All of this write's data has been added, so trigger its completion handler.
+    WriteCompletion completion(std::move(write.completion));
+    size_t bytes_transferred(write.bytes_transferred);
+    stream.waiting_writes.pop_front();
+    completion(boost::system::error_code(), bytes_transferred);
+  }
+}
+
+bool Socket::HasWaitingWrites() const {
+  return std::any_of(write_streams_.begin(), write_streams_.end(),
+                     [](const WriteStream& stream) { return !stream.waiting_writes.empty(); });
+}
 
-  // Copy whatever data we can into the write buffer.
-  size_t length(sender_.AddData(waiting_write_buffer_, waiting_write_message_number_));
-  waiting_write_buffer_ = waiting_write_buffer_ + length;
-  waiting_write_bytes_transferred_ += length;
-  // If we have finished writing all of the data then it's time to trigger the write's completion
-  // handler.
-  if (boost::asio::buffer_size(waiting_write_buffer_) == 0) {
-    // The write is done. Trigger the write's completion handler.
-    waiting_write_ec_.clear();
-    waiting_write_.cancel();
+void Socket::AbortWrites() {
+  std::deque<WaitingWrite> aborted_writes;
+  for (auto& stream : write_streams_) {
+    std::move(stream.waiting_writes.begin(), stream.waiting_writes.end(),
+              std::back_inserter(aborted_writes));
+    stream.waiting_writes.clear();
   }
+  for (auto& write : aborted_writes)
+    write.completion(boost::asio::error::operation_aborted, 0);
 }
 
 void Socket::StartRead(const boost::asio::mutable_buffer& data, size_t transfer_at_least) {
   // Check for a no-read write.
   if (boost::asio::buffer_size(data) == 0) {
     waiting_read_ec_.clear();
-    waiting_read_.cancel();
+    waiting_read_.Complete();
     return;
   }
 
   // Try processing the read immediately. If there's available data then the operation will complete
   // immediately. Otherwise it will wait until the next data packet arrives.
   waiting_read_buffer_ = data;
+  waiting_read_message_ = nullptr;
   waiting_read_transfer_at_least_ = transfer_at_least;
   waiting_read_bytes_transferred_ = 0;
   ProcessRead();
 }
 
+void Socket::StartReadMessage(std::string& message, Receiver::MessagePiece& piece,
+                              size_t max_message_size) {
+  waiting_read_buffer_ = boost::asio::mutable_buffer();
+  waiting_read_message_ = &message;
+  waiting_read_piece_ = &piece;
+  waiting_read_max_message_size_ = max_message_size;
+  waiting_read_bytes_transferred_ = 0;
+  ProcessRead();
+}
+
 void Socket::ProcessRead() {
+  if (waiting_read_message_) {
+    ReturnCode result(receiver_.ReadMessage(*waiting_read_message_, waiting_read_max_message_size_,
+                                            *waiting_read_piece_));
+    if (result == kPendingResult)
+      return;
+    if (result == kSuccess) {
+      waiting_read_bytes_transferred_ = waiting_read_message_->size();
+      waiting_read_ec_.clear();
+    } else {
+      waiting_read_ec_ = boost::asio::error::message_size;
+    }
+    waiting_read_message_ = nullptr;
+    waiting_read_.Complete();
+    return;
+  }
+
   // There's only a waiting read if the read buffer is non-empty.
   if (boost::asio::buffer_size(waiting_read_buffer_) == 0)
     return;
@@ -247,7 +357,7 @@ void Socket::ProcessRead() {
       waiting_read_bytes_transferred_ >= waiting_read_transfer_at_least_) {
     // the read is done. Trigger the read's completion handler.
     waiting_read_ec_.clear();
-    waiting_read_.cancel();
+    waiting_read_.Complete();
   }
 }
 
@@ -256,47 +366,111 @@ void Socket::StartFlush() { ProcessFlush(); }
 void Socket::ProcessFlush() {
   if (sender_.Flushed() && receiver_.Flushed()) {
     waiting_flush_ec_.clear();
-    waiting_flush_.cancel();
+    waiting_flush_.Complete();
+  }
+}
+
+void Socket::SetOwner(const std::shared_ptr<void>& owner) {
+  BOOST_ASSERT(!IsOpen());
+  owner_ = owner;
+}
+
+void Socket::SetReceiveHandoff(std::function<void()> notify) {
+  BOOST_ASSERT(!IsOpen());
+  handed_off_packets_.reset(new SpscRing<ReceivedPacket>(kHandoffCapacity));
+  notify_handoff_ = std::move(notify);
+}
+
+void Socket::HandleHandedOffPackets() {
+  ReceivedPacket packet;
+  for (;;) {
+    while (handed_off_packets_->Pop(packet)) {
+      // The socket may have been closed while the packet was being handed off.
+      if (IsOpen())
+        ProcessPacket(packet.Data(), packet.endpoint, packet.retarget);
+    }
+    // A packet queued after the ring was found empty, but before the flag is cleared, came without
+    // a notification, so is handled here.
+    handoff_pending_.exchange(false);
+    if (handed_off_packets_->Empty() || handoff_pending_.exchange(true))
+      return;
   }
 }
 
 void Socket::HandleReceiveFrom(const boost::asio::const_buffer& data,
-                               const ip::udp::endpoint& endpoint) {
+                               const ip::udp::endpoint& endpoint, bool retarget) {
+  if (!handed_off_packets_)
+    return ProcessPacket(data, endpoint, retarget);
+
+  ReceivedPacket packet;
+  if (!packet.Assign(data, endpoint, retarget) || !handed_off_packets_->Push(std::move(packet))) {
+    LOG(kVerbose) << "Dropping packet from " << endpoint << " while its socket is busy";
+    return;
+  }
+  if (!handoff_pending_.exchange(true))
+    notify_handoff_();
+}
+
+void Socket::ProcessPacket(const boost::asio::const_buffer& data,
+                           const ip::udp::endpoint& endpoint, bool retarget) {
+  if (retarget && endpoint != peer_.PeerEndpoint() && !session_.IsConnected()) {
+    LOG(kVerbose) << "Socket " << session_.Id() << " updating peer's endpoint from "
+                  << peer_.PeerEndpoint() << " to " << endpoint;
+    UpdatePeerEndpoint(endpoint);
+    dispatcher_.ReindexSocket(session_.Id(), endpoint);
+  }
   if (endpoint == peer_.PeerEndpoint()) {
-    // TODO(Team): Surely this can be templetised somehow to avoid all the obejct creation
-    DataPacket data_packet;
-    AckPacket ack_packet;
-    AckOfAckPacket ack_of_ack_packet;
-    NegativeAckPacket negative_ack_packet;
-    HandshakePacket handshake_packet;
-    ShutdownPacket shutdown_packet;
-    KeepalivePacket keepalive_packet;
-    if (data_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received DataPacket " << data_packet.PacketSequenceNumber() << ":"
-      //               << data_packet.MessageNumber();
-      HandleData(data_packet);
-    } else if (ack_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received AckPacket";
-      HandleAck(ack_packet);
-    } else if (ack_of_ack_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received AckOfAckPacket";
-      HandleAckOfAck(ack_of_ack_packet);
-    } else if (negative_ack_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received NegativeAckPacket";
-      HandleNegativeAck(negative_ack_packet);
-    } else if (keepalive_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received KeepalivePacket";
-      HandleKeepalive(keepalive_packet);
-    } else if (handshake_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received HandshakePacket InitialPacketSequenceNumber="
-      //               << handshake_packet.InitialPacketSequenceNumber();
-      HandleHandshake(handshake_packet);
-    } else if (shutdown_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received ShutdownPacket";
-      Close();
-    } else {
-      LOG(kWarning) << "Socket " << session_.Id() << " ignoring invalid packet from " << endpoint;
+    bool handled(false);
+    switch (Packet::DecodeKind(data)) {
+      case Packet::Kind::kData:
+        if ((handled = received_data_packet_.Decode(data))) {
+          // LOG(kVerbose) << "Received DataPacket " << received_data_packet_.PacketSequenceNumber()
+          //               << ":" << received_data_packet_.MessageNumber();
+          HandleData(received_data_packet_);
+        }
+        break;
+      case Packet::Kind::kAck:
+        if ((handled = received_ack_packet_.Decode(data))) {
+          // LOG(kVerbose) << "Received AckPacket";
+          HandleAck(received_ack_packet_);
+        }
+        break;
+      case Packet::Kind::kAckOfAck:
+        if ((handled = received_ack_of_ack_packet_.Decode(data))) {
+          // LOG(kVerbose) << "Received AckOfAckPacket";
+          HandleAckOfAck(received_ack_of_ack_packet_);
+        }
+        break;
+      case Packet::Kind::kNegativeAck:
+        if ((handled = received_negative_ack_packet_.Decode(data))) {
+          // LOG(kVerbose) << "Received NegativeAckPacket";
+          HandleNegativeAck(received_negative_ack_packet_);
+        }
+        break;
+      case Packet::Kind::kKeepalive:
+        if ((handled = received_keepalive_packet_.Decode(data))) {
+          // LOG(kVerbose) << "Received KeepalivePacket";
+          HandleKeepalive(received_keepalive_packet_);
+        }
+        break;
+      case Packet::Kind::kHandshake:
+        if ((handled = received_handshake_packet_.Decode(data))) {
+          // LOG(kVerbose) << "Received HandshakePacket InitialPacketSequenceNumber="
+          //               << received_handshake_packet_.InitialPacketSequenceNumber();
+          HandleHandshake(received_handshake_packet_);
+        }
+        break;
+      case Packet::Kind::kShutdown:
+        if ((handled = received_shutdown_packet_.Decode(data))) {
+          // LOG(kVerbose) << "Received ShutdownPacket";
+          Close();
+        }
+        break;
+      default:
+        break;
     }
+    if (!handled)
+      LOG(kWarning) << "Socket " << session_.Id() << " ignoring invalid packet from " << endpoint;
   } else {
     LOG(kWarning) << "Socket " << session_.Id() << " ignoring spurious packet from " << endpoint;
   }
@@ -305,6 +479,7 @@ void Socket::HandleReceiveFrom(const boost::asio::const_buffer& data,
 void Socket::HandleHandshake(const HandshakePacket& packet) {
   bool was_connected = session_.IsConnected();
   session_.HandleHandshake(packet);
+  connected_.store(session_.IsConnected(), std::memory_order_release);
 
   if (!session_.IsOpen()) {
     sender_.NotifyClose();
@@ -321,7 +496,7 @@ void Socket::HandleHandshake(const HandshakePacket& packet) {
       congestion_control_.SetPeerConnectionType(session_.PeerConnectionType());
       receiver_.Reset(session_.ReceivingSequenceNumber());
       waiting_connect_ec_.clear();
-      waiting_connect_.cancel();
+      waiting_connect_.Complete();
     }
   }
 }
@@ -348,7 +523,7 @@ void Socket::HandleKeepalive(const KeepalivePacket& packet) {
   }
 }
 
-void Socket::HandleData(const DataPacket& packet) {
+void Socket::HandleData(DataPacket& packet) {
   if (session_.IsConnected()) {
     receiver_.HandleData(packet);
     ProcessRead();
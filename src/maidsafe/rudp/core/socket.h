@@ -21,11 +21,15 @@
 #ifndef MAIDSAFE_RUDP_CORE_SOCKET_H_
 #define MAIDSAFE_RUDP_CORE_SOCKET_H_
 
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <deque>
 #include <functional>
 #include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "boost/asio/buffer.hpp"
 #include "boost/asio/deadline_timer.hpp"
@@ -36,13 +40,24 @@
 #include "maidsafe/common/node_id.h"
 #include "maidsafe/common/rsa.h"
 
+#include "maidsafe/rudp/core/completion_slot.h"
 #include "maidsafe/rudp/core/congestion_control.h"
 #include "maidsafe/rudp/core/peer.h"
+#include "maidsafe/rudp/core/received_packet.h"
 #include "maidsafe/rudp/core/receiver.h"
 #include "maidsafe/rudp/core/sender.h"
 #include "maidsafe/rudp/core/session.h"
+#include "maidsafe/rudp/core/spsc_ring.h"
 #include "maidsafe/rudp/core/tick_timer.h"
 
+#include "maidsafe/rudp/packets/ack_of_ack_packet.h"
+#include "maidsafe/rudp/packets/ack_packet.h"
+#include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/packets/handshake_packet.h"
+#include "maidsafe/rudp/packets/keepalive_packet.h"
+#include "maidsafe/rudp/packets/negative_ack_packet.h"
+#include "maidsafe/rudp/packets/shutdown_packet.h"
+
 #include "maidsafe/rudp/operations/connect_op.h"
 #include "maidsafe/rudp/operations/flush_op.h"
 #include "maidsafe/rudp/operations/probe_op.h"
@@ -59,13 +74,7 @@ namespace rudp {
 
 namespace detail {
 
-class AckPacket;
-class AckOfAckPacket;
-class DataPacket;
 class Dispatcher;
-class HandshakePacket;
-class KeepalivePacket;
-class NegativeAckPacket;
 
 class Socket {
  public:
@@ -92,8 +101,12 @@ class Socket {
   // Returns whether the connection has been established (i.e. handshaking successfully completed).
   bool IsConnected() const;
 
-  // This should only be called by the ConnectionManager if this node discovers that the peer has a
-  // different endpoint than it predicted (i.e. the peer is behind symmetric NAT).
+  // As IsConnected, but may be called from any thread, so lags behind the session while a
+  // handshake is being handled.  Used by the ConnectionManager to route handshake packets.
+  bool IsConnectedForDispatch() const;
+
+  // This should only be called if this node discovers that the peer has a different endpoint than
+  // it predicted (i.e. the peer is behind symmetric NAT).
   void UpdatePeerEndpoint(const Endpoint& remote);
 
   // If the peer endpoint was updated using UpdatePeerEndpoint, this returns the port originally
@@ -115,6 +128,11 @@ class Socket {
   // Calculate if the transmission speed is too slow
   bool IsSlowTransmission(size_t length) { return congestion_control_.IsSlowTransmission(length); }
 
+  // Select the congestion control algorithm which governs this socket's sends.
+  void SetCongestionControlAlgorithm(Parameters::CongestionControlAlgorithm algorithm) {
+    congestion_control_.SetAlgorithm(algorithm);
+  }
+
   // Asynchronously process one "tick". The internal tick size varies based on
   // the next time-based event that is of interest to the socket.
   template <typename TickHandler>
@@ -137,7 +155,7 @@ class Socket {
                         uint32_t cookie_syn,
                         Session::OnNatDetectionRequested::slot_type on_nat_detection_requested) {
     ConnectOp<ConnectHandler> op(handler, waiting_connect_ec_);
-    waiting_connect_.async_wait(op);
+    waiting_connect_.Wait(op);
     return StartConnect(this_node_id, this_public_key, remote, peer_node_id, open_mode, cookie_syn,
                         on_nat_detection_requested);
   }
@@ -146,14 +164,70 @@ class Socket {
   // generally complete immediately unless congestion has caused the internal
   // buffer for unprocessed send data to fill up. when the operation completes, the handler is
   // invoked, but the message_sent_functor is not invoked until the last packet of the message has
-  // been acknowledged by the peer.
+  // been acknowledged by the peer.  The data is a sequence of shared buffers which are sent as one
+  // message; packets refer to slices of them rather than copying them.  Any number of writes may be
+  // outstanding; each is a separate message.  Writes of the same priority are added to the send
+  // window in order, while those of different priorities are interleaved packet by packet according
+  // to Parameters::stream_weights.  If in_order is false, the peer may deliver the message ahead of
+  // earlier ones.
+  template <typename WriteHandler>
+  void AsyncWrite(std::vector<SharedBuffer> data, Parameters::MessagePriority priority,
+                  bool in_order,
+                  const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
+                  WriteHandler handler) {
+    boost::asio::io_service& asio_service(asio_service_);
+    StartWrite(std::move(data), priority, in_order, message_sent_functor,
+               [&asio_service, handler](const boost::system::error_code& ec,
+                                        size_t bytes_transferred) {
+                 asio_service.post(WriteOp<WriteHandler>(handler, ec, bytes_transferred));
+               });
+  }
+
+  template <typename WriteHandler>
+  void AsyncWrite(std::vector<SharedBuffer> data, bool in_order,
+                  const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
+                  WriteHandler handler) {
+    AsyncWrite(std::move(data), Parameters::kNormalPriority, in_order, message_sent_functor,
+               handler);
+  }
+
+  template <typename WriteHandler>
+  void AsyncWrite(std::vector<SharedBuffer> data,
+                  const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
+                  WriteHandler handler) {
+    AsyncWrite(std::move(data), true, message_sent_functor, handler);
+  }
+
+  // Begins a message whose data is written in parts with AsyncWritePart, for when its size is not
+  // known up front.  message_sent_functor is invoked once the last part has been acknowledged.
+  // Returns the number identifying the message.
+  uint32_t StartMessage(Parameters::MessagePriority priority,
+                        const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
+
+  // Initiate an asynchronous operation to write the next part of a message begun with
+  // StartMessage.  The handler is invoked once the part has been added to the send window, at which
+  // point the next part may be written; only one part of a message may be outstanding at a time.
+  // The data must not be empty.  last ends the message.
+  template <typename WriteHandler>
+  void AsyncWritePart(uint32_t message_number, std::vector<SharedBuffer> data, bool last,
+                      WriteHandler handler) {
+    boost::asio::io_service& asio_service(asio_service_);
+    StartWritePart(message_number, std::move(data), last,
+                   [&asio_service, handler](const boost::system::error_code& ec,
+                                            size_t bytes_transferred) {
+                     asio_service.post(WriteOp<WriteHandler>(handler, ec, bytes_transferred));
+                   });
+  }
+
+  // As above, but copies the data into a shared buffer first.
   template <typename WriteHandler>
   void AsyncWrite(const boost::asio::const_buffer& data,
                   const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
                   WriteHandler handler) {
-    WriteOp<WriteHandler> op(handler, waiting_write_ec_, waiting_write_bytes_transferred_);
-    waiting_write_.async_wait(op);
-    StartWrite(data, message_sent_functor);
+    const char* begin(boost::asio::buffer_cast<const char*>(data));
+    AsyncWrite(std::vector<SharedBuffer>(
+                   1, SharedBuffer(std::string(begin, begin + boost::asio::buffer_size(data)))),
+               message_sent_functor, handler);
   }
 
   // Initiate an asynchronous operation to read data.
@@ -161,15 +235,34 @@ class Socket {
   void AsyncRead(const boost::asio::mutable_buffer& data, size_t transfer_at_least,
                  ReadHandler handler) {
     ReadOp<ReadHandler> op(handler, waiting_read_ec_, waiting_read_bytes_transferred_);
-    waiting_read_.async_wait(op);
+    waiting_read_.Wait(op);
     StartRead(data, transfer_at_least);
   }
 
+  // Initiate an asynchronous operation to read the next whole message into message, assembled
+  // directly from its packets.  Must not be mixed with AsyncRead on the same socket.  Completes
+  // with boost::asio::error::message_size if the message is larger than max_message_size or
+  // malformed.
+  // Messages written with StartMessage and AsyncWritePart are read a piece at a time instead, and
+  // piece identifies the message each read belongs to.
+  template <typename ReadHandler>
+  void AsyncReadMessage(std::string& message, Receiver::MessagePiece& piece,
+                        size_t max_message_size, ReadHandler handler) {
+    ReadOp<ReadHandler> op(handler, waiting_read_ec_, waiting_read_bytes_transferred_);
+    waiting_read_.Wait(op);
+    StartReadMessage(message, piece, max_message_size);
+  }
+
+  template <typename ReadHandler>
+  void AsyncReadMessage(std::string& message, size_t max_message_size, ReadHandler handler) {
+    AsyncReadMessage(message, read_piece_, max_message_size, handler);
+  }
+
   // Initiate an asynchronous operation to flush all outbound data.
   template <typename FlushHandler>
   void AsyncFlush(FlushHandler handler) {
     FlushOp<FlushHandler> op(handler, waiting_flush_ec_);
-    waiting_flush_.async_wait(op);
+    waiting_flush_.Wait(op);
     StartFlush();
   }
 
@@ -194,6 +287,20 @@ class Socket {
   // Public key of remote peer, used to encrypt all outgoing messages on this socket
   std::shared_ptr<asymm::PublicKey> PeerPublicKey() const;
 
+  // Ties the socket's lifetime to owner's, which must contain it.  The dispatcher keeps owner alive
+  // while it hands a packet to the socket, so it must be set before the socket is opened.  A
+  // socket without an owner must instead outlive the dispatch of packets on its multiplexer.
+  void SetOwner(const std::shared_ptr<void>& owner);
+
+  // A socket whose owner runs on a strand other than its multiplexer's has each packet received for
+  // it copied into a pooled buffer and queued on a fixed-size ring, rather than handled on the
+  // dispatcher's strand.  notify is called on the dispatcher's strand when packets have been
+  // queued and HandleHandedOffPackets is not already due to run; the owner must then call that on
+  // its own strand.  Packets which arrive while the ring is full are dropped, to be resent by the
+  // peer.  Must be set before the socket is opened.
+  void SetReceiveHandoff(std::function<void()> notify);
+  void HandleHandedOffPackets();
+
   friend class Dispatcher;
 
  private:
@@ -209,25 +316,40 @@ class Socket {
                         uint32_t cookie_syn,
                         const Session::OnNatDetectionRequested::slot_type&);
 
-  void StartWrite(const boost::asio::const_buffer& data,
-                  const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
+  typedef std::function<void(const boost::system::error_code&, size_t)> WriteCompletion;
+  void StartWrite(std::vector<SharedBuffer> data, Parameters::MessagePriority priority,
+                  bool in_order,
+                  const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
+                  WriteCompletion completion);
+  void StartWritePart(uint32_t message_number, std::vector<SharedBuffer> data, bool last,
+                      WriteCompletion completion);
   void ProcessWrite();
+  bool HasWaitingWrites() const;
+  // Completes all waiting writes with operation_aborted.
+  void AbortWrites();
   void StartRead(const boost::asio::mutable_buffer& data, size_t transfer_at_least);
+  void StartReadMessage(std::string& message, Receiver::MessagePiece& piece,
+                        size_t max_message_size);
   void ProcessRead();
   void StartFlush();
   void ProcessFlush();
 
   void StartProbe();
 
-  // Called by the Dispatcher when a new packet arrives for the socket.
-  void HandleReceiveFrom(const boost::asio::const_buffer& data,
-                         const Endpoint& endpoint);
+  // Called by the Dispatcher, on the multiplexer's strand, when a packet arrives for the socket.
+  // If retarget is set, the packet is a handshake from the peer's address but an unexpected port,
+  // and if the socket is still unconnected when the packet is handled on the socket's own strand,
+  // the peer endpoint is first updated to endpoint.
+  void HandleReceiveFrom(const boost::asio::const_buffer& data, const Endpoint& endpoint,
+                         bool retarget);
+  void ProcessPacket(const boost::asio::const_buffer& data, const Endpoint& endpoint,
+                     bool retarget);
 
   // Called to process a newly received handshake packet.
   void HandleHandshake(const HandshakePacket& packet);
 
   // Called to process a newly received data packet.
-  void HandleData(const DataPacket& packet);
+  void HandleData(DataPacket& packet);
 
   // Called to process a newly received acknowledgement packet.
   void HandleAck(const AckPacket& packet);
@@ -248,6 +370,9 @@ class Socket {
   // The dispatcher that holds this sockets registration.
   Dispatcher& dispatcher_;
 
+  // The object containing this socket, registered along with it.
+  std::weak_ptr<void> owner_;
+
   // The remote peer with which we are communicating.
   Peer peer_;
 
@@ -271,25 +396,59 @@ class Socket {
   // This class allows for a single asynchronous connect operation. The
   // following data members store the pending connect, and the result that is
   // intended for its completion handler.
-  boost::asio::deadline_timer waiting_connect_;
+  CompletionSlot waiting_connect_;
   boost::system::error_code waiting_connect_ec_;
 
-  // This class allows only one outstanding asynchronous write operation at a
-  // time. The following data members store the pending write, and the result
-  // that is intended for its completion handler.
-  boost::asio::deadline_timer waiting_write_;
-  boost::asio::const_buffer waiting_write_buffer_;
-  boost::system::error_code waiting_write_ec_;
-  size_t waiting_write_bytes_transferred_;
+  // The io_service on which write completions are posted.
+  boost::asio::io_service& asio_service_;
+
+  // A pending write whose data has not yet all been added to the send window.
+  struct WaitingWrite {
+    WaitingWrite(std::vector<SharedBuffer> data_in, uint32_t message_number_in, bool in_order_in,
+                 bool starts_message_in, bool ends_message_in, WriteCompletion completion_in)
+        : data(std::move(data_in)),
+          message_number(message_number_in),
+          in_order(in_order_in),
+          starts_message(starts_message_in),
+          ends_message(ends_message_in),
+          bytes_transferred(0),
+          completion(std::move(completion_in)) {}
+    std::vector<SharedBuffer> data;
+    uint32_t message_number;
+    bool in_order, starts_message, ends_message;
+    size_t bytes_transferred;
+    WriteCompletion completion;
+  };
+  // The pending writes of one priority, oldest first, and the number of packets they may still add
+  // to the send window before the next stream's turn.
+  struct WriteStream {
+    WriteStream() : waiting_writes(), packet_budget(0) {}
+    std::deque<WaitingWrite> waiting_writes;
+    size_t packet_budget;
+  };
+  std::array<WriteStream, Parameters::kMessagePriorityCount> write_streams_;
+  size_t current_write_stream_;
   uint32_t waiting_write_message_number_;
   std::map<uint32_t, std::function<void(int)>> message_sent_functors_;  // NOLINT (Fraser)
 
+  // The priorities of messages begun with StartMessage which are still being written, and whether
+  // their first part has been written yet.
+  struct PartWrittenMessage {
+    Parameters::MessagePriority priority;
+    bool started;
+  };
+  std::map<uint32_t, PartWrittenMessage> part_written_messages_;
+
   // This class allows only one outstanding asynchronous read operation at a
   // time. The following data members store the pending read, its associated
   // buffer, and the result that is intended for its completion handler.
-  boost::asio::deadline_timer waiting_read_;
+  CompletionSlot waiting_read_;
   boost::asio::mutable_buffer waiting_read_buffer_;
   size_t waiting_read_transfer_at_least_;
+  std::string* waiting_read_message_;
+  Receiver::MessagePiece* waiting_read_piece_;
+  size_t waiting_read_max_message_size_;
+  Receiver::MessagePiece read_piece_;
   boost::system::error_code waiting_read_ec_;
   size_t waiting_read_bytes_transferred_;
 
@@ -300,8 +459,26 @@ class Socket {
   // This class allows only one outstanding flush operation at a time. The
   // following data members store the pending flush, and the result that is
   // intended for its completion handler.
-  boost::asio::deadline_timer waiting_flush_;
+  CompletionSlot waiting_flush_;
   boost::system::error_code waiting_flush_ec_;
+
+  // Incoming packets are classified by their header and decoded into the matching one of these, so
+  // that no packet objects are constructed per datagram received.
+  DataPacket received_data_packet_;
+  AckPacket received_ack_packet_;
+  AckOfAckPacket received_ack_of_ack_packet_;
+  NegativeAckPacket received_negative_ack_packet_;
+  KeepalivePacket received_keepalive_packet_;
+  HandshakePacket received_handshake_packet_;
+  ShutdownPacket received_shutdown_packet_;
+
+  // Set if received packets are handed off to the owner's strand.
+  std::unique_ptr<SpscRing<ReceivedPacket>> handed_off_packets_;
+  std::function<void()> notify_handoff_;
+  std::atomic<bool> handoff_pending_;
+
+  // Mirrors session_.IsConnected() for readers on other strands.
+  std::atomic<bool> connected_;
 };
 
 }  // namespace detail
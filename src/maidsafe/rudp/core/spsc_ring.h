@@ -0,0 +1,94 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_SPSC_RING_H_
+#define MAIDSAFE_RUDP_CORE_SPSC_RING_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// A fixed-capacity queue which one producer pushes onto and one consumer pops from without locking.
+// The slots are allocated once, on construction, so neither side allocates per item.  The producer
+// and consumer may each be a strand rather than a single thread.  T must be default constructible.
+template <typename T>
+class SpscRing {
+ public:
+  // capacity must be a power of two.
+  explicit SpscRing(size_t capacity)
+      : items_(capacity), mask_(capacity - 1), head_(0), padding_(), tail_(0) {
+    assert(capacity != 0 && (capacity & mask_) == 0);
+  }
+
+  // May only be called by the producer.  Returns false, leaving item intact, if the ring is full.
+  bool Push(T&& item) {
+    size_t tail(tail_.load(std::memory_order_relaxed));
+    if (tail - head_.load(std::memory_order_acquire) == items_.size())
+      return false;
+    items_[tail & mask_] = std::move(item);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // May only be called by the consumer.  Returns false if the ring is empty.  The slot is reset, so
+  // that anything the item owns is released by the consumer rather than when the slot is reused.
+  bool Pop(T& item) {
+    size_t head(head_.load(std::memory_order_relaxed));
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+    item = std::move(items_[head & mask_]);
+    items_[head & mask_] = T();
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // May be called by either side, though the answer can be stale by the time it is used.
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+
+  size_t Capacity() const { return items_.size(); }
+
+ private:
+  // Disallow copying and assignment.
+  SpscRing(const SpscRing&);
+  SpscRing& operator=(const SpscRing&);
+
+  std::vector<T> items_;
+  const size_t mask_;
+  std::atomic<size_t> head_;
+  // Keeps the producer's index off the consumer's cache line.
+  char padding_[64];
+  std::atomic<size_t> tail_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_SPSC_RING_H_
@@ -0,0 +1,110 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <memory>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+#include "boost/system/error_code.hpp"
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/completion_slot.h"
+#include "maidsafe/rudp/core/handler_allocator.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+TEST(CompletionSlotTest, BEH_Complete) {
+  boost::asio::io_service io_service;
+  CompletionSlot slot(io_service);
+  int invoked(0);
+  EXPECT_FALSE(slot.Pending());
+  slot.Complete();
+
+  slot.Wait([&](const boost::system::error_code& ec) {
+    EXPECT_FALSE(ec);
+    ++invoked;
+  });
+  EXPECT_TRUE(slot.Pending());
+  slot.Complete();
+  EXPECT_FALSE(slot.Pending());
+  // The handler is posted rather than invoked directly, and only once.
+  EXPECT_EQ(0, invoked);
+  slot.Complete();
+  io_service.run();
+  EXPECT_EQ(1, invoked);
+
+  // The slot may be waited on again once completed.
+  slot.Wait([&](const boost::system::error_code&) { ++invoked; });
+  slot.Complete();
+  io_service.reset();
+  io_service.run();
+  EXPECT_EQ(2, invoked);
+}
+
+TEST(CompletionSlotTest, BEH_DestroyPending) {
+  boost::asio::io_service io_service;
+  auto resource(std::make_shared<int>(0));
+  bool invoked(false);
+  {
+    CompletionSlot slot(io_service);
+    slot.Wait([resource, &invoked](const boost::system::error_code&) { invoked = true; });
+    EXPECT_EQ(2, resource.use_count());
+  }
+  // The pending handler is destroyed, not invoked.
+  EXPECT_EQ(1, resource.use_count());
+  io_service.run();
+  EXPECT_FALSE(invoked);
+}
+
+TEST(CompletionSlotTest, BEH_UsesHandlerAllocator) {
+  boost::asio::io_service io_service;
+  CompletionSlot slot(io_service);
+  HandlerAllocator allocator;
+  int invoked(0);
+  slot.Wait(MakeAllocHandler(allocator, [&](const boost::system::error_code&) { ++invoked; }));
+  // The pending handler occupies one of the allocator's slots.
+  std::vector<void*> slots;
+  for (int i(0); i != HandlerAllocator::kSlotCount - 1; ++i)
+    slots.push_back(allocator.Allocate(16));
+  void* overflow(allocator.Allocate(16));
+  const char* begin(reinterpret_cast<const char*>(&allocator));
+  EXPECT_FALSE(static_cast<char*>(overflow) >= begin &&
+               static_cast<char*>(overflow) < begin + sizeof(allocator));
+  allocator.Deallocate(overflow);
+  for (auto allocated : slots)
+    allocator.Deallocate(allocated);
+
+  slot.Complete();
+  io_service.run();
+  EXPECT_EQ(1, invoked);
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,150 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/congestion_algorithm.h"
+#include "maidsafe/rudp/core/congestion_control.h"
+#include "maidsafe/rudp/parameters.h"
+
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+CongestionSample MakeSample(const bptime::ptime& now, uint32_t round_trip_time,
+                            uint32_t packets_receiving_rate) {
+  CongestionSample sample;
+  sample.now = now;
+  sample.round_trip_time = round_trip_time;
+  sample.available_buffer_size = Parameters::maximum_window_size * Parameters::max_data_size;
+  sample.packets_receiving_rate = packets_receiving_rate;
+  sample.send_data_size = Parameters::default_data_size;
+  return sample;
+}
+
+}  // unnamed namespace
+
+TEST(CongestionAlgorithmTest, BEH_BufferBased) {
+  BufferBasedAlgorithm algorithm;
+  EXPECT_EQ(Parameters::default_window_size, algorithm.SendWindowSize());
+  EXPECT_EQ(Parameters::default_send_delay, algorithm.SendDelay());
+
+  bptime::ptime now(bptime::microsec_clock::universal_time());
+  algorithm.OnAck(MakeSample(now, 1000, 0));
+  EXPECT_EQ(Parameters::default_window_size + Parameters::maximum_segment_size,
+            algorithm.SendWindowSize());
+
+  CongestionSample sample(MakeSample(now, 1000, 0));
+  sample.available_buffer_size = 0;
+  algorithm.OnAck(sample);
+  algorithm.OnAck(sample);
+  EXPECT_EQ(Parameters::default_window_size, algorithm.SendWindowSize());
+}
+
+TEST(CongestionAlgorithmTest, BEH_RateBased) {
+  const uint32_t kRoundTripTime(50000), kPacketsPerSecond(4000);
+  RateBasedAlgorithm algorithm;
+  EXPECT_EQ(RateBasedAlgorithm::kStartup, algorithm.state());
+  EXPECT_EQ(Parameters::default_window_size, algorithm.SendWindowSize());
+  EXPECT_EQ(Parameters::default_send_delay, algorithm.SendDelay());
+
+  // A steady delivery rate ends startup after three rounds without growth, then one round of
+  // draining leads to the bandwidth probing cycle.
+  bptime::ptime now(bptime::microsec_clock::universal_time());
+  for (int round = 0; round < 5; ++round, now += bptime::microseconds(kRoundTripTime))
+    algorithm.OnAck(MakeSample(now, kRoundTripTime, kPacketsPerSecond));
+  EXPECT_EQ(RateBasedAlgorithm::kProbeBandwidth, algorithm.state());
+  EXPECT_EQ(kPacketsPerSecond, algorithm.BottleneckBandwidth());
+  EXPECT_EQ(kRoundTripTime, algorithm.MinRoundTripTime());
+
+  // About two bandwidth-delay products in flight, paced near the bottleneck rate.
+  EXPECT_EQ(2 * kPacketsPerSecond * kRoundTripTime / 1000000, algorithm.SendWindowSize());
+  int64_t delay_at_bandwidth = 1000000 * Parameters::default_burst_send_size / kPacketsPerSecond;
+  EXPECT_LE(algorithm.SendDelay().total_microseconds(), delay_at_bandwidth * 4 / 3);
+  EXPECT_GE(algorithm.SendDelay().total_microseconds(), delay_at_bandwidth * 3 / 4);
+
+  // Loss does not shrink the window.
+  size_t window(algorithm.SendWindowSize());
+  algorithm.OnLoss(now);
+  EXPECT_EQ(window, algorithm.SendWindowSize());
+}
+
+TEST(CongestionAlgorithmTest, BEH_Cubic) {
+  const uint32_t kRoundTripTime(20000);
+  CubicAlgorithm algorithm;
+  EXPECT_TRUE(algorithm.InSlowStart());
+  EXPECT_EQ(Parameters::default_window_size, algorithm.SendWindowSize());
+
+  // Slow start doubles the window once per round trip.
+  bptime::ptime now(bptime::microsec_clock::universal_time());
+  algorithm.OnAck(MakeSample(now, kRoundTripTime, 0));
+  EXPECT_EQ(2 * Parameters::default_window_size, algorithm.SendWindowSize());
+  algorithm.OnAck(MakeSample(now + bptime::microseconds(kRoundTripTime / 2), kRoundTripTime, 0));
+  EXPECT_EQ(2 * Parameters::default_window_size, algorithm.SendWindowSize());
+  now += bptime::microseconds(kRoundTripTime);
+  algorithm.OnAck(MakeSample(now, kRoundTripTime, 0));
+  size_t window_at_loss(algorithm.SendWindowSize());
+  EXPECT_EQ(4 * Parameters::default_window_size, window_at_loss);
+
+  // Losses within one round trip are a single congestion event.
+  algorithm.OnLoss(now);
+  algorithm.OnLoss(now + bptime::microseconds(kRoundTripTime / 2));
+  EXPECT_FALSE(algorithm.InSlowStart());
+  EXPECT_EQ(static_cast<size_t>(window_at_loss * 0.7), algorithm.SendWindowSize());
+
+  // The window regrows towards, then beyond, the window at which the loss happened.
+  size_t previous(algorithm.SendWindowSize());
+  for (int i = 0; i < 200; ++i) {
+    now += bptime::microseconds(kRoundTripTime);
+    algorithm.OnAck(MakeSample(now, kRoundTripTime, 0));
+    ASSERT_GE(algorithm.SendWindowSize(), previous);
+    previous = algorithm.SendWindowSize();
+  }
+  EXPECT_GT(algorithm.SendWindowSize(), window_at_loss);
+  EXPECT_LE(algorithm.SendWindowSize(), Parameters::maximum_window_size);
+}
+
+TEST(CongestionAlgorithmTest, BEH_SelectPerConnection) {
+  // Each connection starts with the process-wide default and may select another of its own.
+  CongestionControl default_control, cubic_control;
+  cubic_control.SetAlgorithm(Parameters::kCubic);
+  EXPECT_EQ(Parameters::congestion_control_algorithm, default_control.Algorithm());
+  EXPECT_EQ(Parameters::kCubic, cubic_control.Algorithm());
+  cubic_control.SetAlgorithm(Parameters::kRateBased);
+  EXPECT_EQ(Parameters::kRateBased, cubic_control.Algorithm());
+  EXPECT_EQ(Parameters::congestion_control_algorithm, default_control.Algorithm());
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
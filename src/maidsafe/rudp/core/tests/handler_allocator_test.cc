@@ -0,0 +1,99 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <functional>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/strand.hpp"
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/handler_allocator.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+bool InAllocator(const HandlerAllocator& allocator, const void* pointer) {
+  const char* begin(reinterpret_cast<const char*>(&allocator));
+  const char* p(static_cast<const char*>(pointer));
+  return p >= begin && p < begin + sizeof(allocator);
+}
+
+}  // unnamed namespace
+
+TEST(HandlerAllocatorTest, BEH_RecyclesSlots) {
+  HandlerAllocator allocator;
+  void* first(allocator.Allocate(16));
+  EXPECT_TRUE(InAllocator(allocator, first));
+  allocator.Deallocate(first);
+  // A freed slot is handed out again.
+  void* second(allocator.Allocate(HandlerAllocator::kSlotSize));
+  EXPECT_EQ(first, second);
+  allocator.Deallocate(second);
+
+  // Oversized requests, and requests made while every slot is in use, go to the heap.
+  void* large(allocator.Allocate(HandlerAllocator::kSlotSize + 1));
+  EXPECT_FALSE(InAllocator(allocator, large));
+  allocator.Deallocate(large);
+
+  std::vector<void*> slots;
+  for (int i(0); i != HandlerAllocator::kSlotCount; ++i) {
+    slots.push_back(allocator.Allocate(16));
+    EXPECT_TRUE(InAllocator(allocator, slots.back()));
+  }
+  void* overflow(allocator.Allocate(16));
+  EXPECT_FALSE(InAllocator(allocator, overflow));
+  allocator.Deallocate(overflow);
+  for (auto slot : slots)
+    allocator.Deallocate(slot);
+}
+
+TEST(HandlerAllocatorTest, BEH_StrandWrappedHandlers) {
+  boost::asio::io_service io_service;
+  boost::asio::io_service::strand strand(io_service);
+  HandlerAllocator allocator;
+  int invoked(0);
+  std::function<void()> repeat;
+  repeat = [&] {
+    if (++invoked != 100)
+      io_service.post(strand.wrap(MakeAllocHandler(allocator, [&] { repeat(); })));
+  };
+  io_service.post(strand.wrap(MakeAllocHandler(allocator, [&] { repeat(); })));
+  io_service.run();
+  EXPECT_EQ(100, invoked);
+
+  // Every slot has been released once the handlers have run.
+  for (int i(0); i != HandlerAllocator::kSlotCount; ++i)
+    EXPECT_TRUE(InAllocator(allocator, allocator.Allocate(16)));
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
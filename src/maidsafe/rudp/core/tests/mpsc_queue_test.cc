@@ -0,0 +1,112 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/mpsc_queue.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+TEST(MpscQueueTest, BEH_PushPop) {
+  MpscQueue<int> queue;
+  int item(0);
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_FALSE(queue.Pop(item));
+
+  for (int i(0); i != 10; ++i)
+    queue.Push(i);
+  EXPECT_FALSE(queue.Empty());
+  for (int i(0); i != 10; ++i) {
+    ASSERT_TRUE(queue.Pop(item));
+    EXPECT_EQ(i, item);
+  }
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_FALSE(queue.Pop(item));
+
+  // Items left in the queue are freed along with it.
+  queue.Push(10);
+  queue.Push(11);
+}
+
+TEST(MpscQueueTest, BEH_PoolExhausted) {
+  // Items beyond the pool's size are held in nodes from the heap, and the pooled nodes are reused.
+  MpscQueue<int> queue(4);
+  int item(0);
+  for (int round(0); round != 3; ++round) {
+    for (int i(0); i != 10; ++i)
+      queue.Push(i);
+    for (int i(0); i != 10; ++i) {
+      ASSERT_TRUE(queue.Pop(item));
+      EXPECT_EQ(i, item);
+    }
+    EXPECT_FALSE(queue.Pop(item));
+  }
+  queue.Push(10);
+}
+
+TEST(MpscQueueTest, BEH_ConcurrentProducers) {
+  const int kProducerCount(4), kItemsPerProducer(10000);
+  // A small pool has the producers contending for its nodes as the consumer returns them.
+  MpscQueue<int> queue(8);
+  std::atomic<int> finished_producers(0);
+  std::vector<std::thread> producers;
+  for (int producer(0); producer != kProducerCount; ++producer) {
+    producers.emplace_back([&, producer] {
+      for (int i(0); i != kItemsPerProducer; ++i)
+        queue.Push(producer * kItemsPerProducer + i);
+      ++finished_producers;
+    });
+  }
+
+  // Each producer's items must arrive in the order it pushed them.
+  std::vector<int> next_expected(kProducerCount);
+  for (int producer(0); producer != kProducerCount; ++producer)
+    next_expected[producer] = producer * kItemsPerProducer;
+  int popped(0), item(0);
+  while (popped != kProducerCount * kItemsPerProducer) {
+    if (!queue.Pop(item)) {
+      ASSERT_FALSE(finished_producers == kProducerCount && queue.Empty());
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(next_expected[item / kItemsPerProducer]++, item);
+    ++popped;
+  }
+  EXPECT_FALSE(queue.Pop(item));
+
+  for (auto& producer : producers)
+    producer.join();
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,75 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/pacer.h"
+
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+TEST(PacerTest, BEH_SpreadsSends) {
+  const double kRate(10000.0);  // One packet every 100 microseconds.
+  Pacer pacer;
+  bptime::ptime now(bptime::microsec_clock::universal_time());
+
+  // The first packet may go at once, the next only after one interval.
+  EXPECT_EQ(1U, pacer.Allowance(now, kRate));
+  pacer.OnSent(1);
+  EXPECT_EQ(0U, pacer.Allowance(now, kRate));
+  bptime::ptime next(pacer.NextSendTime(now, kRate));
+  EXPECT_GE(next - now, bptime::microseconds(100));
+  EXPECT_LE(next - now, bptime::microseconds(101));
+  EXPECT_EQ(1U, pacer.Allowance(next, kRate));
+  pacer.OnSent(1);
+
+  // Credit accrues with time...
+  now = next + bptime::microseconds(350);
+  EXPECT_EQ(3U, pacer.Allowance(now, kRate));
+  EXPECT_EQ(now, pacer.NextSendTime(now, kRate));
+  pacer.OnSent(3);
+
+  // ...but an idle period releases at most one quantum's worth.
+  now += bptime::seconds(5);
+  EXPECT_EQ(static_cast<size_t>(kRate * Pacer::Quantum().total_microseconds() / 1000000),
+            pacer.Allowance(now, kRate));
+
+  // Slow rates still allow one packet at a time.
+  Pacer slow_pacer;
+  EXPECT_EQ(1U, slow_pacer.Allowance(now, 10.0));
+  now += bptime::seconds(5);
+  EXPECT_EQ(1U, slow_pacer.Allowance(now, 10.0));
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
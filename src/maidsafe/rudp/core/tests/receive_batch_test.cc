@@ -0,0 +1,91 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <string>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/receive_batch.h"
+
+namespace ip = boost::asio::ip;
+namespace bs = boost::system;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+TEST(ReceiveBatchTest, BEH_ReceiveFrom) {
+  const size_t kSlotSize(64), kSlotCount(4), kDatagramCount(6);
+  boost::asio::io_service io_service;
+  ip::udp::socket receiver(io_service, ip::udp::endpoint(ip::address_v4::loopback(), 0));
+  ip::udp::socket sender(io_service, ip::udp::endpoint(ip::address_v4::loopback(), 0));
+  receiver.non_blocking(true);
+
+  std::vector<unsigned char> storage(kSlotSize * kSlotCount);
+  ReceiveBatch batch(&storage[0], kSlotSize, kSlotCount);
+  EXPECT_EQ(kSlotCount, batch.Capacity());
+  EXPECT_EQ(0U, batch.Size());
+
+  // Nothing to receive yet.
+  bs::error_code ec;
+  EXPECT_EQ(0U, batch.ReceiveFrom(receiver, ec));
+  EXPECT_EQ(boost::asio::error::would_block, ec);
+
+  for (size_t i = 0; i != kDatagramCount; ++i) {
+    std::string datagram(i + 1, static_cast<char>('a' + i));
+    sender.send_to(boost::asio::buffer(datagram), receiver.local_endpoint());
+  }
+
+  // The first call fills every slot, the second takes the remainder.
+  size_t received(0);
+  for (size_t expected : {kSlotCount, kDatagramCount - kSlotCount}) {
+    ASSERT_EQ(expected, batch.ReceiveFrom(receiver, ec));
+    EXPECT_FALSE(ec);
+    ASSERT_EQ(expected, batch.Size());
+    for (size_t i = 0; i != batch.Size(); ++i, ++received) {
+      EXPECT_EQ(received + 1, boost::asio::buffer_size(batch.Data(i)));
+      EXPECT_EQ('a' + received, *boost::asio::buffer_cast<const char*>(batch.Data(i)));
+      EXPECT_EQ(sender.local_endpoint(), batch.SenderEndpoint(i));
+    }
+  }
+
+  EXPECT_EQ(0U, batch.ReceiveFrom(receiver, ec));
+  EXPECT_EQ(boost::asio::error::would_block, ec);
+
+  // A datagram completed by an asynchronous receive into the first slot.
+  batch.AssignFirst(3);
+  EXPECT_EQ(1U, batch.Size());
+  EXPECT_EQ(3U, boost::asio::buffer_size(batch.Data(0)));
+  EXPECT_EQ(kSlotSize, boost::asio::buffer_size(batch.FirstSlot()));
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,193 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/io_service.hpp"
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/congestion_control.h"
+#include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/peer.h"
+#include "maidsafe/rudp/core/receiver.h"
+#include "maidsafe/rudp/core/tick_timer.h"
+#include "maidsafe/rudp/core/timing_wheel.h"
+#include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/packets/packet_buffer_pool.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+std::string SizePrefix(size_t size) {
+  std::string prefix(4, 0);
+  for (int i = 0; i != 4; ++i)
+    prefix[i] = static_cast<char>(size >> (8 * (3 - i)));
+  return prefix;
+}
+
+std::vector<unsigned char> EncodePacket(uint32_t sequence_number, uint32_t message_number,
+                                        bool first, bool last, const std::string& payload,
+                                        bool in_order = true) {
+  DataPacket packet;
+  packet.SetPacketSequenceNumber(sequence_number);
+  packet.SetMessageNumber(message_number);
+  packet.SetFirstPacketInMessage(first);
+  packet.SetLastPacketInMessage(last);
+  packet.SetInOrder(in_order);
+  packet.SetData(payload);
+  std::vector<unsigned char> encoded(DataPacket::kHeaderSize + payload.size());
+  std::vector<boost::asio::mutable_buffer> buffers(
+      1, boost::asio::mutable_buffer(&encoded[0], encoded.size()));
+  packet.Encode(buffers);
+  std::memcpy(&encoded[DataPacket::kHeaderSize], payload.data(), payload.size());
+  return encoded;
+}
+
+// Encodes a single-packet message with its size prefix, as a peer's Sender would.
+std::vector<unsigned char> EncodeMessage(uint32_t sequence_number, uint32_t message_number,
+                                         const std::string& message) {
+  return EncodePacket(sequence_number, message_number, true, true,
+                      SizePrefix(message.size()) + message);
+}
+
+}  // unnamed namespace
+
+TEST(ReceiverTest, BEH_PayloadBuffersRecycled) {
+  boost::asio::io_service io_service;
+  Multiplexer multiplexer(io_service);
+  Peer peer(multiplexer);
+  TimingWheel timing_wheel(io_service);
+  TickTimer tick_timer(timing_wheel);
+  CongestionControl congestion_control;
+  Receiver receiver(peer, tick_timer, congestion_control);
+  const uint32_t kInitialSequenceNumber(1000);
+  receiver.Reset(kInitialSequenceNumber);
+
+  // The packet which a socket decodes each datagram into.
+  DataPacket packet;
+  PacketBufferPool& pool(PacketBufferPool::Small());
+  size_t in_use(0);
+  std::string message;
+  Receiver::MessagePiece piece;
+  for (uint32_t i(0); i != 1000; ++i) {
+    std::string sent("Message " + std::to_string(i));
+    std::vector<unsigned char> encoded(EncodeMessage(kInitialSequenceNumber + i, i + 1, sent));
+    ASSERT_TRUE(packet.Decode(boost::asio::buffer(encoded)));
+    receiver.HandleData(packet);
+    ASSERT_EQ(kSuccess, receiver.ReadMessage(message, 1024, piece));
+    EXPECT_EQ(sent, message);
+    // Once the socket's packet has been handed a spare buffer, the same buffers circulate between
+    // it and the window without going back to the pool.
+    if (i == 1)
+      in_use = pool.InUse();
+    else if (i > 1)
+      ASSERT_EQ(in_use, pool.InUse());
+  }
+}
+
+TEST(ReceiverTest, BEH_MessagesFromOlderPeersAssembled) {
+  boost::asio::io_service io_service;
+  Multiplexer multiplexer(io_service);
+  Peer peer(multiplexer);
+  TimingWheel timing_wheel(io_service);
+  TickTimer tick_timer(timing_wheel);
+  CongestionControl congestion_control;
+  Receiver receiver(peer, tick_timer, congestion_control);
+  uint32_t sequence_number(500);
+  receiver.Reset(sequence_number);
+
+  // Older peers flag every packet but the first of a message as FirstPacketInMessage.
+  DataPacket packet;
+  std::string message;
+  Receiver::MessagePiece piece;
+  for (uint32_t message_number(7); message_number != 10; ++message_number) {
+    const std::string kSent(SizePrefix(12) + "Message " + std::to_string(message_number) + "...");
+    for (size_t offset(0); offset < kSent.size(); offset += 5) {
+      bool last(offset + 5 >= kSent.size());
+      std::vector<unsigned char> encoded(EncodePacket(sequence_number++, message_number,
+                                                      offset != 0, last, kSent.substr(offset, 5)));
+      ASSERT_TRUE(packet.Decode(boost::asio::buffer(encoded)));
+      receiver.HandleData(packet);
+      if (!last)
+        EXPECT_EQ(kPendingResult, receiver.ReadMessage(message, 1024, piece));
+    }
+    ASSERT_EQ(kSuccess, receiver.ReadMessage(message, 1024, piece));
+    EXPECT_EQ(kSent.substr(4), message);
+    EXPECT_EQ(message_number, piece.message_number);
+  }
+}
+
+TEST(ReceiverTest, BEH_UnorderedMessagesDeliveredPastLoss) {
+  boost::asio::io_service io_service;
+  Multiplexer multiplexer(io_service);
+  Peer peer(multiplexer);
+  TimingWheel timing_wheel(io_service);
+  TickTimer tick_timer(timing_wheel);
+  CongestionControl congestion_control;
+  Receiver receiver(peer, tick_timer, congestion_control);
+  receiver.Reset(100);
+
+  // Message 1 is packet 100, message 2 is packets 101 and 103, and message 3 is packet 102, all
+  // sent unordered.  Each is delivered as soon as its own packets have arrived.
+  DataPacket packet;
+  std::string message;
+  Receiver::MessagePiece piece;
+  auto receive = [&](uint32_t sequence_number, uint32_t message_number, bool first, bool last,
+                     const std::string& payload) {
+    std::vector<unsigned char> encoded(
+        EncodePacket(sequence_number, message_number, first, last, payload, false));
+    ASSERT_TRUE(packet.Decode(boost::asio::buffer(encoded)));
+    receiver.HandleData(packet);
+  };
+  receive(103, 2, false, true, "age 2");
+  EXPECT_EQ(kPendingResult, receiver.ReadMessage(message, 1024, piece));
+  receive(102, 3, true, true, SizePrefix(9) + "Message 3");
+  ASSERT_EQ(kSuccess, receiver.ReadMessage(message, 1024, piece));
+  EXPECT_EQ("Message 3", message);
+  EXPECT_EQ(3U, piece.message_number);
+  EXPECT_EQ(kPendingResult, receiver.ReadMessage(message, 1024, piece));
+  receive(101, 2, true, false, SizePrefix(9) + "Mess");
+  ASSERT_EQ(kSuccess, receiver.ReadMessage(message, 1024, piece));
+  EXPECT_EQ("Message 2", message);
+  EXPECT_EQ(2U, piece.message_number);
+  EXPECT_EQ(kPendingResult, receiver.ReadMessage(message, 1024, piece));
+  receive(100, 1, true, true, SizePrefix(9) + "Message 1");
+  ASSERT_EQ(kSuccess, receiver.ReadMessage(message, 1024, piece));
+  EXPECT_EQ("Message 1", message);
+  EXPECT_EQ(1U, piece.message_number);
+  EXPECT_EQ(kPendingResult, receiver.ReadMessage(message, 1024, piece));
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,96 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <string>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/send_batch.h"
+#include "maidsafe/rudp/packets/data_packet.h"
+
+namespace ip = boost::asio::ip;
+namespace bs = boost::system;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+TEST(SendBatchTest, BEH_SendTo) {
+  const size_t kSlotSize(64), kSlotCount(4);
+  boost::asio::io_service io_service;
+  ip::udp::socket receiver(io_service, ip::udp::endpoint(ip::address_v4::loopback(), 0));
+  ip::udp::socket sender(io_service, ip::udp::endpoint(ip::address_v4::loopback(), 0));
+  receiver.non_blocking(true);
+
+  std::vector<unsigned char> storage(kSlotSize * kSlotCount);
+  SendBatch batch(&storage[0], kSlotSize, kSlotCount);
+  EXPECT_EQ(kSlotCount, batch.Capacity());
+  EXPECT_TRUE(batch.IsEmpty());
+
+  // Sending an empty batch is a no-op.
+  bs::error_code ec;
+  EXPECT_EQ(0U, batch.SendTo(sender, ec));
+  EXPECT_FALSE(ec);
+
+  std::vector<std::string> payloads;
+  std::vector<DataPacket> packets(kSlotCount);
+  for (size_t i = 0; i != kSlotCount; ++i) {
+    payloads.push_back(std::string(i + 1, static_cast<char>('a' + i)));
+    packets[i].SetPacketSequenceNumber(static_cast<uint32_t>(i));
+    packets[i].SetData(payloads[i]);
+    EXPECT_EQ(DataPacket::kHeaderSize + i + 1,
+              batch.Add(packets[i], receiver.local_endpoint()));
+  }
+  EXPECT_TRUE(batch.IsFull());
+
+  // Simulated loss of the last packet still counts it as sent.
+  batch.DropLast();
+  EXPECT_EQ(kSlotCount, batch.SendTo(sender, ec));
+  EXPECT_FALSE(ec);
+  EXPECT_TRUE(batch.IsEmpty());
+
+  std::vector<unsigned char> datagram(kSlotSize);
+  ip::udp::endpoint sender_endpoint;
+  for (size_t i = 0; i != kSlotCount - 1; ++i) {
+    size_t length(receiver.receive_from(boost::asio::buffer(datagram), sender_endpoint, 0, ec));
+    ASSERT_FALSE(ec);
+    EXPECT_EQ(sender.local_endpoint(), sender_endpoint);
+    DataPacket decoded;
+    ASSERT_TRUE(decoded.Decode(boost::asio::buffer(datagram, length)));
+    EXPECT_EQ(i, decoded.PacketSequenceNumber());
+    EXPECT_EQ(payloads[i], decoded.Data());
+  }
+  receiver.receive_from(boost::asio::buffer(datagram), sender_endpoint, 0, ec);
+  EXPECT_EQ(boost::asio::error::would_block, ec);
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,107 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <set>
+#include <vector>
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/rudp/core/sequence_range_set.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+// The ranges expected for a plain set of sequence numbers.
+std::vector<SequenceRangeSet::Range> ToRanges(const std::set<uint32_t>& numbers) {
+  std::vector<SequenceRangeSet::Range> ranges;
+  for (uint32_t n : numbers) {
+    if (!ranges.empty() && ranges.back().second + 1 == n)
+      ranges.back().second = n;
+    else
+      ranges.push_back(SequenceRangeSet::Range(n, n));
+  }
+  return ranges;
+}
+
+}  // unnamed namespace
+
+TEST(SequenceRangeSetTest, BEH_InsertAndErase) {
+  SequenceRangeSet set;
+  EXPECT_TRUE(set.IsEmpty());
+
+  for (uint32_t n : {5, 6, 7, 10, 9, 2, 8, 3, 3}) {
+    set.Insert(n);
+    EXPECT_TRUE(set.Contains(n));
+  }
+  EXPECT_EQ(8U, set.Size());
+  EXPECT_EQ(ToRanges({2, 3, 5, 6, 7, 8, 9, 10}), set.Ranges());
+  EXPECT_FALSE(set.Contains(4));
+
+  // Split a range.
+  set.Erase(7, 8);
+  EXPECT_EQ(ToRanges({2, 3, 5, 6, 9, 10}), set.Ranges());
+  EXPECT_EQ(6U, set.Size());
+
+  // Erase across several ranges, trimming the first and last.
+  set.Erase(3, 9);
+  EXPECT_EQ(ToRanges({2, 10}), set.Ranges());
+  EXPECT_EQ(2U, set.Size());
+
+  // Erase numbers not present.
+  set.Erase(4, 8);
+  EXPECT_EQ(2U, set.Size());
+
+  set.Erase(0, 100);
+  EXPECT_TRUE(set.IsEmpty());
+  EXPECT_TRUE(set.Ranges().empty());
+}
+
+TEST(SequenceRangeSetTest, BEH_MatchesStdSet) {
+  SequenceRangeSet set;
+  std::set<uint32_t> expected;
+  for (int i = 0; i < 10000; ++i) {
+    uint32_t n = RandomUint32() % 512;
+    if (RandomUint32() % 4 != 0) {
+      set.Insert(n);
+      expected.insert(n);
+    } else {
+      uint32_t last = n + RandomUint32() % 8;
+      set.Erase(n, last);
+      expected.erase(expected.lower_bound(n), expected.upper_bound(last));
+    }
+    ASSERT_EQ(expected.size(), set.Size());
+    ASSERT_EQ(ToRanges(expected), set.Ranges());
+  }
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -18,6 +18,8 @@
 
 // Original author: Christopher M. Kohlhoff (chris at kohlhoff dot com)
 
+#include <vector>
+
 #include "maidsafe/common/test.h"
 #include "maidsafe/common/log.h"
 #include "maidsafe/rudp/core/sliding_window.h"
@@ -61,6 +63,82 @@ TEST(SlidingWindowTest, BEH_Wraparound) {
   TestWindowRange(SlidingWindow<uint32_t>::kMaxSequenceNumber - kTestPacketCount / 2);
 }
 
+TEST(SlidingWindowTest, BEH_SlotReuse) {
+  SlidingWindow<uint32_t> window(SlidingWindow<uint32_t>::kMaxSequenceNumber - 10);
+  window.SetMaximumSize(Parameters::maximum_window_size);
+  ASSERT_EQ(Parameters::maximum_window_size, window.MaximumSize());
+
+  // Cycle through every slot several times, including across the sequence number wraparound.
+  // Appended items must always start out default-constructed, whatever their slot last held.
+  for (size_t i = 0; i < 4 * Parameters::maximum_window_size; ++i) {
+    if (window.IsFull()) {
+      ASSERT_EQ(window.Begin() + 1, window.Front());
+      window.Remove();
+    }
+    uint32_t n = window.Append();
+    ASSERT_EQ(0U, window[n]);
+    ASSERT_EQ(0U, window.Back());
+    window[n] = n + 1;
+  }
+  EXPECT_TRUE(window.IsFull());
+  EXPECT_EQ(Parameters::maximum_window_size, window.Size());
+}
+
+TEST(SlidingWindowTest, BEH_ForEachInRange) {
+  const uint32_t kMax = SlidingWindow<uint32_t>::kMaxSequenceNumber;
+  for (uint32_t first_sequence_number : {0U, 1000U, kMax - 5}) {
+    SlidingWindow<uint32_t> window(first_sequence_number);
+    for (int i = 0; i < 12; ++i)
+      window.Append();
+
+    // Compare against a brute force walk of the range for ranges around the window's edges,
+    // including ranges which wrap around past kMaxSequenceNumber.
+    for (uint32_t first_offset : {0U, 1U, 5U, 11U, 12U, 20U, kMax - 2, kMax}) {
+      for (uint32_t length : {1U, 2U, 7U, 12U, 30U}) {
+        uint32_t first = (first_sequence_number + first_offset) & kMax;
+        uint32_t last = (first + length - 1) & kMax;
+        std::vector<uint32_t> expected, visited;
+        for (uint32_t i = 0, n = first; i < length; ++i, n = window.Next(n)) {
+          if (window.Contains(n))
+            expected.push_back(n);
+        }
+        window.ForEachInRange(first, last, [&visited](uint32_t n) { visited.push_back(n); });
+        EXPECT_EQ(expected, visited) << "first " << first << ", last " << last;
+      }
+    }
+  }
+}
+
+TEST(SlidingWindowTest, BEH_ForEachInRangeIgnoresMalformedRanges) {
+  const uint32_t kMax = SlidingWindow<uint32_t>::kMaxSequenceNumber;
+  for (uint32_t first_sequence_number : {0U, 1000U, kMax - 5}) {
+    SlidingWindow<uint32_t> window(first_sequence_number);
+    for (int i = 0; i < 12; ++i)
+      window.Append();
+    std::vector<uint32_t> visited;
+    auto visit([&visited](uint32_t n) { visited.push_back(n); });
+
+    // A reversed range, as a bad or hostile ACK might carry, mustn't be read as one wrapping
+    // around through almost every sequence number.
+    uint32_t first = (first_sequence_number + 8) & kMax;
+    uint32_t last = (first_sequence_number + 3) & kMax;
+    window.ForEachInRange(first, last, visit);
+    EXPECT_TRUE(visited.empty()) << "first " << first << ", last " << last;
+
+    // Nor is any other range longer than the window could be.
+    first = (first_sequence_number - 1) & kMax;
+    last = (first + static_cast<uint32_t>(Parameters::maximum_window_size) * 4) & kMax;
+    window.ForEachInRange(first, last, visit);
+    EXPECT_TRUE(visited.empty()) << "first " << first << ", last " << last;
+
+    // A range which merely wraps around past kMaxSequenceNumber is still honoured.
+    first = (first_sequence_number - 2) & kMax;
+    last = (first_sequence_number + 1) & kMax;
+    window.ForEachInRange(first, last, visit);
+    EXPECT_EQ(2U, visited.size());
+  }
+}
+
 }  // namespace test
 
 }  // namespace detail
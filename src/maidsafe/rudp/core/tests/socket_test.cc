@@ -18,8 +18,12 @@
 
 // Original author: Christopher M. Kohlhoff (chris at kohlhoff dot com)
 
+#include <algorithm>
 #include <functional>
 #include <memory>
+#include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "maidsafe/common/log.h"
@@ -160,6 +164,275 @@ TEST(SocketTest, BEH_Socket) {
   ASSERT_TRUE(!client_ec);
 }
 
+TEST(SocketTest, BEH_ReadMessage) {
+  using Endpoint = ip::udp::endpoint;
+
+  boost::asio::io_service io_service;
+  bs::error_code server_ec;
+  bs::error_code client_ec;
+  NodeId server_node_id(RandomString(NodeId::kSize)), client_node_id(RandomString(NodeId::kSize));
+  asymm::Keys server_key_pair(asymm::GenerateKeyPair()), client_key_pair(asymm::GenerateKeyPair());
+  std::shared_ptr<asymm::PublicKey> server_public_key(
+      std::make_shared<asymm::PublicKey>(server_key_pair.public_key));
+  std::shared_ptr<asymm::PublicKey> client_public_key(
+      std::make_shared<asymm::PublicKey>(client_key_pair.public_key));
+
+  std::shared_ptr<Multiplexer> server_multiplexer(new Multiplexer(io_service));
+  ConnectionManager server_connection_manager(
+      std::shared_ptr<Transport>(), boost::asio::io_service::strand(io_service), server_multiplexer,
+      server_node_id, std::shared_ptr<asymm::PublicKey>());
+  ReturnCode condition = server_multiplexer->Open(Endpoint(AsioToBoostAsio(GetLocalIp()), 0));
+  ASSERT_EQ(kSuccess, condition);
+  auto server_endpoint = server_multiplexer->local_endpoint();
+
+  std::shared_ptr<Multiplexer> client_multiplexer(new Multiplexer(io_service));
+  ConnectionManager client_connection_manager(
+      std::shared_ptr<Transport>(), boost::asio::io_service::strand(io_service), client_multiplexer,
+      client_node_id, std::shared_ptr<asymm::PublicKey>());
+  condition = client_multiplexer->Open(Endpoint(AsioToBoostAsio(GetLocalIp()), 0));
+  ASSERT_EQ(kSuccess, condition);
+  auto client_endpoint = client_multiplexer->local_endpoint();
+
+  server_multiplexer->AsyncDispatch(std::bind(&dispatch_handler, args::_1, server_multiplexer));
+  client_multiplexer->AsyncDispatch(std::bind(&dispatch_handler, args::_1, client_multiplexer));
+
+  NatType server_nat_type = NatType::kUnknown, client_nat_type = NatType::kUnknown;
+  Socket server_socket(*server_multiplexer, server_nat_type);
+  Socket client_socket(*client_multiplexer, client_nat_type);
+  server_ec = boost::asio::error::would_block;
+  client_ec = boost::asio::error::would_block;
+  auto on_nat_detection_requested_slot([](
+      const Endpoint & /*this_local_endpoint*/, const NodeId & /*peer_id*/,
+      const Endpoint & /*peer_endpoint*/,
+      uint16_t & /*another_external_port*/) {});
+  client_socket.AsyncConnect(client_node_id, client_public_key, server_endpoint, server_node_id,
+                             std::bind(&handler1, args::_1, &client_ec), Session::kNormal, 0,
+                             on_nat_detection_requested_slot);
+  server_socket.AsyncConnect(server_node_id, server_public_key, client_endpoint, client_node_id,
+                             std::bind(&handler1, args::_1, &server_ec), Session::kNormal, 0,
+                             on_nat_detection_requested_slot);
+
+  do {
+    io_service.run_one();
+  } while (server_ec == boost::asio::error::would_block ||
+           client_ec == boost::asio::error::would_block);
+  ASSERT_TRUE(!server_ec);
+  ASSERT_TRUE(!client_ec);
+
+  server_socket.AsyncTick(std::bind(&tick_handler, args::_1, &server_socket));
+  client_socket.AsyncTick(std::bind(&tick_handler, args::_1, &client_socket));
+
+  // Each message is written as a size prefix followed by its data, and read back whole.
+  const std::vector<size_t> kMessageSizes = {0, 1, 1000, kBufferSize};
+  for (size_t message_size : kMessageSizes) {
+    std::string sent_message(RandomString(message_size)), received_message;
+    std::string size_prefix(4, 0);
+    for (int i = 0; i != 4; ++i)
+      size_prefix[i] = static_cast<char>(message_size >> (8 * (3 - i)));
+    server_ec = boost::asio::error::would_block;
+    server_socket.AsyncReadMessage(received_message, kBufferSize,
+                                   std::bind(&handler1, args::_1, &server_ec));
+
+    client_ec = boost::asio::error::would_block;
+    std::vector<SharedBuffer> segments;
+    segments.push_back(SharedBuffer(size_prefix));
+    segments.push_back(SharedBuffer(sent_message));
+    client_socket.AsyncWrite(segments, [](int) {},  // NOLINT (Fraser)
+                             std::bind(&handler1, args::_1, &client_ec));
+
+    do {
+      io_service.run_one();
+    } while (server_ec == boost::asio::error::would_block ||
+             client_ec == boost::asio::error::would_block);
+    ASSERT_TRUE(!server_ec);
+    ASSERT_TRUE(!client_ec);
+    EXPECT_EQ(sent_message, received_message);
+  }
+
+  // Many messages can be outstanding at once, and arrive in the order written.
+  const size_t kPipelinedMessages = 100;
+  std::vector<std::string> sent_messages;
+  std::vector<bs::error_code> write_ecs(kPipelinedMessages, boost::asio::error::would_block);
+  for (size_t i = 0; i != kPipelinedMessages; ++i) {
+    sent_messages.push_back(RandomString(1 + (i * 37) % 2000));
+    std::string size_prefix(4, 0);
+    for (int j = 0; j != 4; ++j)
+      size_prefix[j] = static_cast<char>(sent_messages.back().size() >> (8 * (3 - j)));
+    std::vector<SharedBuffer> segments;
+    segments.push_back(SharedBuffer(size_prefix));
+    segments.push_back(SharedBuffer(sent_messages.back()));
+    client_socket.AsyncWrite(segments, [](int) {},  // NOLINT (Fraser)
+                             std::bind(&handler1, args::_1, &write_ecs[i]));
+  }
+  for (size_t i = 0; i != kPipelinedMessages; ++i) {
+    std::string received_message;
+    server_ec = boost::asio::error::would_block;
+    server_socket.AsyncReadMessage(received_message, kBufferSize,
+                                   std::bind(&handler1, args::_1, &server_ec));
+    do {
+      io_service.run_one();
+    } while (server_ec == boost::asio::error::would_block);
+    ASSERT_TRUE(!server_ec);
+    EXPECT_EQ(sent_messages[i], received_message);
+  }
+  while (io_service.poll_one() != 0) {
+  }
+  for (const auto& write_ec : write_ecs)
+    EXPECT_TRUE(!write_ec);
+
+  // Messages written without in-order delivery all arrive whole, though possibly reordered.
+  std::multiset<std::string> unordered_messages;
+  std::fill(write_ecs.begin(), write_ecs.end(), boost::asio::error::would_block);
+  for (size_t i = 0; i != kPipelinedMessages; ++i) {
+    std::string message(RandomString(1 + (i * 53) % 3000));
+    unordered_messages.insert(message);
+    std::string size_prefix(4, 0);
+    for (int j = 0; j != 4; ++j)
+      size_prefix[j] = static_cast<char>(message.size() >> (8 * (3 - j)));
+    std::vector<SharedBuffer> segments;
+    segments.push_back(SharedBuffer(size_prefix));
+    segments.push_back(SharedBuffer(message));
+    client_socket.AsyncWrite(segments, false, [](int) {},  // NOLINT (Fraser)
+                             std::bind(&handler1, args::_1, &write_ecs[i]));
+  }
+  for (size_t i = 0; i != kPipelinedMessages; ++i) {
+    std::string received_message;
+    server_ec = boost::asio::error::would_block;
+    server_socket.AsyncReadMessage(received_message, kBufferSize,
+                                   std::bind(&handler1, args::_1, &server_ec));
+    do {
+      io_service.run_one();
+    } while (server_ec == boost::asio::error::would_block);
+    ASSERT_TRUE(!server_ec);
+    auto itr(unordered_messages.find(received_message));
+    ASSERT_TRUE(itr != unordered_messages.end());
+    unordered_messages.erase(itr);
+  }
+  while (io_service.poll_one() != 0) {
+  }
+  for (const auto& write_ec : write_ecs)
+    EXPECT_TRUE(!write_ec);
+
+  // A small high priority message is not held up behind a large low priority one written first.
+  {
+    std::string bulk_message(RandomString(4 * kBufferSize)), control_message(RandomString(100));
+    std::vector<bs::error_code> priority_write_ecs(2, boost::asio::error::would_block);
+    const std::vector<std::pair<std::string*, Parameters::MessagePriority>> kWrites = {
+        {&bulk_message, Parameters::kLowPriority}, {&control_message, Parameters::kHighPriority}};
+    for (size_t i = 0; i != kWrites.size(); ++i) {
+      std::string size_prefix(4, 0);
+      for (int j = 0; j != 4; ++j)
+        size_prefix[j] = static_cast<char>(kWrites[i].first->size() >> (8 * (3 - j)));
+      std::vector<SharedBuffer> segments;
+      segments.push_back(SharedBuffer(size_prefix));
+      segments.push_back(SharedBuffer(*kWrites[i].first));
+      client_socket.AsyncWrite(segments, kWrites[i].second, true, [](int) {},  // NOLINT (Fraser)
+                               std::bind(&handler1, args::_1, &priority_write_ecs[i]));
+    }
+    for (const std::string* expected_message : {&control_message, &bulk_message}) {
+      std::string received_message;
+      server_ec = boost::asio::error::would_block;
+      server_socket.AsyncReadMessage(received_message, 4 * kBufferSize,
+                                     std::bind(&handler1, args::_1, &server_ec));
+      do {
+        io_service.run_one();
+      } while (server_ec == boost::asio::error::would_block);
+      ASSERT_TRUE(!server_ec);
+      EXPECT_TRUE(*expected_message == received_message);
+    }
+    while (io_service.poll_one() != 0) {
+    }
+    for (const auto& write_ec : priority_write_ecs)
+      EXPECT_TRUE(!write_ec);
+  }
+
+  // A message written in parts, with a streamed size prefix, is read back a piece at a time, and
+  // may be larger than the reader's limit on whole messages.
+  {
+    const std::vector<std::string> kParts = {RandomString(10), RandomString(kBufferSize),
+                                             RandomString(3000)};
+    uint32_t message_number(client_socket.StartMessage(Parameters::kNormalPriority,
+                                                       [](int) {}));  // NOLINT (Fraser)
+    std::vector<bs::error_code> part_write_ecs(kParts.size(), boost::asio::error::would_block);
+    std::string sent_message;
+    for (size_t i = 0; i != kParts.size(); ++i) {
+      std::vector<SharedBuffer> segments;
+      if (i == 0)
+        segments.push_back(SharedBuffer(std::string(4, '\xff')));
+      segments.push_back(SharedBuffer(kParts[i]));
+      sent_message += kParts[i];
+      client_socket.AsyncWritePart(message_number, segments, i + 1 == kParts.size(),
+                                   std::bind(&handler1, args::_1, &part_write_ecs[i]));
+    }
+    std::string received_message;
+    Receiver::MessagePiece piece;
+    do {
+      std::string received_piece;
+      server_ec = boost::asio::error::would_block;
+      server_socket.AsyncReadMessage(received_piece, piece, 1024,
+                                     std::bind(&handler1, args::_1, &server_ec));
+      do {
+        io_service.run_one();
+      } while (server_ec == boost::asio::error::would_block);
+      ASSERT_TRUE(!server_ec);
+      EXPECT_TRUE(piece.streamed);
+      EXPECT_EQ(received_message.empty(), piece.first);
+      received_message += received_piece;
+    } while (!piece.last);
+    EXPECT_TRUE(sent_message == received_message);
+    while (io_service.poll_one() != 0) {
+    }
+    for (const auto& write_ec : part_write_ecs)
+      EXPECT_TRUE(!write_ec);
+  }
+
+  // A message larger than the reader allows is refused.
+  std::string received_message;
+  std::string size_prefix(4, 0);
+  size_prefix[1] = 1;
+  server_ec = boost::asio::error::would_block;
+  server_socket.AsyncReadMessage(received_message, 1024,
+                                 std::bind(&handler1, args::_1, &server_ec));
+  client_ec = boost::asio::error::would_block;
+  client_socket.AsyncWrite(std::vector<SharedBuffer>(1, SharedBuffer(size_prefix)),
+                           [](int) {},  // NOLINT (Fraser)
+                           std::bind(&handler1, args::_1, &client_ec));
+  do {
+    io_service.run_one();
+  } while (server_ec == boost::asio::error::would_block);
+  EXPECT_EQ(boost::asio::error::message_size, server_ec);
+
+  server_multiplexer->Close();
+  client_multiplexer->Close();
+}
+
+TEST(SocketTest, BEH_SharedMultiplexerEndpoint) {
+#ifdef SO_REUSEPORT
+  using Endpoint = ip::udp::endpoint;
+
+  boost::asio::io_service io_service;
+  std::shared_ptr<Multiplexer> first_multiplexer(new Multiplexer(io_service));
+  ASSERT_EQ(kSuccess,
+            first_multiplexer->Open(Endpoint(AsioToBoostAsio(GetLocalIp()), 0), true));
+  auto endpoint = first_multiplexer->local_endpoint();
+
+  // Only multiplexers opened to share the endpoint can join it.
+  std::shared_ptr<Multiplexer> unshared_multiplexer(new Multiplexer(io_service));
+  EXPECT_EQ(kBindError, unshared_multiplexer->Open(endpoint));
+
+  std::shared_ptr<Multiplexer> second_multiplexer(new Multiplexer(io_service));
+  ASSERT_EQ(kSuccess, second_multiplexer->Open(endpoint, true));
+  EXPECT_EQ(endpoint, second_multiplexer->local_endpoint());
+#ifdef MAIDSAFE_LINUX
+  EXPECT_TRUE(first_multiplexer->SteerBySocketId(2));
+#endif
+
+  first_multiplexer->Close();
+  second_multiplexer->Close();
+  unshared_multiplexer->Close();
+#endif
+}
+
 TEST(SocketTest, BEH_AsyncProbe) {
   using Endpoint = ip::udp::endpoint;
 
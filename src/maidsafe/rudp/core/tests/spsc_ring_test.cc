@@ -0,0 +1,98 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <memory>
+#include <thread>
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/spsc_ring.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+TEST(SpscRingTest, BEH_PushPop) {
+  SpscRing<std::unique_ptr<int>> ring(4);
+  std::unique_ptr<int> item;
+  EXPECT_EQ(4U, ring.Capacity());
+  EXPECT_TRUE(ring.Empty());
+  EXPECT_FALSE(ring.Pop(item));
+
+  // Wrap around the slots a few times, filling the ring each time.
+  for (int round(0); round != 3; ++round) {
+    for (int i(0); i != 4; ++i)
+      ASSERT_TRUE(ring.Push(std::unique_ptr<int>(new int(round * 4 + i))));
+    std::unique_ptr<int> rejected(new int(-1));
+    EXPECT_FALSE(ring.Push(std::move(rejected)));
+    ASSERT_TRUE(rejected);
+    EXPECT_FALSE(ring.Empty());
+    for (int i(0); i != 4; ++i) {
+      ASSERT_TRUE(ring.Pop(item));
+      EXPECT_EQ(round * 4 + i, *item);
+    }
+    EXPECT_TRUE(ring.Empty());
+    EXPECT_FALSE(ring.Pop(item));
+  }
+}
+
+TEST(SpscRingTest, BEH_ReleasesPoppedItems) {
+  SpscRing<std::shared_ptr<int>> ring(2);
+  std::shared_ptr<int> pushed(std::make_shared<int>(1)), item;
+  ASSERT_TRUE(ring.Push(std::shared_ptr<int>(pushed)));
+  EXPECT_EQ(2, pushed.use_count());
+  ASSERT_TRUE(ring.Pop(item));
+  item.reset();
+  EXPECT_EQ(1, pushed.use_count());
+}
+
+TEST(SpscRingTest, BEH_ConcurrentProducerAndConsumer) {
+  const int kItemCount(100000);
+  SpscRing<int> ring(64);
+  std::thread producer([&] {
+    for (int i(0); i != kItemCount;) {
+      int item(i);
+      if (ring.Push(std::move(item)))
+        ++i;
+      else
+        std::this_thread::yield();
+    }
+  });
+
+  int expected(0), item(0);
+  while (expected != kItemCount) {
+    if (ring.Pop(item))
+      ASSERT_EQ(expected++, item);
+    else
+      std::this_thread::yield();
+  }
+  producer.join();
+  EXPECT_TRUE(ring.Empty());
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
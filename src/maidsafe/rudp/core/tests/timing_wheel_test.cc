@@ -0,0 +1,182 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <memory>
+#include <vector>
+
+#include "boost/asio/error.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/tick_timer.h"
+#include "maidsafe/rudp/core/timing_wheel.h"
+
+namespace asio = boost::asio;
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+struct Completion {
+  Completion() : called(false), ec(), time() {}
+  bool called;
+  boost::system::error_code ec;
+  bptime::ptime time;
+};
+
+std::function<void(const boost::system::error_code&)> Record(Completion& completion) {
+  return [&completion](const boost::system::error_code& ec) {
+    completion.called = true;
+    completion.ec = ec;
+    completion.time = TickTimer::Now();
+  };
+}
+
+}  // unnamed namespace
+
+class TimingWheelTest : public testing::Test {
+ protected:
+  static void SetCurrentTick(TimingWheel& timing_wheel, uint64_t tick) {
+    timing_wheel.current_tick_ = tick;
+  }
+  static bptime::ptime Epoch(const TimingWheel& timing_wheel) { return timing_wheel.epoch_; }
+  static bptime::ptime ArmedExpiry(TimingWheel& timing_wheel) {
+    return timing_wheel.timer_.expires_at();
+  }
+};
+
+TEST_F(TimingWheelTest, BEH_FiresAtExpiry) {
+  asio::io_service asio_service;
+  TimingWheel timing_wheel(asio_service);
+  TickTimer near_timer(timing_wheel), far_timer(timing_wheel);
+  Completion near_completion, far_completion;
+
+  // The far timer is beyond the first level of the wheel and so must be cascaded down.
+  bptime::ptime start(TickTimer::Now());
+  near_timer.TickAt(start + bptime::milliseconds(20));
+  far_timer.TickAt(start + bptime::milliseconds(300));
+  EXPECT_FALSE(near_timer.Expired());
+  near_timer.AsyncWait(Record(near_completion));
+  far_timer.AsyncWait(Record(far_completion));
+  asio_service.run();
+
+  ASSERT_TRUE(near_completion.called);
+  ASSERT_TRUE(far_completion.called);
+  EXPECT_FALSE(near_completion.ec);
+  EXPECT_FALSE(far_completion.ec);
+  EXPECT_GE(near_completion.time, start + bptime::milliseconds(20));
+  EXPECT_GE(far_completion.time, start + bptime::milliseconds(300));
+  EXPECT_LT(near_completion.time, far_completion.time);
+  EXPECT_TRUE(near_timer.Expired());
+  EXPECT_TRUE(far_timer.Expired());
+}
+
+TEST_F(TimingWheelTest, BEH_MoveExpiryWhileWaiting) {
+  asio::io_service asio_service;
+  TimingWheel timing_wheel(asio_service);
+  TickTimer timer(timing_wheel);
+  Completion completion;
+
+  // Bringing the expiry forward completes the outstanding wait at the new time, while attempts to
+  // move it further away are ignored.
+  bptime::ptime start(TickTimer::Now());
+  timer.TickAt(start + bptime::seconds(10));
+  timer.AsyncWait(Record(completion));
+  timer.TickAt(start + bptime::milliseconds(30));
+  timer.TickAfter(bptime::seconds(20));
+  asio_service.run();
+
+  ASSERT_TRUE(completion.called);
+  EXPECT_FALSE(completion.ec);
+  EXPECT_GE(completion.time, start + bptime::milliseconds(30));
+  EXPECT_LT(completion.time, start + bptime::seconds(10));
+
+  // A timer with no expiry only completes once one is set.
+  Completion reset_completion;
+  timer.Reset();
+  timer.AsyncWait(Record(reset_completion));
+  asio_service.reset();
+  asio_service.poll();
+  EXPECT_FALSE(reset_completion.called);
+  timer.TickAfter(bptime::milliseconds(10));
+  asio_service.reset();
+  asio_service.run();
+  ASSERT_TRUE(reset_completion.called);
+  EXPECT_FALSE(reset_completion.ec);
+}
+
+TEST_F(TimingWheelTest, BEH_Cancel) {
+  asio::io_service asio_service;
+  TimingWheel timing_wheel(asio_service);
+  Completion completion, destroyed_completion;
+  TickTimer timer(timing_wheel);
+  std::unique_ptr<TickTimer> destroyed_timer(new TickTimer(timing_wheel));
+
+  timer.TickAfter(bptime::seconds(10));
+  timer.AsyncWait(Record(completion));
+  destroyed_timer->TickAfter(bptime::seconds(10));
+  destroyed_timer->AsyncWait(Record(destroyed_completion));
+  timer.Cancel();
+  destroyed_timer.reset();
+  bptime::ptime start(TickTimer::Now());
+  asio_service.run();
+
+  ASSERT_TRUE(completion.called);
+  ASSERT_TRUE(destroyed_completion.called);
+  EXPECT_EQ(asio::error::operation_aborted, completion.ec);
+  EXPECT_EQ(asio::error::operation_aborted, destroyed_completion.ec);
+  EXPECT_LT(completion.time, start + bptime::seconds(1));
+}
+
+TEST_F(TimingWheelTest, BEH_ArmBeyondIntTicks) {
+  asio::io_service asio_service;
+  TimingWheel timing_wheel(asio_service);
+  TickTimer timer(timing_wheel);
+  Completion completion;
+
+  // A wheel which has run for more than 2^31 ticks must still arm its timer after the epoch.
+  const uint64_t current_tick((uint64_t(1) << 31) + 5);
+  SetCurrentTick(timing_wheel, current_tick);
+  timer.TickAfter(bptime::milliseconds(10));
+  timer.AsyncWait(Record(completion));
+  // The timer falls due at the next tick, 2^31 + 6 ms after the epoch.
+  EXPECT_EQ(Epoch(timing_wheel) + bptime::seconds(2147483) + bptime::milliseconds(654),
+            ArmedExpiry(timing_wheel));
+  // An expiry wrapped to before the epoch would fire at once and re-arm in a busy loop.
+  asio_service.poll_one();
+  EXPECT_FALSE(completion.called);
+  timer.Cancel();
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -21,7 +21,16 @@
 #ifndef MAIDSAFE_RUDP_CORE_TICK_TIMER_H_
 #define MAIDSAFE_RUDP_CORE_TICK_TIMER_H_
 
+#include <cstdint>
+#include <functional>
+
 #include "boost/asio/deadline_timer.hpp"
+#include "boost/asio/handler_alloc_hook.hpp"
+#include "boost/asio/handler_invoke_hook.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/system/error_code.hpp"
+
+#include "maidsafe/rudp/core/timing_wheel.h"
 
 namespace maidsafe {
 
@@ -29,39 +38,102 @@ namespace rudp {
 
 namespace detail {
 
-// Lightweight wrapper around a deadline_timer that avoids modifying the expiry time if it would
-// move it further away.
+// A timer held in a Multiplexer's shared TimingWheel which avoids modifying the expiry time if it
+// would move it further away.  Unlike a deadline_timer, moving the expiry does not cancel an
+// outstanding wait; the wait simply completes at the new time.
 class TickTimer {
  public:
-  explicit TickTimer(boost::asio::io_service& asio_service) : timer_(asio_service) { Reset(); }
+  explicit TickTimer(TimingWheel& timing_wheel)
+      : timing_wheel_(timing_wheel),
+        expiry_(boost::posix_time::pos_infin),
+        waiter_(),
+        previous_(nullptr),
+        next_(nullptr),
+        level_(-1),
+        slot_(0),
+        tick_(0) {}
+
+  ~TickTimer() { timing_wheel_.Cancel(*this); }
 
   static boost::posix_time::ptime Now() { return boost::asio::deadline_timer::traits_type::now(); }
 
-  void Cancel() { timer_.cancel(); }
+  // Completes any outstanding wait with operation_aborted.
+  void Cancel() { timing_wheel_.Cancel(*this); }
 
-  void Reset() { timer_.expires_at(boost::posix_time::pos_infin); }
+  void Reset() { timing_wheel_.SetExpiry(*this, boost::posix_time::pos_infin); }
 
   bool Expired() const {
     // Infinite time out will be counted as expired
-    if (timer_.expires_at() == boost::posix_time::pos_infin)
+    if (expiry_ == boost::posix_time::pos_infin)
       return true;
-    return Now() >= timer_.expires_at();
+    return Now() >= expiry_;
   }
 
   void TickAt(const boost::posix_time::ptime& time) {
-    if (time < timer_.expires_at())
-      timer_.expires_at(time);
+    if (time < expiry_)
+      timing_wheel_.SetExpiry(*this, time);
   }
 
   void TickAfter(const boost::posix_time::time_duration& duration) { TickAt(Now() + duration); }
 
+  // Only one wait may be outstanding at a time.
   template <typename WaitHandler>
   void AsyncWait(WaitHandler handler) {
-    timer_.async_wait(handler);
+    boost::asio::io_service& asio_service(timing_wheel_.AsioService());
+    timing_wheel_.Wait(*this, [&asio_service, handler](const boost::system::error_code& ec) {
+      asio_service.post(WaitBinder<WaitHandler>(handler, ec));
+    });
   }
 
  private:
-  boost::asio::deadline_timer timer_;
+  friend class TimingWheel;
+
+  // Disallow copying and assignment.
+  TickTimer(const TickTimer&);
+  TickTimer& operator=(const TickTimer&);
+
+  // Binds the result to a wait handler while forwarding the handler's allocation and invocation
+  // hooks, so that e.g. a strand-wrapped handler is still run on its strand.
+  template <typename WaitHandler>
+  class WaitBinder {
+   public:
+    WaitBinder(const WaitHandler& handler, const boost::system::error_code& ec)
+        : handler_(handler), ec_(ec) {}
+
+    void operator()() { handler_(ec_); }
+
+    friend void* asio_handler_allocate(size_t n, WaitBinder* binder) {
+      using boost::asio::asio_handler_allocate;
+      return asio_handler_allocate(n, &binder->handler_);
+    }
+
+    friend void asio_handler_deallocate(void* p, size_t n, WaitBinder* binder) {
+      using boost::asio::asio_handler_deallocate;
+      asio_handler_deallocate(p, n, &binder->handler_);
+    }
+
+    template <typename Function>
+    friend void asio_handler_invoke(Function f, WaitBinder* binder) {
+      using boost::asio::asio_handler_invoke;
+      asio_handler_invoke(f, &binder->handler_);
+    }
+
+   private:
+    WaitHandler handler_;
+    boost::system::error_code ec_;
+  };
+
+  TimingWheel& timing_wheel_;
+  // Only modified by the TickTimer's owner, under the wheel's mutex.
+  boost::posix_time::ptime expiry_;
+
+  // The remaining members are guarded by the wheel's mutex.
+  TimingWheel::Waiter waiter_;
+  TickTimer* previous_;
+  TickTimer* next_;
+  int level_;
+  size_t slot_;
+  uint64_t tick_;
 };
 
 }  // namespace detail
@@ -0,0 +1,293 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/timing_wheel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#include "boost/asio/error.hpp"
+
+#include "maidsafe/rudp/core/tick_timer.h"
+
+namespace bptime = boost::posix_time;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+// Index of the lowest set bit of a non-zero word.
+size_t LowestSetBit(uint64_t bits) {
+  assert(bits != 0);
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanForward64(&index, bits);
+  return index;
+#elif defined(__GNUC__)
+  return static_cast<size_t>(__builtin_ctzll(bits));
+#else
+  size_t index = 0;
+  while ((bits & 1) == 0)
+    bits >>= 1, ++index;
+  return index;
+#endif
+}
+
+}  // unnamed namespace
+
+TimingWheel::TimingWheel(boost::asio::io_service& asio_service)
+    : asio_service_(asio_service),
+      timer_(asio_service),
+      epoch_(TickTimer::Now()),
+      current_tick_(0),
+      armed_tick_(0),
+      slots_(),
+      level_sizes_(),
+      first_level_occupied_(),
+      size_(0),
+      mutex_() {
+  level_sizes_.fill(0);
+  first_level_occupied_.fill(0);
+}
+
+TimingWheel::~TimingWheel() {
+  // All TickTimers must have been destroyed first.
+  assert(size_ == 0);
+}
+
+void TimingWheel::SetExpiry(TickTimer& timer, const bptime::ptime& expiry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  timer.expiry_ = expiry;
+  if (!timer.waiter_)
+    return;
+  if (timer.level_ >= 0)
+    Unlink(timer);
+  if (expiry.is_pos_infinity())
+    return;
+  timer.tick_ = std::max(ToTick(expiry, true), current_tick_ + 1);
+  Link(timer);
+  Arm();
+}
+
+void TimingWheel::Wait(TickTimer& timer, Waiter waiter) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  assert(!timer.waiter_);
+  if (!timer.expiry_.is_pos_infinity() && timer.expiry_ <= TickTimer::Now()) {
+    lock.unlock();
+    return waiter(boost::system::error_code());
+  }
+  timer.waiter_ = std::move(waiter);
+  if (timer.expiry_.is_pos_infinity())
+    return;
+  timer.tick_ = std::max(ToTick(timer.expiry_, true), current_tick_ + 1);
+  Link(timer);
+  Arm();
+}
+
+void TimingWheel::Cancel(TickTimer& timer) {
+  Waiter waiter;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (timer.level_ >= 0)
+      Unlink(timer);
+    waiter.swap(timer.waiter_);
+  }
+  if (waiter)
+    waiter(boost::asio::error::operation_aborted);
+}
+
+uint64_t TimingWheel::ToTick(const bptime::ptime& time, bool round_up) const {
+  if (time <= epoch_)
+    return 0;
+  uint64_t microseconds = (time - epoch_).total_microseconds();
+  uint64_t resolution = Resolution().total_microseconds();
+  return (microseconds + (round_up ? resolution - 1 : 0)) / resolution;
+}
+
+bptime::ptime TimingWheel::FromTick(uint64_t tick) const {
+  // Kept in 64 bits throughout, since a wheel running for a few weeks passes 2^31 ticks.
+  return epoch_ +
+         bptime::microseconds(static_cast<int64_t>(tick) * Resolution().total_microseconds());
+}
+
+void TimingWheel::Link(TickTimer& timer) {
+  assert(timer.level_ < 0 && timer.tick_ >= current_tick_);
+  uint64_t delta = timer.tick_ - current_tick_;
+  int level = 0;
+  unsigned shift = kFirstLevelBits;
+  uint64_t mask = (1 << kFirstLevelBits) - 1;
+  if (delta >> kFirstLevelBits) {
+    // Find the first level whose span covers the delay, parking the timer in the last level if it
+    // is out of range.
+    level = 1;
+    while (level < kLevelCount - 1 && (delta >> (shift + kLevelBits)))
+      ++level, shift += kLevelBits;
+    mask = (1 << kLevelBits) - 1;
+  }
+  uint64_t tick = timer.tick_;
+  if (delta >> (shift + kLevelBits) && level == kLevelCount - 1)
+    tick = current_tick_ + (uint64_t(1) << (shift + kLevelBits)) - 1;
+  size_t slot = level == 0 ? static_cast<size_t>(tick & mask)
+                           : static_cast<size_t>((tick >> shift) & mask);
+
+  timer.level_ = level;
+  timer.slot_ = slot;
+  timer.previous_ = nullptr;
+  timer.next_ = slots_[level][slot].head;
+  if (timer.next_)
+    timer.next_->previous_ = &timer;
+  slots_[level][slot].head = &timer;
+  if (level == 0)
+    first_level_occupied_[slot / 64] |= uint64_t(1) << (slot % 64);
+  ++level_sizes_[level];
+  ++size_;
+}
+
+void TimingWheel::Unlink(TickTimer& timer) {
+  assert(timer.level_ >= 0);
+  if (timer.previous_)
+    timer.previous_->next_ = timer.next_;
+  else
+    slots_[timer.level_][timer.slot_].head = timer.next_;
+  if (timer.next_)
+    timer.next_->previous_ = timer.previous_;
+  if (timer.level_ == 0 && !slots_[0][timer.slot_].head)
+    first_level_occupied_[timer.slot_ / 64] &= ~(uint64_t(1) << (timer.slot_ % 64));
+  --level_sizes_[timer.level_];
+  --size_;
+  timer.level_ = -1;
+  timer.previous_ = timer.next_ = nullptr;
+}
+
+void TimingWheel::Cascade(int level, size_t slot) {
+  // Link pushes onto the head of a slot, so a timer parked out of range which is relinked into this
+  // same slot lands ahead of next and isn't visited twice.
+  TickTimer* timer = slots_[level][slot].head;
+  while (timer) {
+    TickTimer* next = timer->next_;
+    Unlink(*timer);
+    Link(*timer);
+    timer = next;
+  }
+}
+
+void TimingWheel::Advance(uint64_t now_tick, std::vector<Waiter>& due) {
+  const uint64_t first_level_mask = (1 << kFirstLevelBits) - 1;
+  while (current_tick_ < now_tick) {
+    if (level_sizes_[0] == 0) {
+      // Nothing can fall due before the next turn of the first level, so skip straight to it.
+      uint64_t next_turn = (current_tick_ | first_level_mask) + 1;
+      if (size_ == 0 || next_turn > now_tick) {
+        current_tick_ = now_tick;
+        break;
+      }
+      current_tick_ = next_turn - 1;
+    }
+    ++current_tick_;
+
+    if ((current_tick_ & first_level_mask) == 0) {
+      // Cascade the highest level first, as its timers may land in the slot of the level below
+      // which is about to be cascaded.
+      int top = 1;
+      unsigned shift = kFirstLevelBits;
+      while (top < kLevelCount - 1 &&
+             ((current_tick_ >> shift) & ((1 << kLevelBits) - 1)) == 0) {
+        ++top, shift += kLevelBits;
+      }
+      for (int level = top; level >= 1; --level, shift -= kLevelBits)
+        Cascade(level, static_cast<size_t>((current_tick_ >> shift) & ((1 << kLevelBits) - 1)));
+    }
+
+    Slot& slot(slots_[0][current_tick_ & first_level_mask]);
+    while (slot.head) {
+      TickTimer& timer(*slot.head);
+      assert(timer.tick_ == current_tick_);
+      Unlink(timer);
+      due.push_back(Waiter());
+      due.back().swap(timer.waiter_);
+    }
+  }
+}
+
+uint64_t TimingWheel::NextTick() const {
+  if (size_ == 0)
+    return 0;
+  const uint64_t first_level_mask = (1 << kFirstLevelBits) - 1;
+  uint64_t next_turn = (current_tick_ | first_level_mask) + 1;
+  if (level_sizes_[0] == 0)
+    return next_turn;
+  // Search the bitmap from the slot after current_tick_, wrapping round to the start of the level.
+  size_t start = static_cast<size_t>((current_tick_ + 1) & first_level_mask);
+  size_t slot = NextOccupiedSlot(start);
+  if (slot == kFirstLevelSlots)
+    slot = NextOccupiedSlot(0);
+  assert(slot != kFirstLevelSlots);
+  uint64_t tick = current_tick_ + 1 + ((slot - start) & first_level_mask);
+  return (size_ != level_sizes_[0] && next_turn < tick) ? next_turn : tick;
+}
+
+size_t TimingWheel::NextOccupiedSlot(size_t from) const {
+  size_t word = from / 64;
+  uint64_t bits = first_level_occupied_[word] & (~uint64_t(0) << (from % 64));
+  while (bits == 0) {
+    if (++word == first_level_occupied_.size())
+      return kFirstLevelSlots;
+    bits = first_level_occupied_[word];
+  }
+  return word * 64 + LowestSetBit(bits);
+}
+
+void TimingWheel::Arm() {
+  uint64_t next_tick = NextTick();
+  if (next_tick == 0 || (armed_tick_ != 0 && armed_tick_ <= next_tick))
+    return;
+  armed_tick_ = next_tick;
+  timer_.expires_at(FromTick(next_tick));
+  timer_.async_wait([this](const boost::system::error_code& ec) { HandleTimer(ec); });
+}
+
+void TimingWheel::HandleTimer(const boost::system::error_code& ec) {
+  // Aborted waits have been superseded by an earlier one, or the wheel is being destroyed.
+  if (ec == boost::asio::error::operation_aborted)
+    return;
+
+  std::vector<Waiter> due;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    armed_tick_ = 0;
+    Advance(ToTick(TickTimer::Now(), false), due);
+    Arm();
+  }
+  for (auto& waiter : due)
+    waiter(boost::system::error_code());
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,129 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_TIMING_WHEEL_H_
+#define MAIDSAFE_RUDP_CORE_TIMING_WHEEL_H_
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "boost/asio/deadline_timer.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/system/error_code.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+class TimingWheelTest;
+}
+
+class TickTimer;
+
+// A hierarchical timing wheel shared by all the TickTimers of one Multiplexer.  Waiting timers are
+// held in intrusive lists, one per slot, so arming, re-arming and cancelling a timer is O(1).  A
+// single deadline_timer wakes the wheel when its earliest occupied slot falls due; a bitmap of the
+// occupied first-level slots finds that slot without walking the level.
+//
+// The first level has 256 slots of kResolution each.  Each of the three further levels has 64
+// slots, each spanning one full turn of the level below it, and its timers are cascaded down as the
+// level below completes a turn.  Timers further out than the last level are parked in it and
+// cascaded again until they fall within range.
+class TimingWheel {
+ public:
+  typedef std::function<void(const boost::system::error_code&)> Waiter;
+
+  explicit TimingWheel(boost::asio::io_service& asio_service);
+  ~TimingWheel();
+
+  // The granularity at which timers fire.
+  static boost::posix_time::time_duration Resolution() {
+    return boost::posix_time::milliseconds(1);
+  }
+
+  boost::asio::io_service& AsioService() { return asio_service_; }
+
+  // Called by TickTimer.  These lock the wheel, so may be called from any thread.
+  void SetExpiry(TickTimer& timer, const boost::posix_time::ptime& expiry);
+  void Wait(TickTimer& timer, Waiter waiter);
+  void Cancel(TickTimer& timer);
+
+  friend class test::TimingWheelTest;
+
+ private:
+  TimingWheel(const TimingWheel&);
+  TimingWheel& operator=(const TimingWheel&);
+
+  enum {
+    kLevelCount = 4,
+    kFirstLevelBits = 8,
+    kLevelBits = 6,
+    kFirstLevelSlots = 1 << kFirstLevelBits
+  };
+
+  struct Slot {
+    Slot() : head(nullptr) {}
+    TickTimer* head;
+  };
+
+  // Number of whole ticks from epoch_ to time, rounded up or down.
+  uint64_t ToTick(const boost::posix_time::ptime& time, bool round_up) const;
+  // The time at which tick starts.
+  boost::posix_time::ptime FromTick(uint64_t tick) const;
+  // Place a waiting timer in the slot for its tick_, which must not be before current_tick_.
+  void Link(TickTimer& timer);
+  void Unlink(TickTimer& timer);
+  // Move the timers in one slot of the given level down to the levels below.
+  void Cascade(int level, size_t slot);
+  // The first occupied first-level slot at or after from, or kFirstLevelSlots if there is none.
+  size_t NextOccupiedSlot(size_t from) const;
+  // Process all ticks up to and including now_tick, collecting the waiters of expired timers.
+  void Advance(uint64_t now_tick, std::vector<Waiter>& due);
+  // The next tick at which the wheel needs to be processed, or 0 if it is empty.
+  uint64_t NextTick() const;
+  // Ensure timer_ is armed no later than NextTick().
+  void Arm();
+  void HandleTimer(const boost::system::error_code& ec);
+
+  boost::asio::io_service& asio_service_;
+  boost::asio::deadline_timer timer_;
+  const boost::posix_time::ptime epoch_;
+  uint64_t current_tick_;
+  // The tick for which timer_ is armed, or 0 if it is not armed.
+  uint64_t armed_tick_;
+  std::array<std::array<Slot, 1 << kFirstLevelBits>, kLevelCount> slots_;
+  std::array<size_t, kLevelCount> level_sizes_;
+  // One bit per first-level slot, set while the slot holds any timers.
+  std::array<uint64_t, kFirstLevelSlots / 64> first_level_occupied_;
+  size_t size_;
+  std::mutex mutex_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_TIMING_WHEEL_H_
@@ -27,6 +27,7 @@
 #include "maidsafe/common/utils.h"
 
 #include "maidsafe/rudp/return_codes.h"
+#include "maidsafe/rudp/core/handler_allocator.h"
 #include "maidsafe/rudp/transport.h"
 #include "maidsafe/rudp/connection.h"
 #include "maidsafe/rudp/utils.h"
@@ -39,6 +40,7 @@ namespace maidsafe {
 namespace rudp {
 
 typedef ManagedConnections::Endpoint Endpoint;
+typedef detail::HashedNodeId HashedNodeId;
 
 // 203.0.113.14:1314
 const Endpoint kNonRoutable(boost::asio::ip::address_v4(3405803790U), 1314);
@@ -92,15 +94,18 @@ ManagedConnections::PendingConnection::PendingConnection(NodeId node_id_in, Tran
       connecting(false) {}
 
 ManagedConnections::ManagedConnections()
-    : asio_service_(Parameters::thread_count),
+    : message_allocator_(new detail::HandlerAllocator()),
+      asio_service_(std::max(Parameters::thread_count, Parameters::shard_count)),
       callback_mutex_(),
       message_received_functor_(),
       connection_lost_functor_(),
+      stream_chunk_received_functor_(),
       this_node_id_(),
       chosen_bootstrap_node_id_(),
       private_key_(),
       public_key_(),
       connections_(),
+      published_connections_(std::make_shared<const ConnectionMap>()),
       pendings_(),
       idle_transports_(),
       mutex_(),
@@ -113,6 +118,7 @@ ManagedConnections::~ManagedConnections() {
     for (auto connection_details : connections_)
       connection_details.second->Close();
     connections_.clear();
+    PublishConnections();
     for (auto& pending : pendings_)
       pending->pending_transport->Close();
     pendings_.clear();
@@ -167,14 +173,16 @@ int ManagedConnections::Bootstrap(const std::vector<Endpoint>& bootstrap_endpoin
 void ManagedConnections::ClearConnectionsAndIdleTransports() {
   std::lock_guard<std::mutex> lock(mutex_);
   if (!connections_.empty()) {
-    for (auto connection_details : connections_) {
-      auto connection_ptr(connection_details.second->GetConnection(connection_details.first));
+    for (const auto& connection_details : connections_) {
+      auto connection_ptr(
+          connection_details.second->GetConnection(connection_details.first.node_id()));
       if (connection_ptr) {
         assert(connection_ptr->state() == detail::Connection::State::kBootstrapping);
         connection_details.second->Close();
       }
     }
     connections_.clear();
+    PublishConnections();
   }
   pendings_.clear();
   for (auto idle_transport : idle_transports_)
@@ -267,6 +275,8 @@ ReturnCode ManagedConnections::StartNewTransport(NodeIdEndpointPairs bootstrap_p
     return setter.set_value(kSuccess);
   };
 
+  transport->SetOnStreamChunk(
+      std::bind(&ManagedConnections::OnStreamChunkSlot, this, args::_1, args::_2, args::_3));
   transport->Bootstrap(
       bootstrap_peers, this_node_id_, public_key_, local_endpoint,
       bootstrap_off_existing_connection,
@@ -305,8 +315,9 @@ void ManagedConnections::GetBootstrapEndpoints(NodeIdEndpointPairs& bootstrap_pe
   secondary_peers.reserve(Parameters::max_transports * detail::Transport::kMaxConnections());
   std::set<Endpoint> non_duplicates;
   std::lock_guard<std::mutex> lock(mutex_);
-  for (auto element : connections_) {
-    std::shared_ptr<detail::Connection> connection(element.second->GetConnection(element.first));
+  for (const auto& element : connections_) {
+    std::shared_ptr<detail::Connection> connection(
+        element.second->GetConnection(element.first.node_id()));
     if (!connection)
       continue;
     if (!non_duplicates.insert(connection->Socket().PeerEndpoint()).second)
@@ -318,7 +329,7 @@ void ManagedConnections::GetBootstrapEndpoints(NodeIdEndpointPairs& bootstrap_pe
     } else {
       bootstrap_peers.push_back(peer);
       Endpoint this_endpoint_as_seen_by_peer(
-          element.second->ThisEndpointAsSeenByPeer(element.first));
+          element.second->ThisEndpointAsSeenByPeer(element.first.node_id()));
       if (this_external_address.is_unspecified())
         this_external_address = this_endpoint_as_seen_by_peer.address();
       else if (this_external_address != this_endpoint_as_seen_by_peer.address())
@@ -410,7 +421,7 @@ bool ManagedConnections::ExistingConnectionAttempt(const NodeId& peer_id,
 
 bool ManagedConnections::ExistingConnection(const NodeId& peer_id, EndpointPair& this_endpoint_pair,
                                             int& return_code) {
-  auto itr(connections_.find(peer_id));
+  auto itr(connections_.find(HashedNodeId(peer_id, HashedNodeId::kReference)));
   if (itr == connections_.end())
     return false;
 
@@ -419,7 +430,8 @@ bool ManagedConnections::ExistingConnection(const NodeId& peer_id, EndpointPair&
   if (!connection) {
     LOG(kError) << "Internal ManagedConnections error: mismatch between connections_ and "
                 << "actual connections.";
-    connections_.erase(peer_id);
+    connections_.erase(HashedNodeId(peer_id, HashedNodeId::kReference));
+    PublishConnections();
     return false;
   }
 
@@ -546,6 +558,13 @@ std::vector<std::unique_ptr<ManagedConnections::PendingConnection>>::iterator
 
 int ManagedConnections::Add(NodeId peer_id, EndpointPair peer_endpoint_pair,
                             std::string validation_data) {
+  return Add(std::move(peer_id), std::move(peer_endpoint_pair), std::move(validation_data),
+             Parameters::congestion_control_algorithm);
+}
+
+int ManagedConnections::Add(NodeId peer_id, EndpointPair peer_endpoint_pair,
+                            std::string validation_data,
+                            Parameters::CongestionControlAlgorithm algorithm) {
   if (peer_id == this_node_id_) {
     LOG(kError) << "Can't use this node's ID (" << DebugId(this_node_id_) << ") as peerID.";
     return kOwnId;
@@ -555,7 +574,7 @@ int ManagedConnections::Add(NodeId peer_id, EndpointPair peer_endpoint_pair,
 
   auto itr(FindPendingTransportWithNodeId(peer_id));
   if (itr == pendings_.end()) {
-    if (connections_.find(peer_id) != connections_.end()) {
+    if (connections_.find(HashedNodeId(peer_id, HashedNodeId::kReference)) != connections_.end()) {
       LOG(kWarning) << "A managed connection from " << DebugId(this_node_id_) << " to "
                     << DebugId(peer_id) << " already exists, and this node's chosen BootstrapID is "
                     << DebugId(chosen_bootstrap_node_id_);
@@ -591,12 +610,15 @@ int ManagedConnections::Add(NodeId peer_id, EndpointPair peer_endpoint_pair,
     if (connection->state() == detail::Connection::State::kBootstrapping ||
         (chosen_bootstrap_node_id_ == peer_id &&
          connection->state() == detail::Connection::State::kPermanent)) {
-      connection->StartSending(validation_data, [](int result) {
-        if (result != kSuccess) {
-          LOG(kWarning) << "Failed to send validation data on bootstrap "
-                        << "connection.  Result: " << result;
-        }
-      });
+      connection->SetCongestionControlAlgorithm(algorithm);
+      connection->StartSending(
+          detail::SharedBuffer(validation_data), Parameters::kHighPriority,
+          Parameters::in_order_delivery, [](int result) {
+            if (result != kSuccess) {
+              LOG(kWarning) << "Failed to send validation data on bootstrap "
+                            << "connection.  Result: " << result;
+            }
+          });
       if (connection->state() == detail::Connection::State::kBootstrapping) {
         Endpoint peer_endpoint;
         selected_transport->MakeConnectionPermanent(peer_id, false, peer_endpoint);
@@ -613,7 +635,7 @@ int ManagedConnections::Add(NodeId peer_id, EndpointPair peer_endpoint_pair,
     }
   }
 
-  selected_transport->Connect(peer_id, peer_endpoint_pair, validation_data);
+  selected_transport->Connect(peer_id, peer_endpoint_pair, validation_data, algorithm);
   return kSuccess;
 }
 
@@ -624,7 +646,7 @@ int ManagedConnections::MarkConnectionAsValid(NodeId peer_id, Endpoint& peer_end
   }
 
   std::lock_guard<std::mutex> lock(mutex_);
-  auto itr(connections_.find(peer_id));
+  auto itr(connections_.find(HashedNodeId(peer_id, HashedNodeId::kReference)));
   if (itr != connections_.end()) {
     if ((*itr).second->MakeConnectionPermanent(peer_id, true, peer_endpoint))
       return kSuccess;
@@ -643,7 +665,7 @@ void ManagedConnections::Remove(NodeId peer_id) {
       LOG(kError) << "Can't use this node's ID (" << DebugId(this_node_id_) << ") as peerID.";
       return;
     }
-    auto itr(connections_.find(peer_id));
+    auto itr(connections_.find(HashedNodeId(peer_id, HashedNodeId::kReference)));
     if (itr == connections_.end()) {
       LOG(kWarning) << "Can't remove connection from " << DebugId(this_node_id_) << " to "
                     << DebugId(peer_id) << " - not in map.";
@@ -657,19 +679,38 @@ void ManagedConnections::Remove(NodeId peer_id) {
 
 void ManagedConnections::Send(NodeId peer_id, std::string message,
                               MessageSentFunctor message_sent_functor) {
+  Send(std::move(peer_id), std::move(message), Parameters::kNormalPriority,
+       std::move(message_sent_functor));
+}
+
+void ManagedConnections::Send(NodeId peer_id, std::string message,
+                              Parameters::MessagePriority priority,
+                              MessageSentFunctor message_sent_functor) {
+  Send(std::move(peer_id), std::move(message), priority, Parameters::in_order_delivery,
+       std::move(message_sent_functor));
+}
+
+void ManagedConnections::Send(NodeId peer_id, std::string message,
+                              Parameters::MessagePriority priority, bool in_order,
+                              MessageSentFunctor message_sent_functor) {
   if (peer_id == this_node_id_) {
     LOG(kError) << "Can't use this node's ID (" << DebugId(this_node_id_) << ") as peerID.";
     return;
   }
 
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto itr(connections_.find(peer_id));
-  if (itr != connections_.end()) {
-    if ((*itr).second->Send(peer_id, message, message_sent_functor))
-      return;
+  {
+    const std::shared_ptr<const ConnectionMap> connections(
+        std::atomic_load(&published_connections_));
+    auto itr(connections->find(HashedNodeId(peer_id, HashedNodeId::kReference)));
+    if (itr != connections->end()) {
+      if ((*itr).second->Send(peer_id, detail::SharedBuffer(std::move(message)), priority,
+                              in_order, message_sent_functor))
+        return;
+    }
   }
   LOG(kError) << "Can't send from " << DebugId(this_node_id_) << " to " << DebugId(peer_id)
               << " - not in map.";
+  std::lock_guard<std::mutex> lock(mutex_);
   if (message_sent_functor) {
     if (!connections_.empty() || !idle_transports_.empty()) {
       asio_service_.service().post([message_sent_functor] {
@@ -683,6 +724,31 @@ void ManagedConnections::Send(NodeId peer_id, std::string message,
   }
 }
 
+void ManagedConnections::SendStream(NodeId peer_id, StreamSourceFunctor source,
+                                    Parameters::MessagePriority priority,
+                                    MessageSentFunctor message_sent_functor) {
+  if (peer_id == this_node_id_) {
+    LOG(kError) << "Can't use this node's ID (" << DebugId(this_node_id_) << ") as peerID.";
+    return;
+  }
+
+  {
+    const std::shared_ptr<const ConnectionMap> connections(
+        std::atomic_load(&published_connections_));
+    auto itr(connections->find(HashedNodeId(peer_id, HashedNodeId::kReference)));
+    if (itr != connections->end() &&
+        (*itr).second->SendStream(peer_id, source, priority, message_sent_functor)) {
+      return;
+    }
+  }
+  LOG(kError) << "Can't stream from " << DebugId(this_node_id_) << " to " << DebugId(peer_id)
+              << " - not in map.";
+  if (message_sent_functor)
+    asio_service_.service().post([message_sent_functor] {
+      message_sent_functor(kInvalidConnection);
+    });
+}
+
 void ManagedConnections::OnMessageSlot(const std::string& message) {
   LOG(kVerbose) << "\n^^^^^^^^^^^^ OnMessageSlot ^^^^^^^^^^^^\n" + DebugString();
 
@@ -695,7 +761,8 @@ void ManagedConnections::OnMessageSlot(const std::string& message) {
     }
 
     if (local_callback) {
-      asio_service_.service().post([=] { local_callback(*copied_message); });
+      asio_service_.service().post(detail::MakeAllocHandler(
+          *message_allocator_, [=] { local_callback(*copied_message); }));
     }
   }
   catch (const std::exception& e) {
@@ -703,6 +770,24 @@ void ManagedConnections::OnMessageSlot(const std::string& message) {
   }
 }
 
+void ManagedConnections::OnStreamChunkSlot(uint64_t stream_id, const std::string& chunk,
+                                           bool last) {
+  StreamChunkReceivedFunctor local_callback;
+  {
+    std::lock_guard<std::mutex> guard(callback_mutex_);
+    local_callback = stream_chunk_received_functor_;
+  }
+  // Run synchronously; the connection hands up the stream's next chunk only once this returns.
+  if (local_callback)
+    local_callback(stream_id, chunk, last);
+}
+
+void ManagedConnections::SetStreamChunkReceivedFunctor(
+    const StreamChunkReceivedFunctor& handler) {
+  std::lock_guard<std::mutex> guard(callback_mutex_);
+  stream_chunk_received_functor_ = handler;
+}
+
 void ManagedConnections::SetConnectionAddedFunctor(const ConnectionAddedFunctor& handler) {
   assert(!connection_added_functor_);
   connection_added_functor_ = handler;
@@ -724,6 +809,7 @@ void ManagedConnections::OnConnectionAddedSlot(const NodeId& peer_id, TransportP
     is_duplicate_normal_connection = !inserted;
 
     if (inserted) {
+      PublishConnections();
       idle_transports_.erase(transport);
     } else {
       UpdateIdleTransports(transport);
@@ -756,6 +842,12 @@ unsigned ManagedConnections::GetActiveConnectionCount() const {
   return static_cast<unsigned>(connections_.size());
 }
 
+void ManagedConnections::PublishConnections() {
+  std::atomic_store(&published_connections_,
+                    std::shared_ptr<const ConnectionMap>(
+                        std::make_shared<ConnectionMap>(connections_)));
+}
+
 void ManagedConnections::UpdateIdleTransports(const TransportPtr& transport) {
   if (transport->IsIdle()) {
     assert(transport->IsAvailable());
@@ -778,7 +870,7 @@ void ManagedConnections::OnConnectionLostSlot(const NodeId& peer_id, TransportPt
   // peer_id should not be in pendings_.
   RemovePending(peer_id);
 
-  auto itr(connections_.find(peer_id));
+  auto itr(connections_.find(HashedNodeId(peer_id, HashedNodeId::kReference)));
   if (itr != connections_.end()) {
     if ((*itr).second != transport) {
       LOG(kError) << "peer_id: " << DebugId(peer_id) << " is connected via "
@@ -787,6 +879,7 @@ void ManagedConnections::OnConnectionLostSlot(const NodeId& peer_id, TransportPt
     }
 
     connections_.erase(itr);
+    PublishConnections();
 
     if (peer_id == chosen_bootstrap_node_id_) {
       chosen_bootstrap_node_id_ = NodeId();
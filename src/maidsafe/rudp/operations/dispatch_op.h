@@ -27,6 +27,7 @@
 #include "boost/asio/handler_invoke_hook.hpp"
 #include "boost/system/error_code.hpp"
 #include "maidsafe/rudp/core/dispatcher.h"
+#include "maidsafe/rudp/core/receive_batch.h"
 
 namespace maidsafe {
 
@@ -34,36 +35,35 @@ namespace rudp {
 
 namespace detail {
 
-// Helper class to perform an asynchronous dispatch operation.
+// Helper class to perform an asynchronous dispatch operation.  The asynchronous receive completes
+// with a single datagram in the batch's first slot; once that has been dispatched the socket is
+// drained a batch at a time until it would block.
 template <typename DispatchHandler>
 class DispatchOp {
  public:
-  DispatchOp(DispatchHandler handler, boost::asio::ip::udp::socket& socket,
-             boost::asio::mutable_buffer buffer, boost::asio::ip::udp::endpoint& sender_endpoint,
+  DispatchOp(DispatchHandler handler, boost::asio::ip::udp::socket& socket, ReceiveBatch& batch,
              Dispatcher& dispatcher)
       : handler_(std::move(handler)),
         socket_(socket),
-        buffer_(std::move(buffer)),
+        batch_(batch),
         mutex_(std::make_shared<std::mutex>()),
-        sender_endpoint_(sender_endpoint),
         dispatcher_(dispatcher) {}
 
   DispatchOp(const DispatchOp& other)
       : handler_(other.handler_),
         socket_(other.socket_),
-        buffer_(other.buffer_),
+        batch_(other.batch_),
         mutex_(other.mutex_),
-        sender_endpoint_(other.sender_endpoint_),
         dispatcher_(other.dispatcher_) {}
 
   void operator()(const boost::system::error_code& ec, size_t bytes_transferred) {
     boost::system::error_code local_ec = ec;
+    if (!local_ec)
+      batch_.AssignFirst(bytes_transferred);
     while (!local_ec) {
       std::lock_guard<std::mutex> lock(*mutex_);
-      dispatcher_.HandleReceiveFrom(boost::asio::buffer(buffer_, bytes_transferred),
-                                    sender_endpoint_);
-      bytes_transferred =
-          socket_.receive_from(boost::asio::buffer(buffer_), sender_endpoint_, 0, local_ec);
+      dispatcher_.HandleReceiveFrom(batch_);
+      batch_.ReceiveFrom(socket_, local_ec);
     }
 
     handler_(ec);
@@ -91,9 +91,8 @@ class DispatchOp {
 
   DispatchHandler handler_;
   boost::asio::ip::udp::socket& socket_;
-  boost::asio::mutable_buffer buffer_;
+  ReceiveBatch& batch_;
   std::shared_ptr<std::mutex> mutex_;
-  boost::asio::ip::udp::endpoint& sender_endpoint_;
   Dispatcher& dispatcher_;
 };
 
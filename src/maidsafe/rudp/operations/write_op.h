@@ -31,18 +31,17 @@ namespace rudp {
 
 namespace detail {
 
-// Helper class to adapt a write handler into a waiting operation.
+// Helper class to bind the result of a write to its handler so that it can be posted.
 template <typename WriteHandler>
 class WriteOp {
  public:
-  WriteOp(WriteHandler handler, const boost::system::error_code& ec,
-          const size_t& bytes_transferred)
+  WriteOp(WriteHandler handler, const boost::system::error_code& ec, size_t bytes_transferred)
       : handler_(std::move(handler)), ec_(ec), bytes_transferred_(bytes_transferred) {}
 
   WriteOp(const WriteOp& other)
       : handler_(other.handler_), ec_(other.ec_), bytes_transferred_(other.bytes_transferred_) {}
 
-  void operator()(boost::system::error_code) { handler_(ec_, bytes_transferred_); }
+  void operator()() { handler_(ec_, bytes_transferred_); }
 
   friend void* asio_handler_allocate(size_t n, WriteOp* op) {
     using boost::asio::asio_handler_allocate;
@@ -65,8 +64,8 @@ class WriteOp {
   WriteOp& operator=(const WriteOp&);
 
   WriteHandler handler_;
-  const boost::system::error_code& ec_;
-  const size_t& bytes_transferred_;
+  boost::system::error_code ec_;
+  size_t bytes_transferred_;
 };
 
 }  // namespace detail
@@ -113,7 +113,7 @@ bool AckPacket::HasSequenceNumbers() const {
   return !sequence_numbers_.empty();
 }
 
-std::vector<std::pair<uint32_t, uint32_t>> AckPacket::GetSequenceRanges() const {
+const std::vector<std::pair<uint32_t, uint32_t>>& AckPacket::GetSequenceRanges() const {
   return sequence_numbers_;
 }
 
@@ -151,8 +151,8 @@ bool AckPacket::Decode(const boost::asio::const_buffer& buffer) {
 
   p += sequence_count * 4;
 
-  if ((buffer_end - p) ==  kOptionalPacketSize) {
-    has_optional_fields_ = true;
+  has_optional_fields_ = ((buffer_end - p) == kOptionalPacketSize);
+  if (has_optional_fields_) {
     DecodeUint32(&round_trip_time_, p);
     DecodeUint32(&round_trip_time_variance_, p + 4);
     DecodeUint32(&available_buffer_size_, p + 8);
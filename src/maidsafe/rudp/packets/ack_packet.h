@@ -63,7 +63,7 @@ class AckPacket : public ControlPacket {
   void ClearSequenceNumbers();
   void AddSequenceNumber(uint32_t n);
   void AddSequenceNumbers(uint32_t first, uint32_t last);
-  std::vector<std::pair<uint32_t, uint32_t>> GetSequenceRanges() const;
+  const std::vector<std::pair<uint32_t, uint32_t>>& GetSequenceRanges() const;
 
   bool ContainsSequenceNumber(uint32_t n) const;
   bool HasSequenceNumbers() const;
@@ -20,8 +20,10 @@
 
 #include "maidsafe/rudp/packets/data_packet.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <utility>
 #include <vector>
 
 #include "maidsafe/common/log.h"
@@ -40,7 +42,11 @@ DataPacket::DataPacket()
       message_number_(0),
       time_stamp_(0),
       destination_socket_id_(0),
-      data_() {}
+      data_(),
+      payload_(),
+      payload_size_(0),
+      segments_(),
+      segment_count_(0) {}
 
 uint32_t DataPacket::PacketSequenceNumber() const { return packet_sequence_number_; }
 
@@ -76,9 +82,83 @@ uint32_t DataPacket::DestinationSocketId() const { return destination_socket_id_
 
 void DataPacket::SetDestinationSocketId(uint32_t n) { destination_socket_id_ = n; }
 
-const std::string& DataPacket::Data() const { return data_; }
+std::string DataPacket::Data() const {
+  if (segment_count_ == 0 && payload_.empty())
+    return data_;
+  std::string data(DataSize(), 0);
+  CopyData(0, reinterpret_cast<unsigned char*>(&data[0]), data.size());
+  return data;
+}
+
+size_t DataPacket::DataSize() const {
+  size_t size(data_.size() + payload_size_);
+  for (size_t i = 0; i != segment_count_; ++i)
+    size += segments_[i].size();
+  return size;
+}
+
+size_t DataPacket::CopyData(size_t offset, unsigned char* out, size_t length) const {
+  if (segment_count_ == 0) {
+    size_t size(DataSize());
+    if (offset >= size)
+      return 0;
+    length = std::min(length, size - offset);
+    std::memcpy(out, UnsegmentedData() + offset, length);
+    return length;
+  }
+  size_t copied(0);
+  for (size_t i = 0; i != segment_count_ && copied != length; ++i) {
+    const SharedBuffer& segment(segments_[i]);
+    if (offset >= segment.size()) {
+      offset -= segment.size();
+      continue;
+    }
+    size_t count(std::min(length - copied, segment.size() - offset));
+    std::memcpy(out + copied, segment.data() + offset, count);
+    copied += count;
+    offset = 0;
+  }
+  return copied;
+}
+
+void DataPacket::SetData(const std::string& data) {
+  ClearData();
+  data_ = data;
+}
+
+void DataPacket::ClearData() {
+  data_.clear();
+  payload_.Reset();
+  payload_size_ = 0;
+  for (size_t i = 0; i != segment_count_; ++i)
+    segments_[i] = SharedBuffer();
+  segment_count_ = 0;
+}
 
-void DataPacket::SetData(const std::string& data) { data_ = data; }
+bool DataPacket::AppendData(const SharedBuffer& segment) {
+  assert(data_.empty() && payload_.empty());
+  if (segment_count_ == segments_.size())
+    return false;
+  segments_[segment_count_++] = segment;
+  return true;
+}
+
+PacketBuffer DataPacket::TakePayloadBuffer() {
+  PacketBuffer buffer(std::move(payload_));
+  payload_.Reset();
+  payload_size_ = 0;
+  return buffer;
+}
+
+void DataPacket::SetPayloadBuffer(PacketBuffer buffer) {
+  ClearData();
+  payload_ = std::move(buffer);
+}
+
+const unsigned char* DataPacket::UnsegmentedData() const {
+  return payload_.empty() ? reinterpret_cast<const unsigned char*>(data_.data())
+                          : payload_.data();
+}
 
 bool DataPacket::IsValid(const boost::asio::const_buffer& buffer) {
   return ((boost::asio::buffer_size(buffer) >= 16) &&
@@ -106,14 +186,29 @@ bool DataPacket::Decode(const boost::asio::const_buffer& buffer) {
   message_number_ = ((message_number_ << 8) | p[7]);
   DecodeUint32(&time_stamp_, p + 8);
   DecodeUint32(&destination_socket_id_, p + 12);
-  data_.assign(p + 16, p + length);
+  if (segment_count_ != 0)
+    ClearData();
+  size_t size(length - kHeaderSize);
+  if (size == 0)
+    payload_.Reset();
+  else if (!payload_.unique() || payload_.capacity() < size)
+    payload_ = PacketBufferPool::AllocateShared(size);
+  if (!payload_.empty()) {
+    std::memcpy(payload_.data(), p + kHeaderSize, size);
+    payload_size_ = size;
+    data_.clear();
+  } else {
+    payload_size_ = 0;
+    data_.assign(p + kHeaderSize, p + length);
+  }
 
   return true;
 }
 
 size_t DataPacket::Encode(std::vector<boost::asio::mutable_buffer>& buffers) const {
   // Refuse to encode if the output buffer is not big enough.
-  if (boost::asio::buffer_size(buffers[0]) < kHeaderSize + data_.size())
+  size_t data_size(DataSize());
+  if (boost::asio::buffer_size(buffers[0]) < kHeaderSize + data_size)
     return 0;
 
   unsigned char* p = boost::asio::buffer_cast<unsigned char*>(buffers[0]);
@@ -136,15 +231,20 @@ size_t DataPacket::Encode(std::vector<boost::asio::mutable_buffer>& buffers) con
   buffers.pop_back();
   buffers.push_back(boost::asio::mutable_buffer(p, kHeaderSize));
   // Actually const safe as buffer is only used for sending
-  buffers.push_back(boost::asio::mutable_buffer(
-    reinterpret_cast<unsigned char *>(const_cast<char *>(data_.data())),
-    data_.size()));
+  if (segment_count_ == 0) {
+    buffers.push_back(boost::asio::mutable_buffer(
+      const_cast<unsigned char *>(UnsegmentedData()), data_size));
+  }
+  for (size_t i = 0; i != segment_count_; ++i) {
+    buffers.push_back(boost::asio::mutable_buffer(
+      const_cast<unsigned char *>(segments_[i].data()), segments_[i].size()));
+  }
 
   // LOG(kVerbose) << "Sending DataPacket to " << DestinationSocketId()
   //               << " pkt seq " << packet_sequence_number_ << " msg no "
   //               << message_number_ << " length "
-  //               << (kHeaderSize + data_.size());
-  return kHeaderSize + data_.size();
+  //               << (kHeaderSize + data_size);
+  return kHeaderSize + data_size;
 }
 
 }  // namespace detail
@@ -21,6 +21,7 @@
 #ifndef MAIDSAFE_RUDP_PACKETS_DATA_PACKET_H_
 #define MAIDSAFE_RUDP_PACKETS_DATA_PACKET_H_
 
+#include <array>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -29,6 +30,8 @@
 #include "boost/system/error_code.hpp"
 
 #include "maidsafe/rudp/packets/packet.h"
+#include "maidsafe/rudp/packets/packet_buffer_pool.h"
+#include "maidsafe/rudp/packets/shared_buffer.h"
 
 namespace maidsafe {
 
@@ -39,7 +42,8 @@ namespace detail {
 class DataPacket : public Packet {
  public:
   enum {
-    kHeaderSize = 16
+    kHeaderSize = 16,
+    kMaxDataSegments = 2
   };
 
   DataPacket();
@@ -65,19 +69,44 @@ class DataPacket : public Packet {
   uint32_t DestinationSocketId() const;
   void SetDestinationSocketId(uint32_t n);
 
-  const std::string& Data() const;
+  // Returns a copy of the payload.
+  std::string Data() const;
+  size_t DataSize() const;
+  // Copies up to length bytes of the payload, starting at offset, to out.  Returns the number of
+  // bytes copied.
+  size_t CopyData(size_t offset, unsigned char* out, size_t length) const;
+
+  // Set the payload to a copy of the given data.
   void SetData(const std::string& data);
 
   template <typename Iterator>
   void SetData(Iterator begin, Iterator end) {
+    ClearData();
     data_.assign(begin, end);
   }
 
+  // Set the payload by reference to up to kMaxDataSegments shared buffers, which are sent as
+  // separate gather buffers.  AppendData returns false if there is no room for another segment.
+  void ClearData();
+  bool AppendData(const SharedBuffer& segment);
+
+  // Takes the pooled buffer holding the payload, leaving the payload empty, so that the buffer can
+  // be handed to another packet to decode into.  Returns an empty handle if there is none.
+  PacketBuffer TakePayloadBuffer();
+  // Clears the payload and gives the packet a pooled buffer for the next Decode to copy into.
+  void SetPayloadBuffer(PacketBuffer buffer);
+
   static bool IsValid(const boost::asio::const_buffer& buffer);
+  // The payload is copied into a buffer from the shared PacketBufferPools, reusing the packet's
+  // current one if it is big enough and nothing else refers to it, or onto the heap if the pools
+  // are exhausted.
   bool Decode(const boost::asio::const_buffer& buffer);
   size_t Encode(std::vector<boost::asio::mutable_buffer>& buffer) const;
 
  private:
+  // The payload when it is not held in segments_.
+  const unsigned char* UnsegmentedData() const;
+
   uint32_t packet_sequence_number_;
   bool first_packet_in_message_;
   bool last_packet_in_message_;
@@ -85,7 +114,12 @@ class DataPacket : public Packet {
   uint32_t message_number_;
   uint32_t time_stamp_;
   uint32_t destination_socket_id_;
+  // The payload when it is neither in segments_ nor in the pooled payload_ buffer.
   std::string data_;
+  PacketBuffer payload_;
+  size_t payload_size_;
+  std::array<SharedBuffer, kMaxDataSegments> segments_;
+  size_t segment_count_;
 };
 
 }  // namespace detail
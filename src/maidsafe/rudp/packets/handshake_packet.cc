@@ -133,6 +133,15 @@ bool HandshakePacket::IsValid(const boost::asio::const_buffer& buffer) {
   return (IsValidBase(buffer, kPacketType) && (boost::asio::buffer_size(buffer) >= kMinPacketSize));
 }
 
+bool HandshakePacket::DecodeConnectionReason(uint32_t* reason,
+                                             const boost::asio::const_buffer& buffer) {
+  if (!IsValid(buffer))
+    return false;
+
+  DecodeUint32(reason, boost::asio::buffer_cast<const unsigned char*>(buffer) + kHeaderSize + 24);
+  return true;
+}
+
 bool HandshakePacket::Decode(const boost::asio::const_buffer& buffer) {
   // Refuse to decode if the input buffer is not valid.
   if (!IsValid(buffer))
@@ -177,6 +186,7 @@ bool HandshakePacket::Decode(const boost::asio::const_buffer& buffer) {
 
   peer_endpoint_ = boost::asio::ip::udp::endpoint(ip_address, port);
 
+  public_key_.reset();
   if (boost::asio::buffer_size(buffer) != kMinPacketSize) {
     asymm::EncodedPublicKey encoded_public_key(std::string(p + 121, p + length));
     try {
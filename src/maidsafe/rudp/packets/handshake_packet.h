@@ -98,6 +98,9 @@ class HandshakePacket : public ControlPacket {
   void SetPublicKey(std::shared_ptr<asymm::PublicKey> public_key);
 
   static bool IsValid(const boost::asio::const_buffer& buffer);
+  // Reads only the connection reason, skipping the node id and public key, so that a handshake can
+  // be routed to its socket cheaply.
+  static bool DecodeConnectionReason(uint32_t* reason, const boost::asio::const_buffer& buffer);
   bool Decode(const boost::asio::const_buffer& buffer);
   size_t Encode(std::vector<boost::asio::mutable_buffer>& buffers) const;
 
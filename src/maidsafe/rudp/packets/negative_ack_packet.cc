@@ -71,6 +71,21 @@ bool NegativeAckPacket::ContainsSequenceNumber(uint32_t n) const {
   return false;
 }
 
+void NegativeAckPacket::GetSequenceRanges(
+    std::vector<std::pair<uint32_t, uint32_t>>& ranges) const {
+  ranges.clear();
+  for (size_t i = 0; i < sequence_numbers_.size(); ++i) {
+    if (((sequence_numbers_[i] & 0x80000000) != 0) && (i + 1 < sequence_numbers_.size())) {
+      ranges.push_back(std::make_pair(sequence_numbers_[i] & 0x7fffffff,
+                                      sequence_numbers_[i + 1] & 0x7fffffff));
+      ++i;
+    } else {
+      uint32_t n = (sequence_numbers_[i] & 0x7fffffff);
+      ranges.push_back(std::make_pair(n, n));
+    }
+  }
+}
+
 bool NegativeAckPacket::HasSequenceNumbers() const { return !sequence_numbers_.empty(); }
 
 bool NegativeAckPacket::Decode(const boost::asio::const_buffer& buffer) {
@@ -21,6 +21,7 @@
 #ifndef MAIDSAFE_RUDP_PACKETS_NEGATIVE_ACK_PACKET_H_
 #define MAIDSAFE_RUDP_PACKETS_NEGATIVE_ACK_PACKET_H_
 
+#include <utility>
 #include <vector>
 
 #include "boost/asio/buffer.hpp"
@@ -46,6 +47,11 @@ class NegativeAckPacket : public ControlPacket {
   bool ContainsSequenceNumber(uint32_t n) const;
   bool HasSequenceNumbers() const;
 
+  // Get the sequence numbers as inclusive ranges, in the order they were added.  A single
+  // sequence number is returned as a range of one.  A range may wrap around past the maximum
+  // sequence number, in which case first > last.
+  void GetSequenceRanges(std::vector<std::pair<uint32_t, uint32_t>>& ranges) const;
+
   static bool IsValid(const boost::asio::const_buffer& buffer);
   bool Decode(const boost::asio::const_buffer& buffer);
   size_t Encode(std::vector<boost::asio::mutable_buffer>& buffers) const;
@@ -20,6 +20,13 @@
 
 #include "maidsafe/rudp/packets/packet.h"
 
+#include "maidsafe/rudp/packets/ack_of_ack_packet.h"
+#include "maidsafe/rudp/packets/ack_packet.h"
+#include "maidsafe/rudp/packets/handshake_packet.h"
+#include "maidsafe/rudp/packets/keepalive_packet.h"
+#include "maidsafe/rudp/packets/negative_ack_packet.h"
+#include "maidsafe/rudp/packets/shutdown_packet.h"
+
 namespace maidsafe {
 
 namespace rudp {
@@ -37,6 +44,35 @@ bool Packet::DecodeDestinationSocketId(uint32_t* id, const boost::asio::const_bu
   return true;
 }
 
+Packet::Kind Packet::DecodeKind(const boost::asio::const_buffer& data) {
+  // Data and control packets share a 16 byte header.
+  if (boost::asio::buffer_size(data) < 16)
+    return Kind::kUnknown;
+
+  const unsigned char* p = boost::asio::buffer_cast<const unsigned char*>(data);
+  if ((p[0] & 0x80) == 0)
+    return Kind::kData;
+
+  uint16_t type = (p[0] & 0x7f);
+  type = ((type << 8) | p[1]);
+  switch (type) {
+    case HandshakePacket::kPacketType:
+      return Kind::kHandshake;
+    case KeepalivePacket::kPacketType:
+      return Kind::kKeepalive;
+    case AckPacket::kPacketType:
+      return Kind::kAck;
+    case NegativeAckPacket::kPacketType:
+      return Kind::kNegativeAck;
+    case ShutdownPacket::kPacketType:
+      return Kind::kShutdown;
+    case AckOfAckPacket::kPacketType:
+      return Kind::kAckOfAck;
+    default:
+      return Kind::kUnknown;
+  }
+}
+
 void Packet::DecodeUint32(uint32_t* n, const unsigned char* p) {
   *n = p[0];
   *n = ((*n << 8) | p[1]);
@@ -33,9 +33,25 @@ namespace detail {
 
 class Packet {
  public:
+  // The kinds of packet which can be identified from the header of an encoded packet.
+  enum class Kind {
+    kUnknown,
+    kData,
+    kHandshake,
+    kKeepalive,
+    kAck,
+    kNegativeAck,
+    kShutdown,
+    kAckOfAck
+  };
+
   // Get the destination socket id from an encoded packet.
   static bool DecodeDestinationSocketId(uint32_t* id, const boost::asio::const_buffer& data);
 
+  // Identify an encoded packet by reading the type bits of its header once, without decoding the
+  // remainder.  Returns kUnknown if the data is too short or carries an unknown control type.
+  static Kind DecodeKind(const boost::asio::const_buffer& data);
+
  protected:
   // Prevent deletion through this type.
   virtual ~Packet();
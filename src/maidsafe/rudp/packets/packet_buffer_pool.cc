@@ -0,0 +1,226 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/packets/packet_buffer_pool.h"
+
+#ifdef MAIDSAFE_WIN32
+#  define WIN32_LEAN_AND_MEAN 1
+#  include <windows.h>
+#else
+#  include <sys/mman.h>
+#  ifndef MAP_ANONYMOUS
+#    define MAP_ANONYMOUS MAP_ANON
+#  endif
+#endif
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+#include "maidsafe/rudp/parameters.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+const size_t kBlockAlignment(64);
+// The number of buffers in a slab of ordinary pages.
+const size_t kSlabBufferCount(64);
+const size_t kPageSize(4096);
+const size_t kHugePageSize(2 * 1024 * 1024);
+
+size_t RoundUp(size_t size, size_t multiple) {
+  return (size + multiple - 1) / multiple * multiple;
+}
+
+}  // unnamed namespace
+
+// The header of each buffer, which is followed by the buffer itself.
+struct PacketBuffer::Block {
+  std::atomic<uint32_t> references;
+  PacketBufferPool* pool;
+  Block* next_free;
+};
+
+const size_t PacketBuffer::kBlockHeaderSize(RoundUp(sizeof(Block), kBlockAlignment));
+
+PacketBuffer::PacketBuffer(const PacketBuffer& other) : block_(other.block_) {
+  if (block_)
+    block_->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PacketBuffer::Reset() {
+  if (block_ && block_->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    block_->pool->Release(block_);
+  block_ = nullptr;
+}
+
+unsigned char* PacketBuffer::data() const {
+  return block_ ? reinterpret_cast<unsigned char*>(block_) + kBlockHeaderSize : nullptr;
+}
+
+size_t PacketBuffer::capacity() const { return block_ ? block_->pool->buffer_size() : 0; }
+
+bool PacketBuffer::unique() const {
+  return block_ && block_->references.load(std::memory_order_acquire) == 1;
+}
+
+PacketBufferPool::PacketBufferPool(size_t buffer_size, size_t max_buffer_count, bool huge_pages)
+    : buffer_size_(buffer_size),
+      block_stride_(RoundUp(PacketBuffer::kBlockHeaderSize + buffer_size, kBlockAlignment)),
+      max_buffer_count_(max_buffer_count),
+      huge_pages_(huge_pages),
+      mutex_(),
+      slabs_(),
+      free_blocks_(nullptr),
+      block_count_(0),
+      in_use_(0) {}
+
+PacketBufferPool::~PacketBufferPool() {
+  assert(in_use_ == 0);
+  for (const auto& slab : slabs_) {
+#ifdef MAIDSAFE_WIN32
+    VirtualFree(slab.memory, 0, MEM_RELEASE);
+#else
+    munmap(slab.memory, slab.size);
+#endif
+  }
+}
+
+PacketBufferPool& PacketBufferPool::Small() {
+  // Never destroyed, so that buffers may still be released while static objects are destroyed.
+  static PacketBufferPool* const pool(new PacketBufferPool(Parameters::default_size,
+                                                           Parameters::packet_buffer_count,
+                                                           Parameters::packet_buffer_huge_pages));
+  return *pool;
+}
+
+PacketBufferPool& PacketBufferPool::Large() {
+  static PacketBufferPool* const pool(new PacketBufferPool(
+      Parameters::max_size, Parameters::packet_buffer_count, Parameters::packet_buffer_huge_pages));
+  return *pool;
+}
+
+PacketBuffer PacketBufferPool::AllocateShared(size_t size) {
+  if (size <= Small().buffer_size()) {
+    PacketBuffer buffer(Small().Allocate(size));
+    if (!buffer.empty())
+      return buffer;
+  }
+  return Large().Allocate(size);
+}
+
+void PacketBufferPool::ReserveShared(size_t count) {
+  Small().Reserve(count);
+  Large().Reserve(count);
+}
+
+void PacketBufferPool::UnreserveShared(size_t count) {
+  Small().Unreserve(count);
+  Large().Unreserve(count);
+}
+
+PacketBuffer PacketBufferPool::Allocate(size_t size) {
+  if (size > buffer_size_)
+    return PacketBuffer();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!free_blocks_ && !AddSlab())
+    return PacketBuffer();
+  PacketBuffer::Block* block(free_blocks_);
+  free_blocks_ = block->next_free;
+  block->references.store(1, std::memory_order_relaxed);
+  ++in_use_;
+  return PacketBuffer(block);
+}
+
+void PacketBufferPool::Reserve(size_t count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_buffer_count_ += count;
+}
+
+void PacketBufferPool::Unreserve(size_t count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  assert(count <= max_buffer_count_);
+  max_buffer_count_ -= std::min(count, max_buffer_count_);
+}
+
+size_t PacketBufferPool::max_buffer_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return max_buffer_count_;
+}
+
+size_t PacketBufferPool::InUse() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return in_use_;
+}
+
+bool PacketBufferPool::AddSlab() {
+  if (block_count_ >= max_buffer_count_)
+    return false;
+  size_t size(huge_pages_ ? RoundUp(block_stride_, kHugePageSize)
+                          : RoundUp(block_stride_ * kSlabBufferCount, kPageSize));
+  void* memory(nullptr);
+#ifdef MAIDSAFE_WIN32
+  memory = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+#  ifdef MAP_HUGETLB
+  if (huge_pages_) {
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB,
+                  -1, 0);
+    if (memory == MAP_FAILED)
+      memory = nullptr;
+  }
+#  endif
+  // Fall back to ordinary pages if no huge pages are available.
+  if (!memory) {
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (memory == MAP_FAILED)
+      memory = nullptr;
+  }
+#endif
+  if (!memory)
+    return false;
+  slabs_.push_back(Slab{static_cast<unsigned char*>(memory), size});
+
+  size_t count(std::min(size / block_stride_, max_buffer_count_ - block_count_));
+  for (size_t i(count); i != 0; --i) {
+    auto block(new (slabs_.back().memory + (i - 1) * block_stride_) PacketBuffer::Block);
+    block->references.store(0, std::memory_order_relaxed);
+    block->pool = this;
+    block->next_free = free_blocks_;
+    free_blocks_ = block;
+  }
+  block_count_ += count;
+  return true;
+}
+
+void PacketBufferPool::Release(PacketBuffer::Block* block) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  block->next_free = free_blocks_;
+  free_blocks_ = block;
+  --in_use_;
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
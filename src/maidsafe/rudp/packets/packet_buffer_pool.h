@@ -0,0 +1,131 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_PACKETS_PACKET_BUFFER_POOL_H_
+#define MAIDSAFE_RUDP_PACKETS_PACKET_BUFFER_POOL_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+class PacketBufferPool;
+
+// A reference-counted handle to a fixed-size buffer from a PacketBufferPool.  The buffer returns to
+// its pool when the last handle to it is released.
+class PacketBuffer {
+ public:
+  PacketBuffer() : block_(nullptr) {}
+  PacketBuffer(const PacketBuffer& other);
+  PacketBuffer(PacketBuffer&& other) : block_(other.block_) { other.block_ = nullptr; }
+  PacketBuffer& operator=(PacketBuffer other) {
+    std::swap(block_, other.block_);
+    return *this;
+  }
+  ~PacketBuffer() { Reset(); }
+
+  void Reset();
+
+  unsigned char* data() const;
+  size_t capacity() const;
+  bool empty() const { return block_ == nullptr; }
+  // Whether this is the only handle to the buffer, in which case its contents may be overwritten.
+  bool unique() const;
+
+ private:
+  friend class PacketBufferPool;
+  struct Block;
+  // The size of a Block, which precedes the buffer, rounded up to keep the buffer aligned.
+  static const size_t kBlockHeaderSize;
+  explicit PacketBuffer(Block* block) : block_(block) {}
+
+  Block* block_;
+};
+
+// A pool of fixed-size buffers for packet payloads, carved out of page-allocated slabs which are
+// optionally backed by huge pages.  Slabs are allocated as buffers are first needed, up to a
+// maximum number of buffers which may be raised and lowered as connections come and go, and are
+// only freed along with the pool.  Thread-safe.
+class PacketBufferPool {
+ public:
+  PacketBufferPool(size_t buffer_size, size_t max_buffer_count, bool huge_pages);
+  // Every buffer must have been released.
+  ~PacketBufferPool();
+
+  // The pools shared by all sockets, sized from Parameters when first used.  Small holds buffers of
+  // Parameters::default_size bytes, which fit the datagrams and payloads of the default data size
+  // that most traffic uses, and Large holds buffers of Parameters::max_size bytes for the rest.
+  static PacketBufferPool& Small();
+  static PacketBufferPool& Large();
+  // Allocates from Small if size fits its buffers and it isn't exhausted, otherwise from Large.
+  // Returns an empty handle if neither can supply a buffer.
+  static PacketBuffer AllocateShared(size_t size);
+  // Raise or lower the maximum buffer count of both shared pools, e.g. by the size of a
+  // connection's receive window for as long as the connection exists.
+  static void ReserveShared(size_t count);
+  static void UnreserveShared(size_t count);
+
+  // Returns an empty handle if size exceeds buffer_size() or the pool is exhausted.
+  PacketBuffer Allocate(size_t size);
+
+  // Raise or lower max_buffer_count().  Slabs already allocated are kept when it is lowered.
+  void Reserve(size_t count);
+  void Unreserve(size_t count);
+
+  size_t buffer_size() const { return buffer_size_; }
+  size_t max_buffer_count() const;
+  size_t InUse() const;
+
+ private:
+  friend class PacketBuffer;
+
+  // Disallow copying and assignment.
+  PacketBufferPool(const PacketBufferPool&);
+  PacketBufferPool& operator=(const PacketBufferPool&);
+
+  bool AddSlab();
+  void Release(PacketBuffer::Block* block);
+
+  struct Slab {
+    unsigned char* memory;
+    size_t size;
+  };
+
+  const size_t buffer_size_, block_stride_;
+  size_t max_buffer_count_;
+  const bool huge_pages_;
+  mutable std::mutex mutex_;
+  std::vector<Slab> slabs_;
+  PacketBuffer::Block* free_blocks_;
+  size_t block_count_, in_use_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_PACKETS_PACKET_BUFFER_POOL_H_
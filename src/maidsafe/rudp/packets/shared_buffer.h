@@ -0,0 +1,76 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_PACKETS_SHARED_BUFFER_H_
+#define MAIDSAFE_RUDP_PACKETS_SHARED_BUFFER_H_
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "boost/asio/buffer.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// An immutable, reference-counted run of bytes.  Copies and slices share the underlying storage, so
+// a message can be split into packets and queued for retransmission without being copied.
+class SharedBuffer {
+ public:
+  SharedBuffer() : storage_(), offset_(0), size_(0) {}
+
+  // Takes ownership of data without copying its contents.
+  explicit SharedBuffer(std::string data)
+      : storage_(std::make_shared<const std::string>(std::move(data))),
+        offset_(0),
+        size_(storage_->size()) {}
+
+  const unsigned char* data() const {
+    return storage_ ? reinterpret_cast<const unsigned char*>(storage_->data()) + offset_ : nullptr;
+  }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // A view of up to length bytes starting at offset, sharing this buffer's storage.
+  SharedBuffer Slice(size_t offset, size_t length) const {
+    assert(offset <= size_);
+    SharedBuffer slice(*this);
+    slice.offset_ += offset;
+    slice.size_ = std::min(length, size_ - offset);
+    return slice;
+  }
+
+  boost::asio::const_buffer Buffer() const { return boost::asio::const_buffer(data(), size_); }
+
+ private:
+  std::shared_ptr<const std::string> storage_;
+  size_t offset_, size_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_PACKETS_SHARED_BUFFER_H_
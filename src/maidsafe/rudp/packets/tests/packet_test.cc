@@ -16,6 +16,10 @@
     See the Licences for the specific language governing permissions and limitations relating to
     use of the MaidSafe Software.                                                                 */
 
+#include <cstring>
+#include <string>
+#include <vector>
+
 #include "maidsafe/common/test.h"
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/utils.h"
@@ -29,6 +33,8 @@
 #include "maidsafe/rudp/packets/shutdown_packet.h"
 #include "maidsafe/rudp/packets/ack_of_ack_packet.h"
 #include "maidsafe/rudp/packets/negative_ack_packet.h"
+#include "maidsafe/rudp/packets/packet_buffer_pool.h"
+#include "maidsafe/rudp/packets/shared_buffer.h"
 #include "maidsafe/rudp/parameters.h"
 
 namespace maidsafe {
@@ -59,6 +65,40 @@ TEST(PacketTest, BEH_DecodeDestinationSocketId) {
   }
 }
 
+template <typename PacketType>
+Packet::Kind EncodedKind(const PacketType& packet) {
+  std::vector<unsigned char> storage(Parameters::max_size);
+  std::vector<boost::asio::mutable_buffer> buffers(1, boost::asio::buffer(storage));
+  std::vector<unsigned char> encoded(packet.Encode(buffers));
+  boost::asio::buffer_copy(boost::asio::buffer(encoded), buffers);
+  return Packet::DecodeKind(boost::asio::buffer(encoded));
+}
+
+TEST(PacketTest, BEH_DecodeKind) {
+  {
+    // Too short to hold a header
+    char char_array[15] = {0};
+    EXPECT_EQ(Packet::Kind::kUnknown, Packet::DecodeKind(boost::asio::buffer(char_array)));
+  }
+  {
+    // Unknown control packet type
+    char char_array[16] = {0};
+    char_array[0] = static_cast<char>(0x80);
+    char_array[1] = 0x04;
+    EXPECT_EQ(Packet::Kind::kUnknown, Packet::DecodeKind(boost::asio::buffer(char_array)));
+  }
+
+  DataPacket data_packet;
+  data_packet.SetData("data");
+  EXPECT_EQ(Packet::Kind::kData, EncodedKind(data_packet));
+  EXPECT_EQ(Packet::Kind::kHandshake, EncodedKind(HandshakePacket()));
+  EXPECT_EQ(Packet::Kind::kKeepalive, EncodedKind(KeepalivePacket()));
+  EXPECT_EQ(Packet::Kind::kAck, EncodedKind(AckPacket()));
+  EXPECT_EQ(Packet::Kind::kNegativeAck, EncodedKind(NegativeAckPacket()));
+  EXPECT_EQ(Packet::Kind::kShutdown, EncodedKind(ShutdownPacket()));
+  EXPECT_EQ(Packet::Kind::kAckOfAck, EncodedKind(AckOfAckPacket()));
+}
+
 class DataPacketTest : public testing::Test {
  public:
   DataPacketTest() : data_packet_() {}
@@ -168,6 +208,41 @@ TEST_F(DataPacketTest, BEH_Data) {
   EXPECT_EQ("Data Test", data_packet_.Data());
 }
 
+TEST_F(DataPacketTest, BEH_SharedData) {
+  SharedBuffer prefix(std::string("\x00\x00\x00\x0b", 4));
+  SharedBuffer message(std::string("Hello World"));
+  EXPECT_TRUE(data_packet_.AppendData(prefix));
+  EXPECT_TRUE(data_packet_.AppendData(message.Slice(6, 100)));
+  EXPECT_FALSE(data_packet_.AppendData(message));
+  EXPECT_EQ(9U, data_packet_.DataSize());
+  EXPECT_EQ(std::string("\x00\x00\x00\x0bWorld", 9), data_packet_.Data());
+  unsigned char copied[4] = {0};
+  EXPECT_EQ(4U, data_packet_.CopyData(3, copied, 4));
+  EXPECT_EQ(std::string("\x0bWor"), std::string(copied, copied + 4));
+
+  // Each segment is a separate gather buffer referring to the shared storage.
+  std::vector<unsigned char> header(DataPacket::kHeaderSize + 9);
+  std::vector<boost::asio::mutable_buffer> buffers(1, boost::asio::buffer(header));
+  EXPECT_EQ(DataPacket::kHeaderSize + 9, data_packet_.Encode(buffers));
+  ASSERT_EQ(3U, buffers.size());
+  EXPECT_EQ(message.data() + 6, boost::asio::buffer_cast<const unsigned char*>(buffers[2]));
+
+  std::vector<unsigned char> encoded(DataPacket::kHeaderSize);
+  std::memcpy(&encoded[0], &header[0], DataPacket::kHeaderSize);
+  for (size_t i = 1; i != buffers.size(); ++i) {
+    const unsigned char* p(boost::asio::buffer_cast<const unsigned char*>(buffers[i]));
+    encoded.insert(encoded.end(), p, p + boost::asio::buffer_size(buffers[i]));
+  }
+  DataPacket decoded;
+  EXPECT_TRUE(decoded.Decode(boost::asio::buffer(encoded)));
+  EXPECT_EQ(data_packet_.Data(), decoded.Data());
+
+  // Setting a copied payload drops the references.
+  data_packet_.SetData("Data Test");
+  EXPECT_EQ("Data Test", data_packet_.Data());
+  EXPECT_EQ(9U, data_packet_.DataSize());
+}
+
 TEST_F(DataPacketTest, BEH_IsValid) {
   {
     // Buffer length wrong
@@ -227,6 +302,91 @@ TEST_F(DataPacketTest, BEH_EncodeDecode) {
   }
 }
 
+TEST_F(DataPacketTest, BEH_DecodeIntoPooledBuffer) {
+  // A short payload takes a buffer from the pool of default-sized buffers.
+  PacketBufferPool& pool(PacketBufferPool::Small());
+  const size_t in_use(pool.InUse());
+  std::string encoded(DataPacket::kHeaderSize, 0);
+  encoded += "Pooled payload";
+  EXPECT_TRUE(data_packet_.Decode(boost::asio::buffer(encoded)));
+  EXPECT_EQ("Pooled payload", data_packet_.Data());
+  EXPECT_EQ(in_use + 1, pool.InUse());
+
+  // Decoding again reuses the packet's buffer.
+  encoded.replace(DataPacket::kHeaderSize, std::string::npos, "Reused");
+  EXPECT_TRUE(data_packet_.Decode(boost::asio::buffer(encoded)));
+  EXPECT_EQ("Reused", data_packet_.Data());
+  EXPECT_EQ(in_use + 1, pool.InUse());
+
+  // A buffer shared with a copy of the packet is left alone.
+  {
+    DataPacket copy(data_packet_);
+    encoded.replace(DataPacket::kHeaderSize, std::string::npos, "Not shared");
+    EXPECT_TRUE(data_packet_.Decode(boost::asio::buffer(encoded)));
+    EXPECT_EQ("Not shared", data_packet_.Data());
+    EXPECT_EQ("Reused", copy.Data());
+    EXPECT_EQ(in_use + 2, pool.InUse());
+  }
+  EXPECT_EQ(in_use + 1, pool.InUse());
+
+  data_packet_.ClearData();
+  EXPECT_EQ(0U, data_packet_.DataSize());
+  EXPECT_EQ(in_use, pool.InUse());
+
+  // A payload too big for it takes one from the pool of max_size buffers instead.
+  PacketBufferPool& large_pool(PacketBufferPool::Large());
+  const size_t large_in_use(large_pool.InUse());
+  encoded.replace(DataPacket::kHeaderSize, std::string::npos, Parameters::default_size + 1, 'x');
+  EXPECT_TRUE(data_packet_.Decode(boost::asio::buffer(encoded)));
+  EXPECT_EQ(Parameters::default_size + 1, data_packet_.DataSize());
+  EXPECT_EQ(in_use, pool.InUse());
+  EXPECT_EQ(large_in_use + 1, large_pool.InUse());
+  data_packet_.ClearData();
+  EXPECT_EQ(large_in_use, large_pool.InUse());
+}
+
+TEST(PacketBufferPoolTest, BEH_AllocateAndRelease) {
+  PacketBufferPool pool(100, 3, false);
+  EXPECT_TRUE(pool.Allocate(101).empty());
+  {
+    PacketBuffer first(pool.Allocate(100));
+    ASSERT_FALSE(first.empty());
+    EXPECT_EQ(100U, first.capacity());
+    EXPECT_TRUE(first.unique());
+    std::memset(first.data(), 0xff, first.capacity());
+    PacketBuffer copy(first);
+    EXPECT_FALSE(first.unique());
+    EXPECT_EQ(first.data(), copy.data());
+    EXPECT_EQ(1U, pool.InUse());
+
+    // The pool is capped at its maximum buffer count.
+    PacketBuffer second(pool.Allocate(1)), third(pool.Allocate(1));
+    EXPECT_FALSE(second.empty());
+    EXPECT_FALSE(third.empty());
+    EXPECT_TRUE(pool.Allocate(1).empty());
+    EXPECT_EQ(3U, pool.InUse());
+
+    second.Reset();
+    EXPECT_EQ(2U, pool.InUse());
+    second = pool.Allocate(1);
+    EXPECT_FALSE(second.empty());
+
+    // The cap may be raised while buffers are in use, and lowered again.
+    pool.Reserve(1);
+    EXPECT_EQ(4U, pool.max_buffer_count());
+    PacketBuffer fourth(pool.Allocate(1));
+    EXPECT_FALSE(fourth.empty());
+    EXPECT_TRUE(pool.Allocate(1).empty());
+    fourth.Reset();
+    pool.Unreserve(1);
+    EXPECT_EQ(3U, pool.max_buffer_count());
+    first.Reset();
+    EXPECT_TRUE(copy.unique());
+    EXPECT_EQ(3U, pool.InUse());
+  }
+  EXPECT_EQ(0U, pool.InUse());
+}
+
 class ControlPacketTest : public testing::Test {
  public:
   ControlPacketTest() : control_packet_() {}
@@ -591,6 +751,37 @@ TEST_F(HandshakePacketTest, BEH_EncodeDecode) {
   }
 }
 
+TEST_F(HandshakePacketTest, BEH_DecodeConnectionReason) {
+  uint32_t connection_reason(0);
+  {
+    // Buffer length wrong
+    char char_array[HandshakePacket::kMinPacketSize - 1] = {0};
+    char_array[0] = static_cast<unsigned char>(0x80);
+    char_array[1] = HandshakePacket::kPacketType;
+    EXPECT_FALSE(HandshakePacket::DecodeConnectionReason(&connection_reason,
+                                                         boost::asio::buffer(char_array)));
+  }
+  {
+    // Packet type wrong
+    char char_array[HandshakePacket::kMinPacketSize] = {0};
+    char_array[0] = static_cast<unsigned char>(0x80);
+    char_array[1] = AckPacket::kPacketType;
+    EXPECT_FALSE(HandshakePacket::DecodeConnectionReason(&connection_reason,
+                                                         boost::asio::buffer(char_array)));
+  }
+  {
+    handshake_packet_.SetConnectionReason(0x33333333);
+    handshake_packet_.set_node_id(NodeId(RandomString(NodeId::kSize)));
+    char char_array[HandshakePacket::kMinPacketSize] = {0};
+    std::vector<boost::asio::mutable_buffer> dbuffers;
+    dbuffers.push_back(boost::asio::buffer(char_array));
+    ASSERT_EQ(HandshakePacket::kMinPacketSize, handshake_packet_.Encode(dbuffers));
+    EXPECT_TRUE(HandshakePacket::DecodeConnectionReason(&connection_reason,
+                                                        boost::asio::buffer(char_array)));
+    EXPECT_EQ(0x33333333, connection_reason);
+  }
+}
+
 TEST(KeepalivePacketTest, BEH_All) {
   // Generally, KeepalivePacket uses Base(ControlPacket)'s IsValid and
   // Encode/Decode directly. So here we only test those error condition branches
@@ -708,6 +899,22 @@ TEST_F(NegativeAckPacketTest, BEH_IsValid) {
   }
 }
 
+TEST_F(NegativeAckPacketTest, BEH_GetSequenceRanges) {
+  std::vector<std::pair<uint32_t, uint32_t>> ranges(1);
+  negative_ack_packet_.GetSequenceRanges(ranges);
+  EXPECT_TRUE(ranges.empty());
+
+  negative_ack_packet_.AddSequenceNumber(0x8);
+  negative_ack_packet_.AddSequenceNumbers(0x11, 0x17);
+  negative_ack_packet_.AddSequenceNumbers(0x7fffffff, 0x0);
+  negative_ack_packet_.GetSequenceRanges(ranges);
+  std::vector<std::pair<uint32_t, uint32_t>> expected;
+  expected.push_back(std::make_pair(0x8, 0x8));
+  expected.push_back(std::make_pair(0x11, 0x17));
+  expected.push_back(std::make_pair(0x7fffffff, 0x0));
+  EXPECT_EQ(expected, ranges);
+}
+
 TEST_F(NegativeAckPacketTest, BEH_ContainsSequenceNumber) {
   EXPECT_FALSE(negative_ack_packet_.HasSequenceNumbers());
   {
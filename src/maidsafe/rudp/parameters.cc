@@ -25,11 +25,14 @@ namespace maidsafe {
 namespace rudp {
 
 uint32_t Parameters::thread_count(1);
+uint32_t Parameters::shard_count(1);
 int Parameters::max_transports(10);
 const uint32_t Parameters::maximum_segment_size(16);
 uint32_t Parameters::default_window_size(4*Parameters::maximum_segment_size);
 uint32_t Parameters::maximum_window_size(32*Parameters::maximum_segment_size);
 uint32_t Parameters::default_burst_send_size(1);
+uint32_t Parameters::receive_batch_size(32);
+uint32_t Parameters::send_batch_size(32);
 uint32_t Parameters::default_size(1480);
 
 // TODO(Fraser#5#): 2012-11-05 - Re-enable higher buffer limits on Windows once Session is able to
@@ -42,6 +45,8 @@ uint32_t Parameters::max_size(8192);
 uint32_t Parameters::max_data_size(8162);
 // #endif
 uint32_t Parameters::default_data_size(1450);
+uint32_t Parameters::packet_buffer_count(1024);
+bool Parameters::packet_buffer_huge_pages(false);
 Timeout Parameters::default_send_timeout(bptime::milliseconds(300));
 Timeout Parameters::default_receive_timeout(bptime::milliseconds(500));
 Timeout Parameters::default_send_delay(bptime::milliseconds(10));
@@ -60,6 +65,10 @@ uint32_t Parameters::maximum_handshake_failures(40);
 Timeout Parameters::bootstrap_connection_lifespan(bptime::minutes(10));
 Timeout Parameters::disconnection_timeout(bptime::milliseconds(500));
 Parameters::ConnectionType Parameters::connection_type(Parameters::kWireless);
+Parameters::CongestionControlAlgorithm Parameters::congestion_control_algorithm(
+    Parameters::kBufferBased);
+bool Parameters::in_order_delivery(true);
+uint32_t Parameters::stream_weights[Parameters::kMessagePriorityCount] = {16, 4, 1};
 
 }  // namespace rudp
 
@@ -18,10 +18,15 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <memory>
 #include <set>
+#include <unordered_map>
+#include <vector>
 #include "boost/scoped_array.hpp"
 #include "maidsafe/common/test.h"
 #include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+#include "maidsafe/rudp/hashed_node_id.h"
 #include "maidsafe/rudp/utils.h"
 
 namespace maidsafe {
@@ -72,6 +77,46 @@ TEST(UtilsTest, BEH_EndpointIsValid) {
   EXPECT_FALSE(IsValid(Endpoint(boost::asio::ip::address(), 1025)));
 }
 
+TEST(UtilsTest, BEH_HashedNodeId) {
+  std::vector<NodeId> node_ids;
+  std::unordered_map<HashedNodeId, int, HashedNodeId::Hasher> index;
+  for (int i(0); i != 100; ++i) {
+    node_ids.push_back(NodeId(RandomString(NodeId::kSize)));
+    EXPECT_TRUE(index.insert(std::make_pair(HashedNodeId(node_ids.back()), i)).second);
+  }
+  // Lookups by keys referring to a plain NodeId find the same entries.
+  for (int i(0); i != 100; ++i) {
+    HashedNodeId hashed_node_id(node_ids[i]);
+    EXPECT_EQ(HashedNodeId::Hasher()(hashed_node_id), hashed_node_id.hash());
+    EXPECT_TRUE(hashed_node_id.node_id() == node_ids[i]);
+    HashedNodeId reference(node_ids[i], HashedNodeId::kReference);
+    EXPECT_EQ(&node_ids[i], &reference.node_id());
+    EXPECT_TRUE(hashed_node_id == reference);
+    auto itr(index.find(reference));
+    ASSERT_TRUE(itr != index.end());
+    EXPECT_EQ(i, itr->second);
+  }
+  NodeId unknown(RandomString(NodeId::kSize));
+  EXPECT_TRUE(index.find(HashedNodeId(unknown, HashedNodeId::kReference)) == index.end());
+  EXPECT_EQ(1U, index.erase(HashedNodeId(node_ids.front(), HashedNodeId::kReference)));
+  EXPECT_TRUE(index.find(HashedNodeId(node_ids.front(), HashedNodeId::kReference)) == index.end());
+
+  // Copies of a referring key own their NodeId, so outlive the one referred to.
+  std::unique_ptr<NodeId> node_id(new NodeId(node_ids.back()));
+  HashedNodeId reference(*node_id, HashedNodeId::kReference);
+  HashedNodeId to_move(*node_id, HashedNodeId::kReference);
+  HashedNodeId copy(reference), moved(std::move(to_move));
+  HashedNodeId assigned(unknown);
+  assigned = reference;
+  node_id.reset();
+  for (const HashedNodeId* key : {&copy, &moved, &assigned}) {
+    EXPECT_TRUE(key->node_id() == node_ids.back());
+    auto itr(index.find(*key));
+    ASSERT_TRUE(itr != index.end());
+    EXPECT_EQ(99, itr->second);
+  }
+}
+
 }  // namespace test
 
 }  // namespace detail
@@ -44,9 +44,11 @@ Transport::Transport(BoostAsioService& asio_service, NatType& nat_type)
       nat_type_(nat_type),
       strand_(asio_service.service()),
       multiplexer_(new Multiplexer(asio_service.service())),
+      shards_(),
       connection_manager_(),
       callback_mutex_(),
       on_message_(),
+      on_stream_chunk_(),
       on_connection_added_(),
       on_connection_lost_(),
       on_nat_detection_requested_slot_(),
@@ -68,13 +70,20 @@ void Transport::Bootstrap(const IdEndpointPairs&            bootstrap_peers,
   assert(on_nat_detection_requested_slot);
   assert(!multiplexer_->IsOpen());
 
-  ReturnCode result = multiplexer_->Open(local_endpoint);
+  ReturnCode result = multiplexer_->Open(local_endpoint, Parameters::shard_count > 1);
+  if (result == kSetOptionFailure && Parameters::shard_count > 1) {
+    LOG(kWarning) << "Failed to share multiplexer endpoint - opening a single multiplexer.";
+    multiplexer_->Close();
+    result = multiplexer_->Open(local_endpoint);
+  }
 
   if (result != kSuccess) {
     LOG(kError) << "Failed to open multiplexer.  Result: " << result;
     return strand_.dispatch([on_bootstrap, result]() { on_bootstrap(result, NodeId()); });
   }
 
+  OpenShards();
+
   // We want these 3 slots to be invoked before any others connected, so that if we wait elsewhere
   // for the other connected slot(s) to be executed, we can be assured that these main slots have
   // already been executed at that point in time.
@@ -87,10 +96,11 @@ void Transport::Bootstrap(const IdEndpointPairs&            bootstrap_peers,
 
   on_nat_detection_requested_slot_ = on_nat_detection_requested_slot;
 
-  connection_manager_.reset(new ConnectionManager(shared_from_this(), strand_, multiplexer_,
-                                                  this_node_id, this_public_key));
+  connection_manager_.reset(new ConnectionManager(shared_from_this(), shards_, this_node_id,
+                                                  this_public_key));
 
-  StartDispatch();
+  for (size_t i(0); i != shards_.size(); ++i)
+    StartDispatch(i);
 
   TryBootstrapping(bootstrap_peers,
                    bootstrap_off_existing_connection,
@@ -215,10 +225,16 @@ void Transport::DetectNatType(NodeId const& peer_id, Handler handler) {
                             strand_.wrap(on_ping));
 }
 
+void Transport::SetOnStreamChunk(OnStreamChunk on_stream_chunk_slot) {
+  std::lock_guard<std::mutex> guard(callback_mutex_);
+  on_stream_chunk_ = std::move(on_stream_chunk_slot);
+}
+
 void Transport::Close() {
   {
     std::lock_guard<std::mutex> guard(callback_mutex_);
     on_message_          = nullptr;
+    on_stream_chunk_     = nullptr;
     on_connection_added_ = nullptr;
     on_connection_lost_  = nullptr;
   }
@@ -230,12 +246,19 @@ void Transport::Close() {
       if (connection_manager) { connection_manager->Close(); }
       if (multiplexer)        { multiplexer->Close(); }
       });
+
+  // Each further shard's multiplexer is closed on its own strand, where its dispatch loop runs.
+  for (size_t i(1); i < shards_.size(); ++i) {
+    auto shard_multiplexer = shards_[i].multiplexer;
+    shards_[i].strand.dispatch([shard_multiplexer]() { shard_multiplexer->Close(); });
+  }
 }
 
 void Transport::Connect(const NodeId& peer_id, const EndpointPair& peer_endpoint_pair,
-                        const std::string& validation_data) {
+                        const std::string& validation_data,
+                        Parameters::CongestionControlAlgorithm algorithm) {
   strand_.dispatch(std::bind(&Transport::DoConnect, shared_from_this(), peer_id, peer_endpoint_pair,
-                             validation_data));
+                             validation_data, algorithm));
 }
 
 Transport::OnConnect Transport::MakeDefaultOnConnectHandler() {
@@ -251,7 +274,8 @@ Transport::OnConnect Transport::MakeDefaultOnConnectHandler() {
 }
 
 void Transport::DoConnect(const NodeId& peer_id, const EndpointPair& peer_endpoint_pair,
-                          const std::string& validation_data) {
+                          const std::string& validation_data,
+                          Parameters::CongestionControlAlgorithm algorithm) {
   if (!multiplexer_->IsOpen())
     return;
 
@@ -265,16 +289,16 @@ void Transport::DoConnect(const NodeId& peer_id, const EndpointPair& peer_endpoi
           return;
         connection_manager_->Connect(peer_id, peer_endpoint_pair.local, validation_data,
                                      Parameters::rendezvous_connect_timeout, bptime::pos_infin,
-                                     on_connect, nullptr);
+                                     on_connect, nullptr, algorithm);
       };
     }
     connection_manager_->Connect(peer_id, peer_endpoint_pair.external, validation_data,
                                  Parameters::rendezvous_connect_timeout, bptime::pos_infin,
-                                 on_connect, failure_functor);
+                                 on_connect, failure_functor, algorithm);
   } else {
     connection_manager_->Connect(peer_id, peer_endpoint_pair.local, validation_data,
                                  Parameters::rendezvous_connect_timeout, bptime::pos_infin,
-                                 on_connect, nullptr);
+                                 on_connect, nullptr, algorithm);
   }
 }
 
@@ -284,7 +308,20 @@ bool Transport::CloseConnection(const NodeId& peer_id) {
 
 bool Transport::Send(const NodeId& peer_id, const std::string& message,
                      const MessageSentFunctor& message_sent_functor) {
-  return connection_manager_->Send(peer_id, message, message_sent_functor);
+  return Send(peer_id, SharedBuffer(message), Parameters::kNormalPriority,
+              Parameters::in_order_delivery, message_sent_functor);
+}
+
+bool Transport::Send(const NodeId& peer_id, const SharedBuffer& message,
+                     Parameters::MessagePriority priority, bool in_order,
+                     const MessageSentFunctor& message_sent_functor) {
+  return connection_manager_->Send(peer_id, message, priority, in_order, message_sent_functor);
+}
+
+bool Transport::SendStream(const NodeId& peer_id, const StreamSourceFunctor& source,
+                           Parameters::MessagePriority priority,
+                           const MessageSentFunctor& message_sent_functor) {
+  return connection_manager_->SendStream(peer_id, source, priority, message_sent_functor);
 }
 
 void Transport::Ping(const NodeId& peer_id, const Endpoint& peer_endpoint,
@@ -297,6 +334,12 @@ std::shared_ptr<Connection> Transport::GetConnection(const NodeId& peer_id) {
 }
 
 Transport::Endpoint Transport::external_endpoint() const {
+  // Each shard learns this node's external endpoint from the handshakes of its own connections.
+  for (const auto& shard : shards_) {
+    Endpoint endpoint(shard.multiplexer->external_endpoint());
+    if (detail::IsValid(endpoint))
+      return endpoint;
+  }
   return multiplexer_->external_endpoint();
 }
 
@@ -326,23 +369,49 @@ bool Transport::IsAvailable() const {
          detail::IsValid(multiplexer_->local_endpoint());
 }
 
-void Transport::StartDispatch() {
+void Transport::OpenShards() {
+  shards_.clear();
+  shards_.emplace_back(strand_, multiplexer_);
+  if (Parameters::shard_count < 2)
+    return;
+
+  Endpoint endpoint(multiplexer_->local_endpoint());
+  while (shards_.size() < Parameters::shard_count) {
+    MultiplexerPtr multiplexer(new Multiplexer(asio_service_.service()));
+    ReturnCode result(multiplexer->Open(endpoint, true));
+    if (result != kSuccess) {
+      LOG(kWarning) << "Failed to open shard " << shards_.size() << " on " << endpoint
+                    << ".  Result: " << result;
+      break;
+    }
+    shards_.emplace_back(boost::asio::io_service::strand(asio_service_.service()), multiplexer);
+  }
+
+  uint32_t shard_count(static_cast<uint32_t>(shards_.size()));
+  for (uint32_t i(0); i != shard_count; ++i)
+    shards_[i].multiplexer->dispatcher_.SetShard(i, shard_count);
+  // Without steering, packets landing on the wrong shard are forwarded to the right one.
+  if (shard_count > 1 && !multiplexer_->SteerBySocketId(shard_count))
+    LOG(kInfo) << "Packets on " << endpoint << " will be forwarded between shards.";
+}
+
+void Transport::StartDispatch(size_t shard_index) {
   std::weak_ptr<Transport> weak_self = shared_from_this();
 
-  auto handler = strand_.wrap([weak_self](const Error& error) {
+  auto handler = shards_[shard_index].strand.wrap([weak_self, shard_index](const Error& error) {
       if (auto self = weak_self.lock()) {
-        self->HandleDispatch(error);
+        self->HandleDispatch(shard_index, error);
       }
       });
 
-  multiplexer_->AsyncDispatch(handler);
+  shards_[shard_index].multiplexer->AsyncDispatch(handler);
 }
 
-void Transport::HandleDispatch(const boost::system::error_code& /*ec*/) {
-  if (!multiplexer_->IsOpen())
+void Transport::HandleDispatch(size_t shard_index, const boost::system::error_code& /*ec*/) {
+  if (!shards_[shard_index].multiplexer->IsOpen())
     return;
 
-  StartDispatch();
+  StartDispatch(shard_index);
 }
 
 NodeId Transport::node_id() const { return connection_manager_->node_id(); }
@@ -351,10 +420,10 @@ std::shared_ptr<asymm::PublicKey> Transport::public_key() const {
   return connection_manager_->public_key();
 }
 
-void Transport::SignalMessageReceived(const std::string& message) {
+void Transport::SignalMessageReceived(std::string message) {
   // Dispatch the message outside the strand.
   strand_.get_io_service().post(
-      std::bind(&Transport::DoSignalMessageReceived, shared_from_this(), message));
+      std::bind(&Transport::DoSignalMessageReceived, shared_from_this(), std::move(message)));
 }
 
 void Transport::DoSignalMessageReceived(const std::string& message) {
@@ -367,6 +436,26 @@ void Transport::DoSignalMessageReceived(const std::string& message) {
     local_callback(message);
 }
 
+void Transport::SignalStreamChunkReceived(uint64_t stream_id, std::string chunk, bool last,
+                                          std::function<void()> on_consumed) {
+  // Dispatch the chunk outside the strand.
+  strand_.get_io_service().post(std::bind(&Transport::DoSignalStreamChunkReceived,
+                                          shared_from_this(), stream_id, std::move(chunk), last,
+                                          std::move(on_consumed)));
+}
+
+void Transport::DoSignalStreamChunkReceived(uint64_t stream_id, const std::string& chunk,
+                                            bool last, const std::function<void()>& on_consumed) {
+  OnStreamChunk local_callback;
+  {
+    std::lock_guard<std::mutex> guard(callback_mutex_);
+    local_callback = on_stream_chunk_;
+  }
+  if (local_callback)
+    local_callback(stream_id, chunk, last);
+  on_consumed();
+}
+
 void Transport::AddConnection(ConnectionPtr connection) {
   // Discard failure_functor
   connection->GetAndClearFailureFunctor();
@@ -40,7 +40,9 @@
 #include "maidsafe/rudp/managed_connections.h"
 #include "maidsafe/rudp/nat_type.h"
 #include "maidsafe/rudp/parameters.h"
+#include "maidsafe/rudp/core/multiplexer_shard.h"
 #include "maidsafe/rudp/core/session.h"
+#include "maidsafe/rudp/packets/shared_buffer.h"
 
 namespace maidsafe {
 
@@ -57,6 +59,8 @@ class Transport : public std::enable_shared_from_this<Transport> {
  public:
   typedef std::function<void(const std::string&)> OnMessage;
 
+  typedef std::function<void(uint64_t, const std::string&, bool)> OnStreamChunk;
+
   typedef std::function<void(const NodeId&, std::shared_ptr<Transport>, bool, std::atomic<bool> &)>
       OnConnectionAdded;
 
@@ -88,10 +92,15 @@ class Transport : public std::enable_shared_from_this<Transport> {
                  const OnNatDetected&              on_nat_detection_requested_slot,
                  OnBootstrap                       on_bootstrap);
 
+  // Sets the slot which receives the chunks of incoming streams.  Must be called before Bootstrap.
+  void SetOnStreamChunk(OnStreamChunk on_stream_chunk_slot);
+
   void Close();
 
+  // algorithm governs this node's sends on the new connection.
   void Connect(const NodeId& peer_id, const EndpointPair& peer_endpoint_pair,
-               const std::string& validation_data);
+               const std::string& validation_data,
+               Parameters::CongestionControlAlgorithm algorithm);
 
   // If this causes the size of connected_endpoints_ to drop to 0, this transport will remove
   // itself from ManagedConnections which will cause it to be destroyed.
@@ -99,6 +108,13 @@ class Transport : public std::enable_shared_from_this<Transport> {
 
   bool Send(const NodeId& peer_id, const std::string& message,
             const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
+  bool Send(const NodeId& peer_id, const SharedBuffer& message,
+            Parameters::MessagePriority priority, bool in_order,
+            const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
+
+  bool SendStream(const NodeId& peer_id, const StreamSourceFunctor& source,
+                  Parameters::MessagePriority priority,
+                  const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
 
   void Ping(const NodeId& peer_id, const Endpoint& peer_endpoint,
             const std::function<void(int)>& ping_functor);  // NOLINT (Fraser)
@@ -150,16 +166,25 @@ class Transport : public std::enable_shared_from_this<Transport> {
   void DetectNatType(NodeId const& peer_id, Handler);
 
   void DoConnect(const NodeId& peer_id, const EndpointPair& peer_endpoint_pair,
-                 const std::string& validation_data);
+                 const std::string& validation_data,
+                 Parameters::CongestionControlAlgorithm algorithm);
 
-  void StartDispatch();
-  void HandleDispatch(const boost::system::error_code& ec);
+  // Opens Parameters::shard_count - 1 further multiplexers sharing the first one's endpoint.
+  void OpenShards();
+  void StartDispatch(size_t shard_index);
+  void HandleDispatch(size_t shard_index, const boost::system::error_code& ec);
 
   NodeId node_id() const;
   std::shared_ptr<asymm::PublicKey> public_key() const;
 
-  void SignalMessageReceived(const std::string& message);
+  void SignalMessageReceived(std::string message);
   void DoSignalMessageReceived(const std::string& message);
+  // Hands a chunk of an incoming stream to on_stream_chunk_ outside the strand, then runs
+  // on_consumed.
+  void SignalStreamChunkReceived(uint64_t stream_id, std::string chunk, bool last,
+                                 std::function<void()> on_consumed);
+  void DoSignalStreamChunkReceived(uint64_t stream_id, const std::string& chunk, bool last,
+                                   const std::function<void()>& on_consumed);
   void AddConnection(ConnectionPtr connection);
   void DoAddConnection(ConnectionPtr connection);
   void RemoveConnection(ConnectionPtr connection, bool timed_out);
@@ -172,10 +197,13 @@ class Transport : public std::enable_shared_from_this<Transport> {
   NatType&                           nat_type_;
   boost::asio::io_service::strand    strand_;
   MultiplexerPtr                     multiplexer_;
+  // shards_[0] is strand_ and multiplexer_.  Set during Bootstrap and fixed thereafter.
+  std::vector<MultiplexerShard>      shards_;
   ConnectionManagerPtr               connection_manager_;
   std::mutex                         callback_mutex_;
 
   OnMessage         on_message_;
+  OnStreamChunk     on_stream_chunk_;
   OnConnectionAdded on_connection_added_;
   OnConnectionLost  on_connection_lost_;
   OnNatDetected     on_nat_detection_requested_slot_;